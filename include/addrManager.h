@@ -1,42 +1,124 @@
 #ifndef ADDRMANAGER_H
 #define ADDRMANAGER_H
 
+#include <array>
 #include <cstdint>
+#include <functional>
 #include <mutex>
+#include <optional>
+#include <random>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "hash256.h"
 #include "netAddr.h"
 
 // we exclude stale addresses, older than max age
 inline constexpr uint32_t ADDR_MAX_AGE_SECS = 3 * 60 * 60;  // 3 hours
 
-// maximum number of addresses we store
-inline constexpr size_t ADDR_MANAGER_MAX_ENTRIES = 2500;
+// addresses heard about and addresses we connected to are kept in separate tables of fixed size
+// buckets, 65536 and 16384 addresses at most
+inline constexpr size_t ADDR_NEW_BUCKETS = 1024;
+inline constexpr size_t ADDR_TRIED_BUCKETS = 256;
+inline constexpr size_t ADDR_BUCKET_SIZE = 64;
+
+// buckets the addresses from one /16 source can reach in the new table, and one /16 group can
+// reach in the tried table, so no single network fills either table
+inline constexpr size_t ADDR_NEW_BUCKETS_PER_SOURCE_GROUP = 64;
+inline constexpr size_t ADDR_TRIED_BUCKETS_PER_GROUP = 8;
+
+// random picks per address asked for before selection gives up on finding more
+inline constexpr size_t ADDR_SELECT_TRIES = 32;
 
 // how many addresses we return in response to a getaddr request
 inline constexpr size_t ADDR_GETADDR_MAX = 1000;
 
+// bumped whenever the peers.dat layout changes, older files are ignored
+inline constexpr uint32_t ADDR_FILE_VERSION = 2;
+
+// binary lookup key of an address
+struct AddrKey {
+        std::array<uint8_t, 16> ip;
+        uint16_t port;
+
+        bool operator==(const AddrKey&) const = default;
+};
+
+template <>
+struct std::hash<AddrKey> {
+        size_t operator()(const AddrKey& k) const noexcept {
+            // the IPv4 part of a mapped address is in the last 4 bytes, the rest is mostly fixed
+            uint64_t hi = 0, lo = 0;
+            for (size_t i = 0; i < 8; i++) {
+                hi = (hi << 8) | k.ip[i];
+                lo = (lo << 8) | k.ip[8 + i];
+            }
+            return static_cast<size_t>((lo ^ (hi * 0x9e3779b97f4a7c15ULL) ^ k.port) *
+                                       0xff51afd7ed558ccdULL);
+        }
+};
+
 // we stores known peer addresses with key information about them
+// an address is first put in the new table and moves to the tried table once we connected to it
+// each lives in one slot picked by a keyed hash of its /16 group and the group of the peer that
+// told us about it, a newcomer only takes an occupied slot from an older or stale address, so
+// adding, looking up and picking at random are all constant time however big the book gets
 class AddrManager {
     private:
+        struct AddrInfo {
+                NetAddr addr;
+                uint16_t sourceGroup = 0;  // /16 of the peer that told us about it
+                bool tried = false;
+                size_t slot = 0;   // in the table tried says
+                size_t index = 0;  // in the ids of that table, for uniform picks
+        };
+
         mutable std::mutex mtx;
 
-        // keyed by "ip:port" string to prevent duplicates
-        std::unordered_map<std::string, NetAddr> addresses;
+        // ids start at 1, a 0 in a table slot means empty
+        std::unordered_map<uint32_t, AddrInfo> infos;
+        std::unordered_map<AddrKey, uint32_t> idByKey;
+        uint32_t nextId = 1;
+
+        // ADDR_*_BUCKETS * ADDR_BUCKET_SIZE slots each
+        std::vector<uint32_t> newTable;
+        std::vector<uint32_t> triedTable;
+        // the ids in each table, in no order
+        std::vector<uint32_t> newIds;
+        std::vector<uint32_t> triedIds;
+
+        // secret salting the bucket hashes, so peers can't aim at a bucket to flush it
+        Hash256 bucketKey;
+        mutable std::mt19937_64 rng;
 
         // we prevent storing our own listening address
-        std::string selfAddr;
+        std::optional<AddrKey> selfKey;
+
+        static AddrKey MakeKey(const NetAddr& addr);
+        static std::optional<AddrKey> MakeKey(const std::string& ip, uint16_t port);
+        // the /16 an IPv4 address belongs to
+        static uint16_t Group(const std::array<uint8_t, 16>& ip);
+
+        size_t NewSlot(const AddrKey& key, uint16_t sourceGroup) const;
+        size_t TriedSlot(const AddrKey& key) const;
+
+        std::vector<uint32_t>& Table(bool tried) { return tried ? triedTable : newTable; }
+        std::vector<uint32_t>& TableIds(bool tried) { return tried ? triedIds : newIds; }
+
+        // puts an entry in a slot of a table, the slot must be empty
+        void Place(uint32_t id, AddrInfo& info, bool tried, size_t slot);
+        // takes an entry out of its table, it stays in infos
+        void Unplace(AddrInfo& info);
+        void Delete(uint32_t id);
 
-        // returns "ip:port" key for a NetAddr
-        static std::string MakeKey(const NetAddr& addr);
+        void AddLocked(const NetAddr& addr, uint16_t sourceGroup, uint32_t now);
 
-        // we extracts IPv4 string from a NetAddr's mapped IPv6 field
-        static std::string ExtractIPv4(const NetAddr& addr);
+        // the index-th entry, counting the new table's ids first and the tried table's after
+        const AddrInfo& EntryAt(size_t index) const;
 
     public:
-        AddrManager() = default;
+        AddrManager();
         ~AddrManager() = default;
 
         // prevent copying
@@ -44,10 +126,14 @@ class AddrManager {
         AddrManager& operator=(const AddrManager&) = delete;
 
         void SetSelfAddr(const std::string& ip, uint16_t port);
-        void Add(const NetAddr& addr);
-        void AddMultiple(const std::vector<NetAddr>& addrs);
+        // sourceIP is the peer that told us, empty when the address speaks for itself
+        void Add(const NetAddr& addr, const std::string& sourceIP = "");
+        void AddMultiple(const std::vector<NetAddr>& addrs, const std::string& sourceIP = "");
+        // we connected to it, moves it to the tried table
         void MarkGood(const std::string& ip, uint16_t port);
         void Remove(const std::string& ip, uint16_t port);
+        // up to count distinct fresh addresses, tried and new ones equally likely, excluding
+        // "ip:port" strings
         std::vector<NetAddr> GetRandomAddresses(size_t count,
                                                 const std::vector<std::string>& excludeAddrs) const;
         std::vector<NetAddr> GetAddressesForGossip() const;
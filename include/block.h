@@ -2,30 +2,35 @@
 #define BLOCK_H
 
 #include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 
 #include "config.h"
+#include "hash256.h"
 #include "transaction.h"
 
 class Block {
     private:
         int64_t timestamp;  // when block is created
         std::vector<Transaction> transactions;
-        std::vector<uint8_t> previousHash;  // Stores hash of previous block
-        std::vector<uint8_t> hash;
+        Hash256 previousHash;  // Stores hash of previous block
+        Hash256 hash;
         int32_t nonce;  // counter to try different hashes in pow
         int32_t bits;   // difficulty target for this block
 
     public:
-        Block(const std::vector<Transaction>& transactions,
-              const std::vector<uint8_t>& previousHash, int32_t bits);
+        Block(const std::vector<Transaction>& transactions, const Hash256& previousHash,
+              int32_t bits);
+        // a block received in parts, its proof of work is yet to be validated
+        Block(int64_t timestamp, std::vector<Transaction> transactions,
+              const Hash256& previousHash, const Hash256& hash, int32_t nonce, int32_t bits);
         Block() = default;
 
         int64_t GetTimestamp() const { return timestamp; }
         const std::vector<Transaction>& GetTransactions() const { return transactions; }
-        const std::vector<uint8_t>& GetPreviousHash() const { return previousHash; }
-        const std::vector<uint8_t>& GetHash() const { return hash; }
+        const Hash256& GetPreviousHash() const { return previousHash; }
+        const Hash256& GetHash() const { return hash; }
         int32_t GetNonce() const { return nonce; }
         int32_t GetBits() const { return bits; }
 
@@ -33,9 +38,10 @@ class Block {
 
         static bool CheckBlockSize(const Block& block, size_t knownSerializedSize = 0);
 
+        size_t SerializedSize() const;
         std::vector<uint8_t> Serialize() const;
-        static Block Deserialize(const std::vector<uint8_t>& serialized);
-        std::vector<uint8_t> HashTransactions() const;
+        static Block Deserialize(std::span<const uint8_t> serialized);
+        Hash256 HashTransactions() const;
 };
 
 #endif
\ No newline at end of file
@@ -9,11 +9,13 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "block.h"
 #include "blockchainIterator.h"
 #include "config.h"
+#include "hash256.h"
 #include "transaction.h"
 
 // Forward declaration
@@ -21,7 +23,7 @@ class Wallet;
 
 class Blockchain {
     private:
-        std::vector<uint8_t> tip;         // hash of the last block
+        Hash256 tip;                      // hash of the last block
         int32_t tipHeight{0};             // height of tip, cached in memory and persisted to DB
         std::unique_ptr<leveldb::DB> db;  // leveldb for storing blocks (persistency)
 
@@ -44,26 +46,25 @@ class Blockchain {
 
         // adds a mined block received from a peer.
         void AddBlock(const Block& block);
-        Block GetBlock(const std::vector<uint8_t>& hash) const;
-        std::vector<std::vector<uint8_t>> GetBlockHashesAfter(
-            const std::vector<uint8_t>& afterHash) const;
+        Block GetBlock(const Hash256& hash) const;
+        std::vector<Hash256> GetBlockHashesAfter(const Hash256& afterHash) const;
 
-        const std::vector<uint8_t>& GetTip() const { return tip; }
+        const Hash256& GetTip() const { return tip; }
 
         // zero based height of the chain (genesis = 0)
         int32_t GetChainHeight() const;
 
         // height of any block by hash and -1 if not found
-        int32_t GetBlockHeight(const std::vector<uint8_t>& hash) const;
+        int32_t GetBlockHeight(const Hash256& hash) const;
 
         int32_t GetNextWorkRequired(int32_t nextBlockHeight) const;
 
-        std::map<std::string, TXOutputs> FindUTXO();
+        std::map<Hash256, TXOutputs> FindUTXO();
 
-        Transaction FindTransaction(const std::vector<uint8_t>& ID);
+        Transaction FindTransaction(const Hash256& ID);
 
         // returns the transaction and the height of the block it was confirmed in
-        std::pair<Transaction, int32_t> FindTransactionWithHeight(const std::vector<uint8_t>& ID);
+        std::pair<Transaction, int32_t> FindTransactionWithHeight(const Hash256& ID);
 
         void SignTransaction(Transaction* tx, Wallet* wallet);
 
@@ -72,7 +73,7 @@ class Blockchain {
 
         // overload that accepts an intra-block context for topological verification
         std::optional<int64_t> VerifyTransaction(
-            const Transaction* tx, const std::map<std::string, Transaction>& blockCtx);
+            const Transaction* tx, const std::unordered_map<Hash256, Transaction>& blockCtx);
 
         BlockchainIterator Iterator() const;
 
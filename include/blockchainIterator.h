@@ -8,14 +8,15 @@
 #include <vector>
 
 #include "block.h"
+#include "hash256.h"
 
 class BlockchainIterator {
     private:
-        std::vector<uint8_t> currentHash;
+        Hash256 currentHash;
         leveldb::DB* db;
 
     public:
-        BlockchainIterator(std::vector<uint8_t> tip, leveldb::DB* db);
+        BlockchainIterator(const Hash256& tip, leveldb::DB* db);
         Block Next();
         bool hasNext() const;
 };
@@ -0,0 +1,142 @@
+#ifndef BYTESTREAM_H
+#define BYTESTREAM_H
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hash256.h"
+
+// bounds checked little-endian reader over a borrowed buffer
+// the buffer must outlive the reader, and ReadBytes returns views into it without copying
+class ByteReader {
+    private:
+        std::span<const uint8_t> data;
+        size_t pos = 0;
+
+        void Require(size_t n) const {
+            if (n > data.size() - pos) {
+                throw std::runtime_error("Data truncated: expected " + std::to_string(n) +
+                                         " bytes at offset " + std::to_string(pos));
+            }
+        }
+
+    public:
+        explicit ByteReader(std::span<const uint8_t> data) : data(data) {}
+
+        size_t Position() const { return pos; }
+        size_t Remaining() const { return data.size() - pos; }
+        bool Empty() const { return pos == data.size(); }
+
+        uint8_t ReadUint8() {
+            Require(1);
+            return data[pos++];
+        }
+
+        // big-endian, only used for ports (network byte order)
+        uint16_t ReadUint16BE() {
+            Require(2);
+            uint16_t value = static_cast<uint16_t>((data[pos] << 8) | data[pos + 1]);
+            pos += 2;
+            return value;
+        }
+
+        uint32_t ReadUint32() {
+            Require(4);
+            uint32_t value = static_cast<uint32_t>(data[pos]) |
+                             (static_cast<uint32_t>(data[pos + 1]) << 8) |
+                             (static_cast<uint32_t>(data[pos + 2]) << 16) |
+                             (static_cast<uint32_t>(data[pos + 3]) << 24);
+            pos += 4;
+            return value;
+        }
+
+        uint64_t ReadUint64() {
+            Require(8);
+            uint64_t value = 0;
+            for (int i = 0; i < 8; i++) {
+                value |= static_cast<uint64_t>(data[pos + i]) << (8 * i);
+            }
+            pos += 8;
+            return value;
+        }
+
+        std::span<const uint8_t> ReadBytes(size_t n) {
+            Require(n);
+            std::span<const uint8_t> bytes = data.subspan(pos, n);
+            pos += n;
+            return bytes;
+        }
+
+        std::vector<uint8_t> ReadByteVector(size_t n) {
+            std::span<const uint8_t> bytes = ReadBytes(n);
+            return {bytes.begin(), bytes.end()};
+        }
+
+        Hash256 ReadHash256() {
+            std::span<const uint8_t> bytes = ReadBytes(HASH256_SIZE);
+            return Hash256::FromBytes(bytes.data(), bytes.size());
+        }
+
+        void Skip(size_t n) {
+            Require(n);
+            pos += n;
+        }
+
+        // the bytes consumed since an earlier Position(), as a view into the buffer
+        std::span<const uint8_t> ConsumedSince(size_t start) const {
+            return data.subspan(start, pos - start);
+        }
+};
+
+// little-endian writer appending to one buffer, pass the expected size to allocate once
+class ByteWriter {
+    private:
+        std::vector<uint8_t> buf;
+
+    public:
+        ByteWriter() = default;
+        explicit ByteWriter(size_t expectedSize) { buf.reserve(expectedSize); }
+
+        size_t Size() const { return buf.size(); }
+        const std::vector<uint8_t>& Data() const { return buf; }
+
+        // moves the buffer out, the writer is empty afterwards
+        std::vector<uint8_t> Release() { return std::move(buf); }
+
+        void WriteUint8(uint8_t value) { buf.push_back(value); }
+
+        // big-endian, only used for ports (network byte order)
+        void WriteUint16BE(uint16_t value) {
+            uint8_t bytes[2] = {static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)};
+            buf.insert(buf.end(), bytes, bytes + 2);
+        }
+
+        void WriteUint32(uint32_t value) {
+            uint8_t bytes[4];
+            for (int i = 0; i < 4; i++) bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+            buf.insert(buf.end(), bytes, bytes + 4);
+        }
+
+        void WriteUint64(uint64_t value) {
+            uint8_t bytes[8];
+            for (int i = 0; i < 8; i++) bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+            buf.insert(buf.end(), bytes, bytes + 8);
+        }
+
+        void WriteBytes(std::span<const uint8_t> bytes) {
+            buf.insert(buf.end(), bytes.begin(), bytes.end());
+        }
+
+        void WriteHash256(const Hash256& hash) { buf.insert(buf.end(), hash.begin(), hash.end()); }
+};
+
+// views the raw bytes of a string (leveldb values, file contents) without copying
+inline std::span<const uint8_t> StringAsBytes(const std::string& str) {
+    return {reinterpret_cast<const uint8_t*>(str.data()), str.size()};
+}
+
+#endif
\ No newline at end of file
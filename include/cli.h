@@ -4,6 +4,8 @@
 #include <cstdint>
 #include <string>
 
+#include "rateLimiter.h"
+
 class CLI {
     private:
         void printUsage();
@@ -17,7 +19,7 @@ class CLI {
         void reindexUTXO();
         void send(const std::string& from, const std::string& to, int64_t amount);
         void startNode(uint16_t port, const std::string& seedAddr, uint16_t rpcPort,
-                       const std::string& minerAddress);
+                       const std::string& minerAddress, const BandwidthLimits& limits);
 
     public:
         CLI() = default;
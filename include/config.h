@@ -48,9 +48,28 @@ namespace Policy {
 
     inline constexpr uint32_t MAX_BLOCK_SIZE = 1'000'000;   // 1 MB
     inline constexpr uint32_t MAX_BLOCK_TXS = 5'000;        // sanity cap
+    inline constexpr uint32_t BLOCK_RESERVED_SIZE = 1'000;  // header and coinbase room
     inline constexpr double MIN_RELAY_FEE_RATE = 0.001;     // per serialized byte
     inline constexpr size_t MAX_MEMPOOL_SIZE = 50'000'000;  // 50 MB total serialized bytes
     inline constexpr size_t MAX_MEMPOOL_ENTRIES = 10'000;   // hard cap on entry count
+    // longest unconfirmed chain above and below a mempool tx, the tx itself included
+    inline constexpr size_t MAX_MEMPOOL_ANCESTORS = 25;
+    inline constexpr size_t MAX_MEMPOOL_DESCENDANTS = 25;
+    // most mempool transactions one replacement may evict, descendants of its conflicts included
+    inline constexpr size_t MAX_REPLACEMENT_EVICTIONS = 100;
+    // a full mempool is trimmed to this share of its limits at once, not one entry per admission
+    inline constexpr double MEMPOOL_TRIM_TARGET = 0.9;
+    inline constexpr int64_t MEMPOOL_EXPIRY_SECS = 14 * 24 * 60 * 60;  // 2 weeks
+    // after a trim new transactions must beat the best evicted fee rate by this much
+    inline constexpr double INCREMENTAL_RELAY_FEE_RATE = 0.001;
+    // and that minimum halves this often once blocks are found again
+    inline constexpr int64_t ROLLING_FEE_HALFLIFE_SECS = 12 * 60 * 60;
+
+    // transactions held until a missing parent arrives
+    inline constexpr size_t MAX_ORPHAN_TXS = 100;
+    inline constexpr size_t MAX_ORPHANS_PER_PEER = 25;
+    inline constexpr size_t MAX_ORPHAN_TX_SIZE = 100'000;  // larger ones are never held
+    inline constexpr int64_t ORPHAN_TX_EXPIRE_SECS = 20 * 60;
 
 }  // namespace Policy
 
@@ -66,6 +85,8 @@ namespace Config {
     std::string GetWalletPath();
     std::string GetPeersPath();
     std::string GetBanListPath();
+    std::string GetMempoolPath();
+    std::string GetFeeEstimatesPath();
 
 }  // namespace Config
 
@@ -1,13 +1,44 @@
 #ifndef CRYPTO_H
 #define CRYPTO_H
 
+#include <openssl/evp.h>
+
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <span>
 #include <vector>
 
+#include "hash256.h"
+
+inline constexpr size_t HASH160_SIZE = 20;
+
+// 20 byte RIPEMD-160 digest, used for public key hashes
+using Hash160 = std::array<uint8_t, HASH160_SIZE>;
+
 std::vector<uint8_t> SHA256Hash(const std::vector<uint8_t>& data);
 
 std::vector<uint8_t> SHA256DoubleHash(const std::vector<uint8_t>& data);
 
 std::vector<uint8_t> RIPEMD160Hash(const std::vector<uint8_t>& data);
 
+// allocation-free one-shot digests, each thread reuses one digest context
+Hash256 SHA256Digest(std::span<const uint8_t> data);
+Hash256 SHA256DoubleDigest(std::span<const uint8_t> data);
+Hash160 RIPEMD160Digest(std::span<const uint8_t> data);
+
+// feeds several pieces into one SHA-256 digest without concatenating them first
+// the context is allocated once, Finalize resets it so the hasher can be reused
+class SHA256Hasher {
+    private:
+        std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx;
+
+    public:
+        SHA256Hasher();
+
+        SHA256Hasher& Write(std::span<const uint8_t> data);
+        Hash256 Finalize();
+};
+
 #endif
\ No newline at end of file
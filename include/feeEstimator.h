@@ -0,0 +1,83 @@
+#ifndef FEEESTIMATOR_H
+#define FEEESTIMATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "hash256.h"
+
+// fee rate buckets in raffys per byte, each FEE_BUCKET_SPACING times the one below, plus one
+// bucket under FEE_BUCKET_MIN for the transactions paying less
+inline constexpr double FEE_BUCKET_MIN = 0.001;
+inline constexpr double FEE_BUCKET_MAX = 1'000'000.0;
+inline constexpr double FEE_BUCKET_SPACING = 1.1;
+
+// longest confirmation target tracked, in blocks
+inline constexpr int32_t FEE_ESTIMATOR_MAX_TARGET = 48;
+
+// every block scales the statistics by this, so older blocks count less (half life ~350 blocks)
+inline constexpr double FEE_ESTIMATOR_DECAY = 0.998;
+
+// share of a bucket range's transactions that must confirm within the target
+inline constexpr double FEE_ESTIMATOR_SUCCESS_RATE = 0.85;
+
+// decayed transactions a bucket range needs before it is judged
+inline constexpr double FEE_ESTIMATOR_SUFFICIENT_TXS = 2.0;
+
+// bumped whenever the fee_estimates.dat layout changes, older files are ignored
+inline constexpr uint32_t FEE_ESTIMATES_FILE_VERSION = 1;
+
+// learns from the mempool how many blocks transactions of each fee rate take to confirm, and
+// answers with the lowest fee rate that reliably confirms within a given number of blocks
+class FeeEstimator {
+    private:
+        struct TrackedTx {
+                int32_t entryHeight;  // chain height when it entered the mempool
+                size_t bucket;
+                double feeRate;
+        };
+
+        std::vector<double> bucketBounds;  // lower bound of each bucket, ascending
+
+        // decayed per bucket statistics over the transactions that left the mempool
+        std::vector<double> confirmedCount;
+        std::vector<double> feeRateSum;  // of the confirmed ones, for the average a range reports
+        // [target - 1][bucket]: confirmed within target blocks
+        std::vector<std::vector<double>> confirmedWithin;
+        // [target - 1][bucket]: left the mempool unconfirmed after waiting at least target blocks
+        std::vector<std::vector<double>> failedAfter;
+
+        // transactions in the mempool right now
+        std::unordered_map<Hash256, TrackedTx> tracked;
+        int32_t bestHeight = 0;
+
+        mutable std::mutex mtx;
+
+        size_t BucketIndex(double feeRate) const;
+
+    public:
+        FeeEstimator();
+
+        // the height transactions entering the mempool from now on are counted from
+        void SetBestHeight(int32_t height);
+
+        // called by the mempool as transactions enter and leave it without being mined
+        void TrackTransaction(const Hash256& txid, double feeRate);
+        void UntrackTransaction(const Hash256& txid);
+
+        // records how long each tracked transaction in the block took, then ages the statistics
+        void ProcessBlock(int32_t height, const std::vector<Hash256>& txids);
+
+        // lowest fee rate that confirmed within target blocks at least FEE_ESTIMATOR_SUCCESS_RATE
+        // of the time, nullopt until enough transactions were seen
+        std::optional<double> EstimateFeeRate(int32_t target) const;
+
+        void SaveToFile() const;
+        void LoadFromFile();
+};
+
+#endif
\ No newline at end of file
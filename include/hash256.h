@@ -0,0 +1,58 @@
+#ifndef HASH256_H
+#define HASH256_H
+
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+inline constexpr size_t HASH256_SIZE = 32;
+
+// fixed size 32 byte hash used for block hashes, txids and merkle nodes
+// it lives inline (no heap allocation) and is trivially copyable
+struct Hash256 {
+        std::array<uint8_t, HASH256_SIZE> bytes{};
+
+        Hash256() = default;
+        explicit Hash256(const std::array<uint8_t, HASH256_SIZE>& bytes) : bytes(bytes) {}
+
+        // these throw if the input is not exactly 32 bytes (64 hex characters)
+        static Hash256 FromBytes(const uint8_t* data, size_t len);
+        static Hash256 FromVector(const std::vector<uint8_t>& data);
+        static Hash256 FromHex(const std::string& hex);
+
+        // the all zero hash marks "no hash", like the genesis previous hash or a coinbase input
+        bool IsNull() const;
+
+        std::string ToHex() const;
+        std::vector<uint8_t> ToVector() const;
+
+        uint8_t* data() { return bytes.data(); }
+        const uint8_t* data() const { return bytes.data(); }
+        static constexpr size_t size() { return HASH256_SIZE; }
+
+        auto begin() { return bytes.begin(); }
+        auto end() { return bytes.end(); }
+        auto begin() const { return bytes.begin(); }
+        auto end() const { return bytes.end(); }
+
+        uint8_t& operator[](size_t i) { return bytes[i]; }
+        const uint8_t& operator[](size_t i) const { return bytes[i]; }
+
+        auto operator<=>(const Hash256&) const = default;
+};
+
+// the bytes are already uniformly distributed, so the first 8 are a good bucket hash
+template <>
+struct std::hash<Hash256> {
+        size_t operator()(const Hash256& h) const noexcept {
+            uint64_t v;
+            std::memcpy(&v, h.bytes.data(), sizeof(v));
+            return static_cast<size_t>(v);
+        }
+};
+
+#endif
@@ -1,44 +1,227 @@
 #ifndef MEMPOOL_H
 #define MEMPOOL_H
 
-#include <map>
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <optional>
-#include <string>
+#include <set>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "block.h"
+#include "feeEstimator.h"
+#include "hash256.h"
+#include "outPoint.h"
 #include "transaction.h"
 
+// running totals over a group of mempool transactions
+struct PackageTotals {
+        int64_t fee = 0;
+        size_t size = 0;
+        size_t count = 0;
+
+        double FeeRate() const {
+            return size > 0 ? static_cast<double>(fee) / static_cast<double>(size) : 0.0;
+        }
+};
+
 struct MempoolEntry {
-        Transaction tx;
+        std::shared_ptr<const Transaction> tx;  // shared with the lookup shard holding it
+        int64_t fee;
         double feeRate;  // raffys per serialized byte
         size_t txSize;   // serialized size in bytes
+
+        // in-pool transactions this one spends from, and in-pool transactions spending from it
+        std::unordered_set<Hash256> parents;
+        std::unordered_set<Hash256> children;
+
+        // this tx and all its in-pool ancestors, what a miner has to include to take it
+        PackageTotals ancestors;
+        // this tx and all its in-pool descendants, what evicting it would drop
+        PackageTotals descendants;
+
+        // current keys in the two score indexes
+        double ancestorScore;
+        double evictionScore;
+
+        int64_t entryTime;  // unix timestamp it was admitted at, for expiry
+};
+
+// number of independently locked pieces the txid lookups are split into
+inline constexpr size_t MEMPOOL_LOOKUP_SHARDS = 16;
+
+// bumped whenever the mempool.dat layout changes, older files are ignored
+inline constexpr uint32_t MEMPOOL_FILE_VERSION = 1;
+
+// a ready selection of mempool transactions for the next block, parents before children
+// every one was verified against the chain plus its mempool parents when it was admitted
+struct BlockTemplate {
+        std::vector<Transaction> transactions;
+        int64_t totalFees = 0;
+        size_t totalSize = 0;  // serialized bytes, 4 byte size prefixes included
+};
+
+enum class MempoolAddResult {
+    Added,         // now in the mempool, or it already was
+    FeeTooLow,     // below the rolling minimum fee rate, or trimmed again right away
+    Conflict,      // spends an output already spent in the mempool, without paying to replace it
+    TooLongChain,  // would exceed the in-pool ancestor or descendant limits
+};
+
+// counters since startup next to the current size, for getmempoolinfo
+struct MempoolStats {
+        size_t count = 0;
+        size_t bytes = 0;
+        double minFeeRate = 0.0;  // what a new transaction has to pay right now
+
+        uint64_t added = 0;
+        uint64_t mined = 0;
+        uint64_t replaced = 0;    // conflicted with a transaction paying more, descendants included
+        uint64_t conflicted = 0;  // spent an output a block spent, descendants included
+        uint64_t trimmed = 0;     // dropped to bring a full mempool down to the trim target
+        uint64_t expired = 0;
+        uint64_t trims = 0;
+
+        uint64_t rejectedFeeTooLow = 0;
+        uint64_t rejectedConflict = 0;
+        uint64_t rejectedTooLongChain = 0;
+};
+
+// key of the score indexes: lowest score first, ties broken by txid
+struct FeeRateKey {
+        double feeRate;
+        Hash256 txid;
+
+        auto operator<=>(const FeeRateKey&) const = default;
 };
 
-// stores unconfirmed transactions.
+// stores unconfirmed transactions, including chains of them spending each other's outputs
+// Contains and FindTransaction, asked by every peer's inv and getdata, only lock the shard of the
+// txid, so they don't wait on admissions or on each other; everything else reads under a shared
+// lock on the package state and only admission, removal and template rebuilds write
 class Mempool {
     private:
-        std::map<std::string, MempoolEntry> entries;
+        struct LookupShard {
+                mutable std::shared_mutex mtx;
+                std::unordered_map<Hash256, std::shared_ptr<const Transaction>> txs;
+        };
+        // a txid's shard is picked by its last byte, independent of the map's bucket hash
+        std::array<LookupShard, MEMPOOL_LOOKUP_SHARDS> shards;
+
+        LookupShard& ShardFor(const Hash256& txid);
+        const LookupShard& ShardFor(const Hash256& txid) const;
+
+        // every entry is in all three indexes
+        std::unordered_map<Hash256, MempoolEntry> entries;
+        // ancestor package fee rate, the order miners take packages in
+        std::set<FeeRateKey> byAncestorScore;
+        // the higher of the own and the descendant package fee rate, the lowest is evicted first
+        // so a cheap parent with a well paying child (CPFP) is kept
+        std::set<FeeRateKey> byEvictionScore;
+        // outpoint -> txid of the mempool transaction spending it
+        std::unordered_map<OutPoint, Hash256> spentOutpoints;
+        // oldest first, so expiry only looks at what it removes
+        std::set<std::pair<int64_t, Hash256>> byEntryTime;
         size_t totalBytes = 0;
-        mutable std::mutex mtx;
 
-        // evicts the lowest fee rate entry, returns false if mempool is empty
-        bool EvictLowestFeeRate();
+        // raised by every trim, then decays once a block shows the backlog is being mined
+        double rollingMinFeeRate = 0.0;
+        bool blockSinceTrim = false;
+        int64_t rollingDecayStart = 0;
+
+        MempoolStats stats;
+
+        // kept current as transactions come and go, so the miner never waits on a selection
+        std::shared_ptr<BlockTemplate> blockTemplate;
+        std::unordered_set<Hash256> templateTxs;
+        double templateLowestScore = 0.0;  // package fee rate of the last package selected
+        bool templateDirty = true;
+
+        // told about every transaction entering and leaving, null when no one is estimating
+        FeeEstimator* feeEstimator = nullptr;
+
+        // guards everything above except the shards, taken before a shard's lock
+        mutable std::shared_mutex mtx;
+
+        // add the in-pool ancestors / descendants of txid to out, txid itself excluded
+        void CollectAncestors(const Hash256& txid, std::unordered_set<Hash256>& out) const;
+        void CollectDescendants(const Hash256& txid, std::unordered_set<Hash256>& out) const;
+
+        // moves the entry's keys in both score indexes after its totals changed
+        void Rescore(const Hash256& txid, MempoolEntry& entry);
+
+        // takes one tx out of every index and out of its relatives' package totals
+        // its in-pool children stay, so only call it alone for txs whose parents are confirmed
+        void RemoveEntry(std::unordered_map<Hash256, MempoolEntry>::iterator it);
+
+        // removes a set closed under descendants, deepest first so the totals stay consistent
+        void RemoveEntries(const std::unordered_set<Hash256>& txids);
+
+        // picks ancestor packages by package fee rate until maxBytes serialized bytes or
+        // maxCount transactions are used, parents always before their children
+        std::vector<Hash256> SelectPackages(size_t maxBytes, size_t maxCount,
+                                            double& lowestScore) const;
+
+        void RebuildTemplate();
+        // appends a new entry the template has room for, or marks the template dirty when the
+        // entry might change which packages are selected
+        void UpdateTemplateOnAdd(const Hash256& txid, const MempoolEntry& entry);
+
+        double MinFeeRateLocked(int64_t now) const;
+        // drops entries older than MEMPOOL_EXPIRY_SECS with their descendants
+        void ExpireLocked(int64_t now);
+        // once either limit is exceeded, drops the lowest eviction score packages in one batch
+        // until both are back under MEMPOOL_TRIM_TARGET of it, and raises the minimum fee rate
+        void TrimLocked(int64_t now);
+        // whether a trim would take a new package of the given eviction score, with the pool
+        // at bytesAfter and countAfter once it is in, entries in skip left out of the walk
+        bool WouldTrimLocked(double score, size_t bytesAfter, size_t countAfter,
+                             const std::unordered_set<Hash256>& skip) const;
 
     public:
         Mempool() = default;
 
-        bool AddTransaction(const Transaction& tx, double feeRate);
-        void RemoveBlockTransactions(const Block& block);
+        // the estimator must outlive the mempool
+        void SetFeeEstimator(FeeEstimator* estimator);
+
+        // a transaction spending an output some mempool transactions already spend replaces
+        // them (and their descendants) only if its fee rate beats all of their eviction scores,
+        // its fee covers all of theirs plus its own relay, and they are at most
+        // MAX_REPLACEMENT_EVICTIONS
+        MempoolAddResult AddTransaction(const Transaction& tx, int64_t fee);
+
+        // drops the block's transactions and every mempool transaction they conflict with
+        // height is the block's, so the fee estimator learns how long its transactions waited
+        void RemoveBlockTransactions(const Block& block, int32_t height);
+
+        // the in-pool transactions tx spends from, to verify it against the chain plus mempool
+        std::unordered_map<Hash256, Transaction> GetParentTransactions(const Transaction& tx) const;
+
+        // the current template for the next block, only rebuilt here if a change since the last
+        // block invalidated it, so the miner usually just takes a reference to it
+        std::shared_ptr<const BlockTemplate> GetBlockTemplate();
+
+        // for the periodic sweep, admissions also expire what they find
+        void Expire();
+
+        MempoolStats GetStats() const;
 
-        // it'll be ordered by descending fee rate for miner selection
-        std::vector<Transaction> GetTransactionsSortedByFeeRate() const;
+        // writes every transaction to mempool.dat, parents before children
+        void SaveToFile() const;
+        // reads back what SaveToFile wrote, for the node to revalidate and re-add in order
+        static std::vector<Transaction> ReadFromFile();
 
-        std::map<std::string, Transaction> GetTransactions() const;
-        std::vector<std::string> GetTransactionIDs() const;
-        std::optional<Transaction> FindTransaction(const std::string& txid) const;
-        bool Contains(const std::string& txid) const;
+        std::unordered_map<Hash256, Transaction> GetTransactions() const;
+        // every transaction without copying it, only taking the shard locks
+        std::vector<std::shared_ptr<const Transaction>> GetTransactionRefs() const;
+        std::vector<Hash256> GetTransactionIDs() const;
+        std::optional<Transaction> FindTransaction(const Hash256& txid) const;
+        bool Contains(const Hash256& txid) const;
         size_t GetCount() const;
 };
 
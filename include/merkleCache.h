@@ -0,0 +1,89 @@
+#ifndef MERKLECACHE_H
+#define MERKLECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "block.h"
+#include "hash256.h"
+#include "merkleTree.h"
+
+class Blockchain;
+
+// number of built Merkle trees kept in memory for getmerkleproof
+inline constexpr size_t MERKLE_CACHE_MAX_TREES = 64;
+
+// number of most recent blocks whose txids are kept in the in-memory index
+inline constexpr size_t MERKLE_CACHE_MAX_INDEXED_BLOCKS = 1'000;
+
+// where a confirmed transaction lives
+struct TxLocation {
+        Hash256 blockHash;
+        uint32_t index;  // position in the block's transaction list
+};
+
+// a built tree plus the block details a proof reports
+struct CachedMerkleTree {
+        Hash256 blockHash;
+        int32_t blockHeight;
+        MerkleTree tree;
+};
+
+// answers getmerkleproof from memory: a txid -> (block, index) index over the most recent blocks
+// and an LRU of built trees for the blocks asked about most recently
+// transactions below the indexed window are found by scanning the chain, so memory stays bounded
+// the chain only ever extends its tip, so indexed locations never go stale
+class MerkleCache {
+    private:
+        size_t maxTrees;
+
+        // most recently used tree at the front
+        std::list<std::shared_ptr<const CachedMerkleTree>> lru;
+        std::unordered_map<Hash256, std::list<std::shared_ptr<const CachedMerkleTree>>::iterator>
+            trees;
+
+        size_t maxIndexedBlocks;
+
+        // a block in the index with the txids it added, so they can be dropped again
+        struct IndexedBlock {
+                Hash256 hash;
+                std::vector<Hash256> txids;
+        };
+
+        // the index covers a contiguous run of blocks ending at the tip, oldest at the front
+        std::unordered_map<Hash256, TxLocation> txIndex;
+        std::deque<IndexedBlock> indexedBlocks;
+        // next block below that run, null once genesis is reached
+        Hash256 scanCursor;
+        bool cursorSet = false;
+
+        mutable std::mutex mtx;
+
+        IndexedBlock IndexBlockLocked(const Block& block);
+        void EvictOldestLocked();
+
+    public:
+        explicit MerkleCache(size_t maxTrees = MERKLE_CACHE_MAX_TREES,
+                             size_t maxIndexedBlocks = MERKLE_CACHE_MAX_INDEXED_BLOCKS)
+            : maxTrees(maxTrees), maxIndexedBlocks(maxIndexedBlocks) {}
+
+        // records a block just connected at the tip
+        void AddBlock(const Block& block);
+
+        // looks the txid up in the index, scanning older blocks from the chain on a miss
+        // the index is filled downwards until it holds the window, older blocks are only read
+        std::optional<TxLocation> FindTransaction(const Blockchain& chain, const Hash256& txid);
+
+        // returns the cached tree for a block, building and caching it on a miss
+        std::shared_ptr<const CachedMerkleTree> GetTree(const Blockchain& chain,
+                                                        const Hash256& blockHash);
+};
+
+#endif
\ No newline at end of file
@@ -4,21 +4,50 @@
 #include <cstdint>
 #include <vector>
 
+#include "hash256.h"
+
 struct MerkleProofStep {
-        std::vector<uint8_t> hash;  // hash of the sibling at the current level
-        bool isLeft;                // tells us which sibling it is(left or right)
+        Hash256 hash;  // hash of the sibling at the current level
+        bool isLeft;   // tells us which sibling it is(left or right)
 };
 
 struct MerkleProof {
-        std::vector<uint8_t> txHash;        // the transaction we want to verify
-        std::vector<uint8_t> txid;          // the transaction's ID
+        Hash256 txHash;                     // the transaction we want to verify
+        Hash256 txid;                       // the transaction's ID
         uint32_t txIndex;                   // the transaction's index in the block
         std::vector<MerkleProofStep> path;  // the path from the transaction to the root
-        std::vector<uint8_t> merkleRoot;    // the exected destination
-        std::vector<uint8_t> blockHash;     // the block this proof belongs to
+        Hash256 merkleRoot;                 // the exected destination
+        Hash256 blockHash;                  // the block this proof belongs to
         uint32_t blockHeight;               // the block's height
 };
 
+// inclusion proof for several transactions of one block, encoded like a partial Merkle tree:
+// a depth-first walk from the root gives every visited node one flag bit (set when a proven
+// leaf lies below it), and each node the walk does not descend into contributes its hash,
+// so siblings shared by several proven transactions are sent once
+struct MerkleMultiProof {
+        uint32_t txCount;             // number of leaves in the block's tree
+        std::vector<Hash256> hashes;  // hashes of the nodes not descended into, depth-first
+        std::vector<uint8_t> flags;   // one bit per visited node, least significant bit first
+        Hash256 merkleRoot;
+        Hash256 blockHash;
+        uint32_t blockHeight;
+};
+
+// a proven leaf recovered from a multiproof
+struct MerkleMultiProofMatch {
+        uint32_t txIndex;
+        Hash256 txHash;
+};
+
+// SHA256(left | right), streamed through a per-thread hasher
+Hash256 HashMerkleNode(const Hash256& left, const Hash256& right);
+
 bool VerifyMerkleProof(const MerkleProof& proof);
 
+// rebuilds the root in a single pass, checking every transaction the multiproof covers at once
+// the proven leaves are stored in matches in index order when it is given
+bool VerifyMerkleMultiProof(const MerkleMultiProof& proof,
+                            std::vector<MerkleMultiProofMatch>* matches = nullptr);
+
 #endif
@@ -1,23 +1,39 @@
 #ifndef MERKLETREE_H
 #define MERKLETREE_H
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
+#include "hash256.h"
 #include "merkleProof.h"
 
 class Transaction;
 
-// the tree is stored as a flat list of levels:
-// levels[0] = leaf hashes (SHA256 of each serialized tx)
-// levels[1] = parent hashes of pairs of leaves
-// levels[N] = [ root hash ]
+// below this many nodes in a level, hashing stays on the calling thread
+inline constexpr size_t MERKLE_PARALLEL_THRESHOLD = 1024;
+
+// every node lives in one contiguous array, level by level from the leaves up:
+// nodes[levelOffsets[0] ...] = leaf hashes (SHA256 of each serialized tx)
+// nodes[levelOffsets[1] ...] = parent hashes of pairs of leaves
+// nodes.back()               = root hash
+// a level of odd width pairs its last node with itself
 class MerkleTree {
     private:
-        std::vector<std::vector<std::vector<uint8_t>>> levels;
+        std::vector<Hash256> nodes;
+        // start of each level in nodes, plus nodes.size() as a final sentinel
+        std::vector<size_t> levelOffsets;
+
+        size_t LevelCount() const { return levelOffsets.size() - 1; }
+        size_t LevelWidth(size_t level) const {
+            return levelOffsets[level + 1] - levelOffsets[level];
+        }
+        const Hash256& Node(size_t level, size_t idx) const {
+            return nodes[levelOffsets[level] + idx];
+        }
 
-        static std::vector<uint8_t> combineAndHash(const std::vector<uint8_t>& left,
-                                                   const std::vector<uint8_t>& right);
+        void BuildMultiProof(size_t level, size_t idx, const std::vector<bool>& covered,
+                             MerkleMultiProof& proof, size_t& bitsUsed) const;
 
     public:
         explicit MerkleTree(const std::vector<Transaction>& transactions);
@@ -31,9 +47,11 @@ class MerkleTree {
         MerkleTree(MerkleTree&&) = default;
         MerkleTree& operator=(MerkleTree&&) = default;
 
-        const std::vector<uint8_t>& GetRootHash() const { return levels.back()[0]; }
+        const Hash256& GetRootHash() const { return nodes.back(); }
 
         MerkleProof GenerateProof(uint32_t txIndex) const;
+        // one proof for all the given leaves, repeated indices are proven once
+        MerkleMultiProof GenerateMultiProof(const std::vector<uint32_t>& txIndices) const;
         static bool VerifyProof(const MerkleProof& proof);
 };
 
@@ -2,7 +2,9 @@
 #define MESSAGE_H
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -10,6 +12,9 @@ inline constexpr uint32_t MAGIC_LENGTH = 4;
 inline constexpr uint32_t COMMAND_LENGTH = 12;
 inline constexpr uint32_t CHECKSUM_LENGTH = 4;
 
+// header size: 4 (magic) + 12 (command) + 4 (length) + 4 (checksum)
+inline constexpr size_t MESSAGE_HEADER_SIZE = 24;
+
 // the magic number for the blockchain
 inline constexpr std::array<uint8_t, MAGIC_LENGTH> MAGIC_CUSTOM = {0xCA, 0xFE, 0xBA, 0xBE};
 
@@ -25,6 +30,9 @@ inline constexpr const char CMD_ADDR[] = "addr";
 inline constexpr const char CMD_GETADDR[] = "getaddr";
 inline constexpr const char CMD_PING[] = "ping";
 inline constexpr const char CMD_PONG[] = "pong";
+inline constexpr const char CMD_CMPCTBLOCK[] = "cmpctblock";
+inline constexpr const char CMD_GETBLOCKTXN[] = "getblocktxn";
+inline constexpr const char CMD_BLOCKTXN[] = "blocktxn";
 
 class Message {
     private:
@@ -37,24 +45,28 @@ class Message {
     public:
         Message() = default;
         Message(const std::array<uint8_t, MAGIC_LENGTH>& magic, const std::string& command,
-                const std::vector<uint8_t>& payload);
+                std::vector<uint8_t> payload);
 
         const std::array<uint8_t, MAGIC_LENGTH>& GetMagic() const { return magic; }
         const std::array<char, COMMAND_LENGTH>& GetCommand() const { return command; }
         uint32_t GetPayloadLength() const { return payloadLength; }
         const std::array<uint8_t, CHECKSUM_LENGTH>& GetChecksum() const { return checksum; }
         const std::vector<uint8_t>& GetPayload() const { return payload; }
+        size_t GetSerializedSize() const { return MESSAGE_HEADER_SIZE + payload.size(); }
 
         // strips null padding
         std::string GetCommandString() const;
 
         std::vector<uint8_t> Serialize() const;
-        static Message Deserialize(const std::vector<uint8_t>& data);
-        static Message DeserializeHeader(const std::vector<uint8_t>& data);
+        static Message Deserialize(std::span<const uint8_t> data);
+        static Message DeserializeHeader(std::span<const uint8_t> data);
+
+        // takes ownership of a payload read after the header, checking length and checksum
+        void AttachPayload(std::vector<uint8_t> data);
 };
 
 // network helper functions
-std::array<uint8_t, CHECKSUM_LENGTH> CalculateChecksum(const std::vector<uint8_t>& payload);
+std::array<uint8_t, CHECKSUM_LENGTH> CalculateChecksum(std::span<const uint8_t> payload);
 std::array<char, COMMAND_LENGTH> CreateCommand(const std::string& cmd);
 
 #endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define MESSAGEADDR_H
 
 #include <cstdint>
+#include <span>
 #include <vector>
 
 #include "message.h"
@@ -23,7 +24,7 @@ class MessageAddr {
         uint32_t GetCount() const { return static_cast<uint32_t>(addresses.size()); }
 
         std::vector<uint8_t> Serialize() const;
-        static MessageAddr Deserialize(const std::vector<uint8_t>& data);
+        static MessageAddr Deserialize(std::span<const uint8_t> data);
 };
 
 inline Message CreateGetAddrMessage() { return Message(MAGIC_CUSTOM, CMD_GETADDR, {}); }
@@ -0,0 +1,97 @@
+#ifndef MESSAGECOMPACTBLOCK_H
+#define MESSAGECOMPACTBLOCK_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "block.h"
+#include "hash256.h"
+#include "transaction.h"
+
+// short txids are the low 6 bytes of a salted SipHash of the txid
+inline constexpr size_t SHORT_TXID_SIZE = 6;
+
+// a transaction sent in full inside a compact block
+struct PrefilledTransaction {
+        uint32_t index;  // position in the block
+        Transaction tx;
+};
+
+// announces a block as its header, a short txid per transaction the receiver likely has in its
+// mempool and the ones it can't have (the coinbase) in full, for it to rebuild the block locally
+class MessageCompactBlock {
+    private:
+        int64_t timestamp;
+        Hash256 previousHash;
+        Hash256 merkleRoot;  // lets the receiver check the proof of work before rebuilding
+        Hash256 hash;
+        int32_t nonce;
+        int32_t bits;
+
+        // random per announcement, keys the short txids together with the block hash so no one
+        // can grind a transaction colliding with another one ahead of time
+        uint64_t salt;
+        uint64_t key0 = 0;
+        uint64_t key1 = 0;
+
+        std::vector<uint64_t> shortIDs;               // transactions not prefilled, block order
+        std::vector<PrefilledTransaction> prefilled;  // ascending index
+
+        void DeriveKeys();
+
+    public:
+        MessageCompactBlock() = default;
+        // prefills the coinbase, every other transaction goes by its short txid
+        explicit MessageCompactBlock(const Block& block);
+
+        int64_t GetTimestamp() const { return timestamp; }
+        const Hash256& GetPreviousHash() const { return previousHash; }
+        const Hash256& GetMerkleRoot() const { return merkleRoot; }
+        const Hash256& GetHash() const { return hash; }
+        int32_t GetNonce() const { return nonce; }
+        int32_t GetBits() const { return bits; }
+        const std::vector<uint64_t>& GetShortIDs() const { return shortIDs; }
+        const std::vector<PrefilledTransaction>& GetPrefilled() const { return prefilled; }
+
+        size_t GetTransactionCount() const { return shortIDs.size() + prefilled.size(); }
+
+        uint64_t ShortID(const Hash256& txid) const;
+
+        std::vector<uint8_t> Serialize() const;
+        static MessageCompactBlock Deserialize(std::span<const uint8_t> data);
+};
+
+// asks for the transactions of a compact block the receiver could not find, by block index
+class MessageGetBlockTxn {
+    private:
+        Hash256 blockHash;
+        std::vector<uint32_t> indexes;  // ascending
+
+    public:
+        MessageGetBlockTxn(const Hash256& blockHash, std::vector<uint32_t> indexes);
+
+        const Hash256& GetBlockHash() const { return blockHash; }
+        const std::vector<uint32_t>& GetIndexes() const { return indexes; }
+
+        std::vector<uint8_t> Serialize() const;
+        static MessageGetBlockTxn Deserialize(std::span<const uint8_t> data);
+};
+
+// the reply to a getblocktxn, the requested transactions in the requested order
+class MessageBlockTxn {
+    private:
+        Hash256 blockHash;
+        std::vector<Transaction> transactions;
+
+    public:
+        MessageBlockTxn(const Hash256& blockHash, std::vector<Transaction> transactions);
+
+        const Hash256& GetBlockHash() const { return blockHash; }
+        const std::vector<Transaction>& GetTransactions() const { return transactions; }
+
+        std::vector<uint8_t> Serialize() const;
+        static MessageBlockTxn Deserialize(std::span<const uint8_t> data);
+};
+
+#endif
\ No newline at end of file
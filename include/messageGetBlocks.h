@@ -2,20 +2,23 @@
 #define MESSAGEGETBLOCKS_H
 
 #include <cstdint>
+#include <span>
 #include <vector>
 
+#include "hash256.h"
+
 class MessageGetBlocks {
     private:
         // best known block hash (32 bytes)
-        std::vector<uint8_t> tipHash;
+        Hash256 tipHash;
 
     public:
-        explicit MessageGetBlocks(const std::vector<uint8_t>& tipHash);
+        explicit MessageGetBlocks(const Hash256& tipHash) : tipHash(tipHash) {}
 
-        const std::vector<uint8_t>& GetTipHash() const { return tipHash; }
+        const Hash256& GetTipHash() const { return tipHash; }
 
         std::vector<uint8_t> Serialize() const;
-        static MessageGetBlocks Deserialize(const std::vector<uint8_t>& data);
+        static MessageGetBlocks Deserialize(std::span<const uint8_t> data);
 };
 
 #endif
\ No newline at end of file
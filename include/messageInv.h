@@ -2,9 +2,11 @@
 #define MESSAGEINV_H
 
 #include <cstdint>
-#include <utility>
+#include <span>
 #include <vector>
 
+#include "byteStream.h"
+#include "hash256.h"
 #include "message.h"
 
 // inventory identifiers
@@ -17,11 +19,13 @@ enum class InvType : uint32_t {
 // inventory vector to identifying an object by type and hash
 struct InvVector {
         InvType type;
-        std::vector<uint8_t> hash;  // transaction ID or block hash
+        Hash256 hash;  // transaction ID or block hash
 
-        std::vector<uint8_t> Serialize() const;
-        static std::pair<InvVector, size_t> Deserialize(const std::vector<uint8_t>& data,
-                                                        size_t offset);
+        // type(4) + hash size(4) + hash(32)
+        static constexpr size_t SERIALIZED_SIZE = 4 + 4 + HASH256_SIZE;
+
+        void Serialize(ByteWriter& writer) const;
+        static InvVector Deserialize(ByteReader& reader);
 };
 
 // to announces available transactions or blocks to a peer.
@@ -38,7 +42,7 @@ class MessageInv {
         const std::vector<InvVector>& GetInventory() const { return inventory; }
 
         std::vector<uint8_t> Serialize() const;
-        static MessageInv Deserialize(const std::vector<uint8_t>& data);
+        static MessageInv Deserialize(std::span<const uint8_t> data);
 };
 
 // to request the full data for objects listed in inventory vectors
@@ -2,6 +2,7 @@
 #define MESSAGEPING_H
 
 #include <cstdint>
+#include <span>
 #include <utility>
 #include <vector>
 
@@ -18,7 +19,7 @@ class MessagePing {
         uint64_t GetNonce() const { return nonce; }
 
         std::vector<uint8_t> Serialize() const;
-        static MessagePing Deserialize(const std::vector<uint8_t>& data);
+        static MessagePing Deserialize(std::span<const uint8_t> data);
 };
 
 // we reply pong to inform we are alive
@@ -3,13 +3,16 @@
 
 #include <array>
 #include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 
 #include "netAddr.h"
 
 // protocol version of node
-inline constexpr int32_t PROTOCOL_VERSION = 1;
+inline constexpr int32_t PROTOCOL_VERSION = 2;
+// first version announcing new blocks as compact blocks (cmpctblock, getblocktxn, blocktxn)
+inline constexpr int32_t COMPACT_BLOCKS_VERSION = 2;
 // service flags
 inline constexpr uint64_t NODE_NETWORK = 1;
 
@@ -42,7 +45,7 @@ class MessageVersion {
         bool GetRelay() const { return relay; }
 
         std::vector<uint8_t> Serialize() const;
-        static MessageVersion Deserialize(const std::vector<uint8_t>& data);
+        static MessageVersion Deserialize(std::span<const uint8_t> data);
 };
 
 #endif
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <string>
 #include <vector>
 
+#include "byteStream.h"
+
 struct NetAddr {
         uint32_t time;               // timestamp for peers, or 0 for version messages
         uint64_t services;           // service flags
@@ -15,9 +17,8 @@ struct NetAddr {
         NetAddr() : time(0), services(0), port(0) { ip.fill(0); }
         NetAddr(uint64_t services, const std::string& ipv4, uint16_t port);
 
-        std::vector<uint8_t> Serialize(bool includeTime = false) const;
-        static std::pair<NetAddr, size_t> Deserialize(const std::vector<uint8_t>& data,
-                                                      size_t offset, bool includeTime = false);
+        void Serialize(ByteWriter& writer, bool includeTime = false) const;
+        static NetAddr Deserialize(ByteReader& reader, bool includeTime = false);
 };
 
 #endif
\ No newline at end of file
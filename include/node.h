@@ -5,22 +5,34 @@
 #include <condition_variable>
 #include <csignal>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "addrManager.h"
 #include "banManager.h"
 #include "blockchain.h"
 #include "config.h"
+#include "feeEstimator.h"
 #include "mempool.h"
+#include "merkleCache.h"
 #include "messageInv.h"
 #include "netAddr.h"
+#include "orphanPool.h"
+#include "partialBlock.h"
 #include "peer.h"
+#include "rateLimiter.h"
+#include "requestTracker.h"
+#include "rollingBloomFilter.h"
 #include "rpcServer.h"
 #include "server.h"
+#include "timerWheel.h"
 
 // maximum number of simultaneous peer connections
 inline constexpr size_t MAX_PEERS = 125;
@@ -35,18 +47,34 @@ inline constexpr int OUTBOUND_INTERVAL_SECS = 30;
 inline constexpr int PING_INTERVAL_SECS = 120;
 inline constexpr int PING_TIMEOUT_SECS = 30;
 
+// how often disconnected peers are reaped and expired mempool and orphan transactions dropped
+inline constexpr int CLEANUP_INTERVAL_SECS = 30;
+
+// how often expired bans are lifted
+inline constexpr int BAN_SWEEP_INTERVAL_SECS = 60;
+
 // timeout for the miner's condition variable just incase we miss a notification
 inline constexpr int MINER_CV_TIMEOUT_SECS = 60;
 
-// max messages a peer can send per second before being disconnected
-inline constexpr int32_t MAX_PEER_MESSAGES_PER_SEC = 100;
+// how often the mempool, and the address book and ban list, are dumped to disk besides at
+// shutdown, so a crash loses little
+inline constexpr int MEMPOOL_DUMP_INTERVAL_SECS = 15 * 60;
+inline constexpr int ADDR_DUMP_INTERVAL_SECS = 15 * 60;
 
 // inv batching, the interval it flushes and max items per batch message
 inline constexpr int INV_FLUSH_INTERVAL_MS = 100;
 inline constexpr size_t MAX_INV_BATCH_SIZE = 50;
 
+// how soon the writer thread retries a peer whose reader thread was sending to it
+inline constexpr int WRITER_RETRY_MS = 10;
+
+// inventory remembered per peer as already known to it, so we never announce it back
+inline constexpr uint32_t KNOWN_INVENTORY_MAX = 20'000;
+inline constexpr double KNOWN_INVENTORY_FP_RATE = 0.00001;
+
 // tracks a peer connection, handshake state, and liveliness and thread
-struct PeerState {
+// always owned by a shared_ptr, timers hold a weak_ptr to it
+struct PeerState : std::enable_shared_from_this<PeerState> {
         std::unique_ptr<Peer> peer;
         bool versionSent = false;      // have we sent our version to this peer?
         bool versionReceived = false;  // have we received their version?
@@ -58,9 +86,8 @@ struct PeerState {
         int32_t protocolVersion = 0;  // their protocol version
         NetAddr listenAddr;           // their self-advertised listening address
 
-        // rate limiting so no spam
-        int32_t msgCount = 0;
-        std::chrono::steady_clock::time_point msgWindowStart = std::chrono::steady_clock::now();
+        // bandwidth and message budgets of this connection, the node wide ones apply on top
+        TrafficLimiter traffic;
 
         // misbehavior scoring, if score reaches BAN_SCORE_THRESHOLD the IP is banned
         int32_t misbehaviorScore = 0;
@@ -68,18 +95,30 @@ struct PeerState {
         // pending inv items to be batched and sent on flush
         std::mutex invMutex;
         std::vector<InvVector> pendingInv;
-
-        // liveliness monitoring
-        std::mutex pongMutex;
-        std::condition_variable pongCV;
-        uint64_t pongNonce = 0;
-        bool pongReceived = false;
-
-        // threads for liveliness
-        std::thread readerThread;
-        std::thread monitorThread;
-
-        explicit PeerState(std::unique_ptr<Peer> p) : peer(std::move(p)) {}
+        // txs and blocks the peer announced, sent or was sent, guarded by invMutex
+        RollingBloomFilter knownInventory{KNOWN_INVENTORY_MAX, KNOWN_INVENTORY_FP_RATE};
+
+        // compact block from this peer waiting on the blocktxn we asked for, only touched by
+        // the reader thread
+        std::optional<PartialBlock> partialBlock;
+        // a whole block asked for outside the request tracker, after a rebuild failed, only
+        // touched by the reader thread
+        bool blockRequested = false;
+
+        // liveliness monitoring, the outstanding ping and the timer waiting on its pong, or the
+        // one sending the next ping, guarded by pingMutex
+        std::mutex pingMutex;
+        uint64_t pingNonce = 0;
+        bool pingPending = false;
+        TimerId pingTimer = 0;
+
+        // messages for the node's writer thread, from callers that must not block on the socket
+        std::mutex sendQueueMutex;
+        std::deque<std::pair<Message, TrafficClass>> sendQueue;
+
+        PeerState(std::unique_ptr<Peer> p, const BandwidthLimits& limits)
+            : peer(std::move(p)),
+              traffic(limits.maxPeerUpload, limits.maxPeerDownload, 0, MAX_PEER_MESSAGES_PER_SEC) {}
 };
 
 class Node {
@@ -90,11 +129,19 @@ class Node {
         std::atomic<bool> running;
         std::atomic<int32_t> blockchainHeight;
 
+        // declared before the mempool, which holds a pointer to it
+        FeeEstimator feeEstimator;
         Mempool mempool;
+        OrphanPool orphanPool;
+        RequestTracker requestTracker;
+        MerkleCache merkleCache;
         RPCServer rpcServer;
         AddrManager addrManager;
         BanManager banManager;
 
+        BandwidthLimits bandwidthLimits;
+        TrafficLimiter nodeTraffic;
+
         // persistent blockchain handling
         std::unique_ptr<Blockchain> blockchain;
         std::mutex blockchainMutex;
@@ -110,6 +157,10 @@ class Node {
 
         void DispatchMessage(PeerState& peerState, const Message& msg);
 
+        // blocks and blocktxn answering our own getdata or getblocktxn are Block, everything
+        // else the peer sends is Other, so unsolicited block relay waits on the budget
+        TrafficClass ClassifyReceived(PeerState& peerState, const std::string& command);
+
         // message handlers
         void HandleVersion(PeerState& peerState, const std::vector<uint8_t>& payload);
         void HandleVerack(PeerState& peerState);
@@ -118,6 +169,9 @@ class Node {
         void HandleInv(PeerState& peerState, const std::vector<uint8_t>& payload);
         void HandleTx(PeerState& peerState, const std::vector<uint8_t>& payload);
         void HandleBlock(PeerState& peerState, const std::vector<uint8_t>& payload);
+        void HandleCompactBlock(PeerState& peerState, const std::vector<uint8_t>& payload);
+        void HandleGetBlockTxn(PeerState& peerState, const std::vector<uint8_t>& payload);
+        void HandleBlockTxn(PeerState& peerState, const std::vector<uint8_t>& payload);
         void HandleGetBlocks(PeerState& peerState, const std::vector<uint8_t>& payload);
         void HandleGetData(PeerState& peerState, const std::vector<uint8_t>& payload);
         void HandleAddr(PeerState& peerState, const std::vector<uint8_t>& payload);
@@ -125,12 +179,58 @@ class Node {
 
         void SendVersion(PeerState& peerState);
 
+        // every message to a peer goes through here to be charged to its and the node's budget
+        void Send(PeerState& peerState, const Message& msg);
+        void Send(PeerState& peerState, const Message& msg, TrafficClass trafficClass);
+        // hands the message to the writer thread, for timer callbacks, which must not wait on a
+        // slow peer's socket
+        void QueueSend(PeerState& peerState, const Message& msg);
+
+        // how long the peer's or the node's upload budget holds back traffic of the class
+        std::chrono::steady_clock::duration UploadDelay(PeerState& peerState,
+                                                        TrafficClass trafficClass);
+        // sleeps that long, for the reader thread answering the peer, which in turn stops
+        // reading further requests from it meanwhile
+        void WaitForUpload(PeerState& peerState, TrafficClass trafficClass);
+        // sleeps until delay() reports no delay left, in slices so shutdown and a dropped
+        // connection don't wait out a delay of any length
+        void WaitForBudget(PeerState& peerState,
+                           const std::function<std::chrono::steady_clock::duration()>& delay);
+
+        // validates and connects a block a peer sent, whole or rebuilt from a compact block, and
+        // relays it on unless we are syncing
+        // serializedSize is 0 when the block was rebuilt, a rebuilt block failing its proof of
+        // work is fetched whole instead of counting against the peer
+        void ProcessBlock(PeerState& peerState, const Block& block, size_t serializedSize,
+                          bool reconstructed);
+
+        // asks the peer for the full block with a getdata
+        void RequestBlock(PeerState& peerState, const Hash256& hash);
+
+        // queues getdata messages of at most MAX_INV_BATCH_SIZE items for the writer
+        void SendGetData(PeerState& peerState, const std::vector<InvVector>& items);
+
         void RelayTransaction(const Transaction& tx, const std::string& sourcePeerAddr);
 
+        // parents of tx whose spent outputs are neither in the mempool nor unspent in the
+        // chain, the caller holds blockchainMutex
+        std::vector<Hash256> FindMissingParents(const Transaction& tx);
+
+        // re-evaluates in one pass the orphans waiting on the given txids, and on any orphan that
+        // gets accepted along the way, the caller holds blockchainMutex
+        // returns the accepted transactions with the peer that sent each, for relay
+        std::vector<std::pair<Transaction, std::string>> ProcessOrphans(
+            std::vector<Hash256> parents);
+
         // relay a peer's address to a small number of other connected peers
         void GossipAddr(const NetAddr& addr, const std::string& sourcePeerAddr);
 
-        void MonitorPeer(std::shared_ptr<PeerState> peerState);
+        // liveliness, every PING_INTERVAL_SECS after its last pong a peer is pinged and has
+        // PING_TIMEOUT_SECS to answer, both waits are timers on the wheel
+        // the caller of SchedulePing holds the peer's pingMutex
+        void SchedulePing(PeerState& peerState);
+        void PingPeer(PeerState& peerState);
+        void CheckPong(PeerState& peerState);
 
         void DisconnectPeer(const std::string& peerAddr);
 
@@ -140,18 +240,42 @@ class Node {
         // extracts the IP (without port) from a "ip:port" address string
         static std::string ExtractIP(const std::string& addr);
 
-        void CleanupDisconnectedPeers();
-
-        std::mutex cleanupCVMtx;
-        std::condition_variable cleanupCV;
-        void RunCleanupLoop(std::stop_token stoken);
-        std::jthread cleanupThread;
-
-        // outbound connection management
-        std::mutex outboundCVMtx;
-        std::condition_variable outboundCV;
-        void RunOutboundLoop(std::stop_token stoken);
+        // run by a peer's reader thread as it exits, drops the peer from the peer list and
+        // forgets what it was asked for and what it sent us
+        void ReleasePeer(const std::shared_ptr<PeerState>& peerState);
+
+        // one thread sends what is queued for every peer with non-blocking writes, it waits in
+        // poll on the sockets that are full and on the wake pipe, which QueueSend writes to
+        std::jthread writerThread;
+        int writerWake[2] = {-1, -1};
+        void RunWriter(std::stop_token stoken);
+        void WakeWriter();
+        // hands queued messages to the peer until its socket is full or the queue is empty
+        FlushResult DrainSendQueue(PeerState& peerState);
+
+        // reader threads still running, Stop waits for them to finish instead of joining
+        std::mutex peerThreadsMutex;
+        std::condition_variable peerThreadsCV;
+        size_t peerThreads = 0;
+
+        // re-adds the transactions of the last mempool dump that are still valid on this chain
+        void LoadMempool();
+
+        // drops expired mempool and orphan transactions
+        void Cleanup();
+
+        // ping deadlines, inv flushes, request retries and the periodic upkeep all run on this
+        // one thread, however many peers there are
+        TimerWheel timers;
+
+        // outbound connection management, attempts block on connect so they run on their own
+        // thread, which the wheel wakes every OUTBOUND_INTERVAL_SECS
+        std::mutex outboundMtx;
+        std::condition_variable_any outboundCV;
+        bool outboundDue = false;
         std::jthread outboundThread;
+        void RunOutboundLoop(std::stop_token stoken);
+        void ConnectOutboundPeers(std::stop_token stoken);
 
         size_t CountOutboundPeers();
         std::vector<std::string> GetConnectedPeerAddrs();
@@ -163,14 +287,16 @@ class Node {
         std::condition_variable minerCV;
         void RunMinerLoop(std::stop_token stoken);
 
+        // announces a new tip as a compact block, or an inv to peers too old for one
         void BroadcastBlock(const Block& block);
 
-        // queues an inv item for a peer, it is flushed by the inv thread
+        // queues an inv item for a peer, it is sent by the next flush, which also sends the
+        // getdata retries and the requests that were waiting for a free slot
+        // items the peer already knows are skipped
         void QueueInv(PeerState& peerState, const InvVector& inv);
-        std::mutex invFlushCVMtx;
-        std::condition_variable invFlushCV;
-        void RunInvFlushLoop(std::stop_token stoken);
-        std::jthread invFlushThread;
+        static void MarkKnown(PeerState& peerState, const Hash256& hash);
+        // runs every INV_FLUSH_INTERVAL_MS
+        void FlushInv();
 
         void RegisterRPCMethods();
 
@@ -178,7 +304,7 @@ class Node {
 
     public:
         Node(const std::string& ip, uint16_t port, uint16_t rpcPort = DEFAULT_RPC_PORT,
-             const std::string& minerAddress = "");
+             const std::string& minerAddress = "", const BandwidthLimits& limits = {});
         ~Node();
 
         Node(const Node&) = delete;
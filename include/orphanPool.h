@@ -0,0 +1,65 @@
+#ifndef ORPHANPOOL_H
+#define ORPHANPOOL_H
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "block.h"
+#include "hash256.h"
+#include "transaction.h"
+
+struct OrphanEntry {
+        Transaction tx;
+        std::string fromPeer;  // remote address of the peer that relayed it
+        int64_t expireTime;    // unix timestamp it is dropped at
+        std::vector<Hash256> missingParents;
+};
+
+// holds relayed transactions whose parents we haven't seen yet, so a child arriving before its
+// parent is retried once the parent is accepted instead of being dropped
+class OrphanPool {
+    private:
+        std::unordered_map<Hash256, OrphanEntry> orphans;
+        // missing parent txid -> orphans waiting on it
+        std::unordered_map<Hash256, std::unordered_set<Hash256>> byMissingParent;
+        // soonest expiry first, also the order orphans are evicted in when the pool is full
+        std::set<std::pair<int64_t, Hash256>> byExpiry;
+        std::unordered_map<std::string, size_t> peerCounts;
+
+        mutable std::mutex mtx;
+
+        void EraseLocked(std::unordered_map<Hash256, OrphanEntry>::iterator it);
+
+    public:
+        OrphanPool() = default;
+
+        // false if the tx is too large, already held or the peer is at its limit
+        // makes room by evicting the orphan closest to expiry when the pool is full
+        bool Add(const Transaction& tx, const std::string& fromPeer,
+                 const std::vector<Hash256>& missingParents);
+
+        // copies of the orphans waiting on any of the parents, each once
+        std::vector<OrphanEntry> GetChildren(const std::vector<Hash256>& parents) const;
+
+        void Erase(const Hash256& txid);
+
+        // drops orphans the block confirmed or conflicts with, returns how many
+        size_t EraseForBlock(const Block& block);
+
+        // drops everything a disconnected peer sent us, returns how many
+        size_t EraseForPeer(const std::string& peerAddr);
+
+        // drops orphans whose parents never showed up in time, returns how many
+        size_t EraseExpired();
+
+        bool Contains(const Hash256& txid) const;
+        size_t Size() const;
+};
+
+#endif
\ No newline at end of file
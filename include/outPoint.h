@@ -0,0 +1,31 @@
+#ifndef OUTPOINT_H
+#define OUTPOINT_H
+
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "hash256.h"
+
+// reference to one output of a previous transaction (txid + output index)
+struct OutPoint {
+        Hash256 txid;
+        int vout{0};
+
+        // "txid:vout", only for logging and RPC output
+        std::string ToString() const { return txid.ToHex() + ":" + std::to_string(vout); }
+
+        auto operator<=>(const OutPoint&) const = default;
+};
+
+template <>
+struct std::hash<OutPoint> {
+        size_t operator()(const OutPoint& o) const noexcept {
+            // mix the index in so outputs of the same tx land in different buckets
+            return std::hash<Hash256>{}(o.txid) ^
+                   (static_cast<size_t>(o.vout) * 0x9e3779b97f4a7c15ULL);
+        }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef PARTIALBLOCK_H
+#define PARTIALBLOCK_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "block.h"
+#include "messageCompactBlock.h"
+#include "transaction.h"
+
+// a block being rebuilt from a compact block, first from transactions we already have and then
+// from the blocktxn answering our getblocktxn for the rest
+// a short txid matching two of our transactions, or given twice by the sender, leaves its slot
+// empty so the transaction is fetched instead of guessed
+class PartialBlock {
+    private:
+        MessageCompactBlock compact;
+        std::vector<std::shared_ptr<const Transaction>> slots;  // one per transaction
+        size_t filledCount = 0;
+
+    public:
+        explicit PartialBlock(MessageCompactBlock compact);
+
+        const Hash256& GetHash() const { return compact.GetHash(); }
+
+        // fills every empty slot whose short txid matches exactly one of the candidates
+        // returns how many slots it filled
+        size_t FillFrom(const std::vector<std::shared_ptr<const Transaction>>& candidates);
+
+        // block indexes of the slots still empty, ascending
+        std::vector<uint32_t> GetMissing() const;
+
+        // fills the missing slots in order, false if the count doesn't match them
+        bool FillMissing(const std::vector<Transaction>& txs);
+
+        bool IsComplete() const { return filledCount == slots.size(); }
+        size_t GetTransactionCount() const { return slots.size(); }
+
+        // the rebuilt block, its proof of work shows whether the short txids matched correctly
+        Block ToBlock() const;
+};
+
+#endif
\ No newline at end of file
@@ -1,9 +1,12 @@
 #ifndef PEER_H
 #define PEER_H
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <mutex>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -16,19 +19,33 @@ inline constexpr int PEER_RECV_TIMEOUT_SECS = 180;
 // default send timeout in seconds
 inline constexpr int PEER_SEND_TIMEOUT_SECS = 30;
 
+// how far a non-blocking flush of the pending output got
+enum class FlushResult {
+    Flushed,     // nothing left to send
+    SocketFull,  // the socket took what it could, the rest waits for it to drain
+    SenderBusy,  // a reader thread is in the middle of a blocking send
+};
+
 // represents a single TCP connection to another node.
 class Peer {
     private:
         int sockfd;
         std::string remoteIP;
         uint16_t remotePort;
-        bool connected;
+        std::atomic<bool> connected;
 
-        // protects concurrent sends from reader and monitor threads
+        // protects concurrent sends from reader and writer threads
         std::mutex sendMtx;
 
+        // messages the writer thread is getting out without blocking, guarded by pendingMtx
+        // sendMtx is taken first when both are, the writer only ever tries it
+        std::mutex pendingMtx;
+        std::vector<uint8_t> pendingOutput;
+        size_t pendingOffset = 0;
+        std::chrono::steady_clock::time_point lastSendProgress;
+
         std::vector<uint8_t> ReadExact(size_t count);
-        void WriteAll(const std::vector<uint8_t>& data);
+        void WriteAll(std::span<const uint8_t> data);
         void SetRecvTimeout(int seconds);
         void SetSendTimeout(int seconds);
 
@@ -43,9 +60,22 @@ class Peer {
         Peer(Peer&& other) noexcept;
         Peer& operator=(Peer&& other) noexcept;
 
+        // blocks until the message is out, after whatever the writer thread left pending
         void SendMessage(const Message& msg);
         Message ReceiveMessage();
 
+        // for the node's writer thread, which serves every peer and so never blocks on one
+        // QueueMessage appends the message to the pending output, FlushPending sends as much of it
+        // as the socket takes right now
+        // FlushPending throws when the connection failed or took nothing for
+        // PEER_SEND_TIMEOUT_SECS
+        void QueueMessage(const Message& msg);
+        FlushResult FlushPending();
+        int GetSocket() const { return sockfd; }
+
+        // shuts the socket down, which wakes a recv or send blocked on it in another thread
+        // the descriptor itself is only closed by the destructor, so it can't be reused while
+        // those threads still hold it
         void Disconnect();
 
         bool IsConnected() const { return connected; }
@@ -3,6 +3,7 @@
 
 #include <openssl/bn.h>
 
+#include <array>
 #include <climits>
 #include <cstdint>
 #include <memory>
@@ -10,6 +11,7 @@
 #include <vector>
 
 #include "config.h"
+#include "hash256.h"
 
 class Block;
 
@@ -19,10 +21,15 @@ using BN_ptr = std::unique_ptr<BIGNUM, decltype(&BN_free)>;
 // maximum nonce search space
 inline constexpr int32_t maxNonce = INT32_MAX;
 
+// nonces hashed together per SHA256Batch call while mining
+inline constexpr int32_t POW_BATCH_SIZE = 64;
+
 class ProofOfWork {
     private:
         const Block* block;
-        BN_ptr target;  // upperbound for valid hash value
+        Hash256 merkleRoot;  // computed once, it does not change between nonces
+        // upperbound for valid hash value, as 32 big-endian bytes
+        std::array<uint8_t, HASH256_SIZE> targetBytes;
 
     public:
         ProofOfWork(const Block* block);
@@ -32,11 +39,18 @@ class ProofOfWork {
         ProofOfWork(const ProofOfWork&) = delete;
         ProofOfWork& operator=(const ProofOfWork&) = delete;
 
-        std::pair<int32_t, std::vector<uint8_t>> Run();
+        std::pair<int32_t, Hash256> Run();
         bool Validate() const;
 
+        // whether hash is the digest of the header fields and meets the target of bits, for
+        // a header that arrives without its transactions
+        static bool ValidateHeader(const Hash256& previousHash, const Hash256& merkleRoot,
+                                   int64_t timestamp, int32_t bits, int32_t nonce,
+                                   const Hash256& hash);
+
     private:
         std::vector<uint8_t> PrepareData(int32_t nonce) const;
+        bool MeetsTarget(const uint8_t* hash) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// a bucket holds this many seconds of its rate, the burst allowed after a quiet spell
+inline constexpr double RATE_LIMIT_BURST_SECS = 2.0;
+
+// messages a single peer, and all peers together, may send us per second before we stop reading
+// from them for a while
+inline constexpr double MAX_PEER_MESSAGES_PER_SEC = 100.0;
+inline constexpr double MAX_NODE_MESSAGES_PER_SEC = 2'000.0;
+
+// blocks at least this far below our tip count as historical when a peer asks for them
+inline constexpr int32_t HISTORICAL_BLOCK_DEPTH = 6;
+
+// what a message is charged as, block relay goes first when the budget is short
+enum class TrafficClass {
+    Block,       // new blocks we relay and blocks we asked for, charged but never held back
+    Historical,  // old blocks served to a syncing peer, also held to the historical upload cap
+    Other,       // transactions, inventory, addresses and control messages
+};
+
+// class of a message we send, blocks and compact blocks are Block, everything else Other
+// serving old blocks is up to the caller, and so is received traffic, which only counts as Block
+// when it answers our own request
+TrafficClass ClassifyCommand(const std::string& command);
+
+// bytes per second, 0 meaning unlimited
+struct BandwidthLimits {
+        uint64_t maxUpload = 0;
+        uint64_t maxDownload = 0;
+        uint64_t maxHistoricalUpload = 0;
+        uint64_t maxPeerUpload = 0;
+        uint64_t maxPeerDownload = 0;
+};
+
+// refills continuously at rate per second up to RATE_LIMIT_BURST_SECS worth of it
+// consuming can run it into debt, so a message larger than the burst still goes through and only
+// what comes after it waits until the debt is paid off
+// not thread safe, callers lock around it
+class TokenBucket {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        double rate;  // per second, 0 is unlimited
+        double capacity;
+        double tokens;
+        Clock::time_point lastRefill;
+
+        void Refill(Clock::time_point now);
+
+    public:
+        explicit TokenBucket(double rate);
+
+        void Consume(double amount);
+
+        // how long until the bucket is out of debt, zero when it is
+        Clock::duration Delay();
+};
+
+struct TrafficTotals {
+        uint64_t bytesSent = 0;
+        uint64_t bytesReceived = 0;
+        uint64_t messagesSent = 0;
+        uint64_t messagesReceived = 0;
+};
+
+// the upload and download budgets of one connection, or of the whole node which every connection
+// charges as well
+class TrafficLimiter {
+    private:
+        mutable std::mutex mtx;
+        TokenBucket upload;
+        TokenBucket download;
+        TokenBucket historicalUpload;
+        TokenBucket messages;  // received messages, block relay included
+        TrafficTotals totals;
+
+    public:
+        TrafficLimiter(uint64_t uploadRate, uint64_t downloadRate, uint64_t historicalUploadRate,
+                       double messageRate);
+
+        void ChargeUpload(size_t bytes, TrafficClass trafficClass);
+        void ChargeDownload(size_t bytes);
+
+        // how long traffic of the class has to wait before the next message, always zero for
+        // Block
+        std::chrono::steady_clock::duration UploadDelay(TrafficClass trafficClass);
+        std::chrono::steady_clock::duration DownloadDelay(TrafficClass trafficClass);
+
+        TrafficTotals GetTotals() const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+#ifndef REQUESTTRACKER_H
+#define REQUESTTRACKER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hash256.h"
+#include "messageInv.h"
+
+// getdata items a peer can have outstanding at once, the rest wait for a free slot
+inline constexpr size_t MAX_TXS_IN_FLIGHT_PER_PEER = 100;
+inline constexpr size_t MAX_BLOCKS_IN_FLIGHT_PER_PEER = 16;
+
+// how long a peer has to deliver before the item is asked from the next peer that announced it
+inline constexpr int TX_REQUEST_TIMEOUT_SECS = 30;
+inline constexpr int BLOCK_REQUEST_TIMEOUT_SECS = 20;
+
+// peers remembered per item to fall back on
+inline constexpr size_t MAX_ANNOUNCERS_PER_ITEM = 8;
+
+// items one peer can have announced and not delivered yet, further announcements from it are
+// ignored until some are, so an inv flood can't grow the tracker
+inline constexpr size_t MAX_ANNOUNCEMENTS_PER_PEER = 5'000;
+
+// getdata items to send, by remote address of the peer to ask
+using RequestBatches = std::unordered_map<std::string, std::vector<InvVector>>;
+
+// decides which peer an announced tx or block is downloaded from, so each is asked from one
+// peer at a time however many announce it
+// items wait in announcement order for one of their announcers to have a free slot, and one that
+// is not delivered in time is handed to the next announcer
+class RequestTracker {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Request {
+                InvVector inv;
+                uint64_t sequence;  // announcement order, sync needs blocks asked for in it
+                std::vector<std::string> announcers;  // not asked yet, first announcer first
+                std::string inFlightPeer;             // empty while waiting
+                Clock::time_point deadline;
+        };
+
+        struct PeerLoad {
+                size_t txs = 0;
+                size_t blocks = 0;
+        };
+
+        std::unordered_map<Hash256, Request> requests;
+        // requests not in flight, in announcement order
+        std::set<std::pair<uint64_t, Hash256>> waiting;
+        // requests in flight, soonest deadline first
+        std::set<std::pair<Clock::time_point, Hash256>> byDeadline;
+        std::unordered_map<std::string, PeerLoad> load;
+        // requests each peer is an announcer of or has in flight
+        std::unordered_map<std::string, size_t> announced;
+        uint64_t nextSequence = 0;
+
+        mutable std::mutex mtx;
+
+        bool HasSlot(const std::string& peer, InvType type) const;
+        // moves a waiting request in flight at one of its announcers
+        void Assign(Request& request, const std::string& peer, Clock::time_point now);
+        // takes a request out of flight, it waits again or is dropped if nobody else has it
+        void Unassign(std::unordered_map<Hash256, Request>::iterator it);
+        // the peer stopped being an announcer of a request
+        void Release(const std::string& peer);
+
+    public:
+        RequestTracker() = default;
+
+        // records that the peer has the items, returns the ones to ask it for right away
+        std::vector<InvVector> Announce(const std::string& peer,
+                                        const std::vector<InvVector>& items);
+
+        // the item arrived, from whichever peer
+        void Received(const Hash256& hash);
+
+        // takes timed out requests away from their peers, dropping the ones no other peer
+        // announced, then hands what is waiting to the first announcer with a free slot
+        RequestBatches Dispatch();
+
+        // forgets a disconnected peer, what it was asked for goes to another announcer on the
+        // next Dispatch
+        void RemovePeer(const std::string& peer);
+
+        // whether the peer has a block request outstanding
+        bool HasBlocksInFlight(const std::string& peer) const;
+
+        size_t Size() const;
+};
+
+#endif
\ No newline at end of file
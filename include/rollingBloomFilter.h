@@ -0,0 +1,35 @@
+#ifndef ROLLINGBLOOMFILTER_H
+#define ROLLINGBLOOMFILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "hash256.h"
+
+// a bloom filter that remembers roughly the last maxElements hashes inserted, older ones fall
+// out a generation (half of maxElements) at a time so the memory stays fixed
+// every bit position holds the 2 bit generation that last set it, generation 0 meaning unset,
+// and starting a new generation clears the positions of the one three generations back
+// not thread safe, callers lock around it
+class RollingBloomFilter {
+    private:
+        std::vector<uint64_t> data;  // bit planes in pairs: low and high bit of the generation
+        uint32_t hashFuncs;
+        uint32_t entriesPerGeneration;
+        uint32_t entriesThisGeneration = 0;
+        uint32_t generation = 1;
+        uint64_t tweak;  // random per filter, so nobody can grind hashes that collide in it
+
+        uint32_t Hash(uint32_t n, const Hash256& key) const;
+
+    public:
+        // fpRate is the false positive rate while holding maxElements
+        RollingBloomFilter(uint32_t maxElements, double fpRate);
+
+        void Insert(const Hash256& key);
+        bool Contains(const Hash256& key) const;
+        void Reset();
+};
+
+#endif
\ No newline at end of file
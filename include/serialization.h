@@ -5,9 +5,16 @@
 #include <string>
 #include <vector>
 
-// hex string conversions
+// hex string conversions, HexStringToByteArray throws on non-hex characters
 std::string ByteArrayToHexString(const std::vector<uint8_t>& bytes);
+std::string ByteArrayToHexString(const uint8_t* data, size_t len);
 std::vector<uint8_t> HexStringToByteArray(const std::string& hex);
+
+// allocation free variants writing into caller buffers
+// HexEncode writes exactly 2 * len characters (no terminator)
+// HexDecode reads an even number of characters into len / 2 bytes, false on bad input
+void HexEncode(const uint8_t* data, size_t len, char* out);
+bool HexDecode(const char* hex, size_t len, uint8_t* out);
 std::string IntToHexString(int64_t num);
 
 // integer to byte conversions
@@ -0,0 +1,20 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+
+// hashes count independent messages of the same length, stored back to back
+// in holds count * len bytes, out receives count * 32 byte digests in the same order
+// the kernel (SHA-NI, 8-way AVX2 or portable) is picked once on first use
+void SHA256Batch(const uint8_t* in, size_t len, size_t count, uint8_t* out);
+
+// name of the kernel SHA256Batch dispatches to on this cpu
+const char* SHA256BatchKernel();
+
+// runs the named kernel ("shani", "avx2" or "generic") instead of the selected one, for tests
+// returns false when this cpu cannot run it
+bool SHA256BatchWithKernel(const char* kernel, const uint8_t* in, size_t len, size_t count,
+                           uint8_t* out);
+
+#endif
\ No newline at end of file
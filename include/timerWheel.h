@@ -0,0 +1,89 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// resolution of the wheel, a timer fires at most this much after its deadline
+inline constexpr int TIMER_WHEEL_TICK_MS = 10;
+
+// slots per level as a power of two, and levels, together they reach 2^24 ticks (~46h) ahead
+// timers further out sit in the last level until they come within reach
+inline constexpr int TIMER_WHEEL_SLOT_BITS = 6;
+inline constexpr size_t TIMER_WHEEL_LEVELS = 4;
+
+using TimerId = uint64_t;
+
+// runs callbacks after a delay, or repeatedly, on one thread however many timers are pending
+// a timer is filed in the slot of its deadline at the coarsest level that still tells it apart,
+// and moves down a level each time the level below wraps, so scheduling, cancelling and firing
+// are O(1) and the thread only wakes up when a slot is due
+// callbacks run without the wheel's lock and may schedule or cancel, they should not block long
+// since every other timer waits on them
+class TimerWheel {
+    private:
+        using Clock = std::chrono::steady_clock;
+        static constexpr size_t SLOTS = size_t{1} << TIMER_WHEEL_SLOT_BITS;
+        static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+
+        struct Timer {
+                uint64_t deadlineTick;
+                Clock::duration interval;  // zero for one shot timers
+                std::function<void()> callback;
+        };
+
+        // only the ids live in the slots, a cancelled timer's id is skipped when its slot comes up
+        std::unordered_map<TimerId, Timer> timers;
+        std::array<std::array<std::vector<TimerId>, SLOTS>, TIMER_WHEEL_LEVELS> slots;
+        TimerId nextId = 1;
+
+        Clock::time_point start;
+        uint64_t currentTick = 0;  // the next tick to run, everything before it has fired
+
+        bool stopping = false;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::thread thread;
+
+        // first tick at or after when, and the last tick that is due by when
+        uint64_t TickAt(Clock::time_point when) const;
+        uint64_t DueTick(Clock::time_point when) const;
+        void Insert(TimerId id, uint64_t deadlineTick);
+        // refiles the timers of the level's slot for the current tick one level down
+        void Cascade(size_t level);
+        // ticks until the next level 0 slot with timers, or until level 0 wraps
+        uint64_t TicksToNextSlot() const;
+        void Run();
+
+        TimerId Add(Clock::duration delay, Clock::duration interval,
+                    std::function<void()> callback);
+
+    public:
+        TimerWheel();
+        ~TimerWheel();
+
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        // runs the callback once after delay
+        TimerId Schedule(Clock::duration delay, std::function<void()> callback);
+        // runs the callback every interval, measured from the end of the previous run
+        TimerId ScheduleEvery(Clock::duration interval, std::function<void()> callback);
+
+        // a timer already due may still be running, a repeating one is not rescheduled after it
+        void Cancel(TimerId id);
+
+        size_t Size();
+
+        // drops every pending timer and joins the thread, a running callback finishes first
+        void Stop();
+};
+
+#endif
\ No newline at end of file
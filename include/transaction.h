@@ -4,11 +4,15 @@
 #include <openssl/evp.h>
 
 #include <cstdint>
-#include <map>
+#include <memory>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "byteStream.h"
 #include "config.h"
+#include "hash256.h"
 #include "transactionInput.h"
 #include "transactionOutput.h"
 
@@ -18,26 +22,35 @@ class Wallet;
 
 class Transaction {
     private:
-        std::vector<uint8_t> id;
+        Hash256 id;
         std::vector<TransactionInput> vin;
         std::vector<TransactionOutput> vout;
 
+        // wire bytes captured when the transaction was finalized, shared between copies
+        // while set, id is the SHA-256 of exactly these bytes
+        std::shared_ptr<const std::vector<uint8_t>> wire;
+
+        // serializes once and recomputes id and the cached wire bytes, call after mutating
+        void UpdateCache();
+
     public:
         Transaction() = default;
-        Transaction(const std::vector<uint8_t>& id, const std::vector<TransactionInput>& vin,
+        Transaction(const Hash256& id, const std::vector<TransactionInput>& vin,
                     const std::vector<TransactionOutput>& vout);
-        const std::vector<uint8_t>& GetID() const { return id; }
+        const Hash256& GetID() const { return id; }
         const std::vector<TransactionInput>& GetVin() const { return vin; }
         const std::vector<TransactionOutput>& GetVout() const { return vout; }
 
         bool IsCoinbase() const;
 
-        std::vector<uint8_t> Hash() const;
-        void Sign(EVP_PKEY* privKey, const std::map<std::string, Transaction>& prevTXs);
-        bool Verify(const std::map<std::string, Transaction>& prevTXs) const;
+        // the cached id when the wire bytes are known, otherwise hashes a fresh serialization
+        Hash256 Hash() const;
+        // prevTXs maps the txid of every spent output to the transaction that created it
+        void Sign(EVP_PKEY* privKey, const std::unordered_map<Hash256, Transaction>& prevTXs);
+        bool Verify(const std::unordered_map<Hash256, Transaction>& prevTXs) const;
 
         // fee = sum(input values) - sum(output values)
-        int64_t CalculateFee(const std::map<std::string, Transaction>& prevTXs) const;
+        int64_t CalculateFee(const std::unordered_map<Hash256, Transaction>& prevTXs) const;
 
         Transaction TrimmedCopy() const;
 
@@ -46,8 +59,12 @@ class Transaction {
         static Transaction NewUTXOTransaction(Wallet* wallet, Blockchain* bc, const std::string& to,
                                               int64_t amount, UTXOSet* utxoSet);
 
+        // these reuse the cached wire bytes when present
+        size_t SerializedSize() const;
+        void Serialize(ByteWriter& writer) const;
         std::vector<uint8_t> Serialize() const;
-        static Transaction Deserialize(const std::vector<uint8_t>& data);
+        static Transaction Deserialize(ByteReader& reader);
+        static Transaction Deserialize(std::span<const uint8_t> data);
 };
 
 #endif
\ No newline at end of file
@@ -3,34 +3,38 @@
 
 #include <cstdint>
 #include <string>
-#include <utility>
 #include <vector>
 
+#include "byteStream.h"
+#include "hash256.h"
+#include "outPoint.h"
+
 class TransactionInput {
         friend class Transaction;
 
     private:
-        std::vector<uint8_t> txid;
+        Hash256 txid;  // null for the coinbase input
         int vout;
         std::vector<uint8_t> signature;
         std::vector<uint8_t> pubKey;
 
     public:
         TransactionInput() = default;
-        TransactionInput(const std::vector<uint8_t>& txid, int vout,
-                         const std::vector<uint8_t>& signature, const std::vector<uint8_t>& pubKey);
+        TransactionInput(const Hash256& txid, int vout, const std::vector<uint8_t>& signature,
+                         const std::vector<uint8_t>& pubKey);
 
-        const std::vector<uint8_t>& GetTxid() const { return txid; }
+        const Hash256& GetTxid() const { return txid; }
         int GetVout() const { return vout; }
+        OutPoint GetPrevOut() const { return {txid, vout}; }
 
         const std::vector<uint8_t>& GetSignature() const { return signature; }
         const std::vector<uint8_t>& GetPubKey() const { return pubKey; }
 
         bool UsesKey(const std::vector<uint8_t>& pubKeyHash) const;
 
-        std::vector<uint8_t> Serialize() const;
-        static std::pair<TransactionInput, size_t> Deserialize(const std::vector<uint8_t>& data,
-                                                               size_t offset);
+        size_t SerializedSize() const;
+        void Serialize(ByteWriter& writer) const;
+        static TransactionInput Deserialize(ByteReader& reader);
 };
 
 #endif
\ No newline at end of file
@@ -3,10 +3,12 @@
 
 #include <cstdint>
 #include <map>
+#include <span>
 #include <string>
-#include <utility>
 #include <vector>
 
+#include "byteStream.h"
+
 class TransactionOutput {
     private:
         int64_t value;
@@ -23,9 +25,9 @@ class TransactionOutput {
 
         bool IsLockedWithKey(const std::vector<uint8_t>& pubKeyHash) const;
 
-        std::vector<uint8_t> Serialize() const;
-        static std::pair<TransactionOutput, size_t> Deserialize(const std::vector<uint8_t>& data,
-                                                                size_t offset);
+        size_t SerializedSize() const { return 8 + 4 + pubKeyHash.size(); }
+        void Serialize(ByteWriter& writer) const;
+        static TransactionOutput Deserialize(ByteReader& reader);
 };
 
 // struct to store multiple outputs keyed by their original transaction output index
@@ -35,7 +37,7 @@ struct TXOutputs {
         int32_t blockHeight{0};
 
         std::vector<uint8_t> Serialize() const;
-        static TXOutputs Deserialize(const std::vector<uint8_t>& data);
+        static TXOutputs Deserialize(std::span<const uint8_t> data);
 };
 
 // factory function to make object creation easier
@@ -4,14 +4,20 @@
 #include <leveldb/slice.h>
 
 #include <cstdint>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
 // access to all utilities.
 #include "crypto.h"
+#include "hash256.h"
 #include "serialization.h"
 
 // converts vector to LevelDB's internal Slice format
 leveldb::Slice ByteArrayToSlice(const std::vector<uint8_t>& bytes);
+leveldb::Slice ByteArrayToSlice(const Hash256& hash);
+
+// views a LevelDB slice as bytes without copying, valid only while the slice's storage lives
+std::span<const uint8_t> SliceToBytes(const leveldb::Slice& slice);
 
 #endif
\ No newline at end of file
@@ -9,6 +9,8 @@
 #include <string>
 #include <vector>
 
+#include "hash256.h"
+#include "outPoint.h"
 #include "transactionOutput.h"
 
 class Blockchain;
@@ -29,13 +31,16 @@ class UTXOSet {
         UTXOSet(const UTXOSet&) = delete;
         UTXOSet& operator=(const UTXOSet&) = delete;
 
-        std::pair<int64_t, std::map<std::string, std::vector<int>>> FindSpendableOutputs(
+        std::pair<int64_t, std::map<Hash256, std::vector<int>>> FindSpendableOutputs(
             const std::vector<uint8_t>& pubKeyHash, int64_t amount) const;
 
         std::vector<TransactionOutput> FindUTXO(const std::vector<uint8_t>& pubKeyHash) const;
 
         int CountTransactions() const;
 
+        // whether the output exists in the chain and has not been spent by a block yet
+        bool IsUnspent(const OutPoint& outpoint) const;
+
         void Reindex();
 
         void Update(const Block& block);
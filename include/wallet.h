@@ -4,11 +4,14 @@
 #include <openssl/evp.h>
 
 #include <cstdint>
-#include <map>
 #include <memory>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "hash256.h"
+
 const uint8_t VERSION = 0x00;
 const int ADDRESS_CHECKSUM_LEN = 4;
 
@@ -26,7 +29,7 @@ class Wallet {
         std::vector<uint8_t> publicKey;
 
         static std::pair<EVP_PKEY_owned, std::vector<uint8_t>> NewKeyPair();
-        static std::vector<uint8_t> Checksum(const std::vector<uint8_t>& payload);
+        static std::vector<uint8_t> Checksum(std::span<const uint8_t> payload);
         std::vector<uint8_t> GetPrivateKeyBytes() const;
         Wallet(const std::vector<uint8_t>& privKeyBytes, const std::vector<uint8_t>& pubKeyBytes);
 
@@ -42,7 +45,8 @@ class Wallet {
         const std::vector<uint8_t>& GetPublicKey() const { return publicKey; }
 
         // signs a transaction using this wallet's private key.
-        void SignTransaction(Transaction* tx, const std::map<std::string, Transaction>& prevTXs);
+        void SignTransaction(Transaction* tx,
+                             const std::unordered_map<Hash256, Transaction>& prevTXs);
 
         static std::vector<uint8_t> HashPubKey(const std::vector<uint8_t>& pubKey);
         static bool ValidateAddress(const std::string& address);
@@ -5,172 +5,279 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <numeric>
-#include <random>
+#include <unordered_set>
 
+#include "byteStream.h"
 #include "config.h"
-#include "serialization.h"
+#include "crypto.h"
+
+// serialized size of one peers.dat entry: address with time, source group, tried flag
+static constexpr size_t ADDR_FILE_ENTRY_SIZE = 30 + 2 + 1;
+// version, bucket key and count in front of the entries
+static constexpr size_t ADDR_FILE_HEADER_SIZE = 4 + HASH256_SIZE + 4;
+
+// first 8 bytes of SHA-256(salt || what the writer holds), little-endian
+static uint64_t SaltedHash(const ByteWriter& writer) {
+    Hash256 digest = SHA256Digest(writer.Data());
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value |= static_cast<uint64_t>(digest[i]) << (8 * i);
+    return value;
+}
+
+static bool IsStale(const NetAddr& addr, uint32_t now) {
+    return static_cast<uint64_t>(addr.time) + ADDR_MAX_AGE_SECS < now;
+}
 
-std::string AddrManager::MakeKey(const NetAddr& addr) {
-    return ExtractIPv4(addr) + ":" + std::to_string(addr.port);
+AddrManager::AddrManager()
+    : newTable(ADDR_NEW_BUCKETS * ADDR_BUCKET_SIZE, 0),
+      triedTable(ADDR_TRIED_BUCKETS * ADDR_BUCKET_SIZE, 0),
+      rng(std::random_device{}()) {
+    for (auto& byte : bucketKey) byte = static_cast<uint8_t>(rng());
+}
+
+AddrKey AddrManager::MakeKey(const NetAddr& addr) { return AddrKey{addr.ip, addr.port}; }
+
+std::optional<AddrKey> AddrManager::MakeKey(const std::string& ip, uint16_t port) {
+    try {
+        return MakeKey(NetAddr(0, ip, port));
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
 }
 
-std::string AddrManager::ExtractIPv4(const NetAddr& addr) {
+uint16_t AddrManager::Group(const std::array<uint8_t, 16>& ip) {
     // NetAddr stores IPv4 as IPv4-mapped IPv6: [10 zeros][0xFF][0xFF][4 IPv4 bytes]
-    return std::to_string(addr.ip[12]) + "." + std::to_string(addr.ip[13]) + "." +
-           std::to_string(addr.ip[14]) + "." + std::to_string(addr.ip[15]);
+    return static_cast<uint16_t>((ip[12] << 8) | ip[13]);
 }
 
-void AddrManager::SetSelfAddr(const std::string& ip, uint16_t port) {
-    std::lock_guard<std::mutex> lock(mtx);
-    selfAddr = ip + ":" + std::to_string(port);
+size_t AddrManager::NewSlot(const AddrKey& key, uint16_t sourceGroup) const {
+    // the address's group picks one of the buckets its source group can reach
+    ByteWriter writer;
+    writer.WriteHash256(bucketKey);
+    writer.WriteUint8('N');
+    writer.WriteUint16BE(Group(key.ip));
+    writer.WriteUint16BE(sourceGroup);
+    uint64_t sourceBucket = SaltedHash(writer) % ADDR_NEW_BUCKETS_PER_SOURCE_GROUP;
+
+    writer = ByteWriter();
+    writer.WriteHash256(bucketKey);
+    writer.WriteUint8('N');
+    writer.WriteUint16BE(sourceGroup);
+    writer.WriteUint64(sourceBucket);
+    uint64_t bucket = SaltedHash(writer) % ADDR_NEW_BUCKETS;
+
+    writer = ByteWriter();
+    writer.WriteHash256(bucketKey);
+    writer.WriteUint8('n');
+    writer.WriteUint64(bucket);
+    writer.WriteBytes(key.ip);
+    writer.WriteUint16BE(key.port);
+    return bucket * ADDR_BUCKET_SIZE + SaltedHash(writer) % ADDR_BUCKET_SIZE;
 }
 
-void AddrManager::Add(const NetAddr& addr) {
-    std::lock_guard<std::mutex> lock(mtx);
+size_t AddrManager::TriedSlot(const AddrKey& key) const {
+    // the address picks one of the buckets its group can reach
+    ByteWriter writer;
+    writer.WriteHash256(bucketKey);
+    writer.WriteUint8('T');
+    writer.WriteBytes(key.ip);
+    writer.WriteUint16BE(key.port);
+    uint64_t groupBucket = SaltedHash(writer) % ADDR_TRIED_BUCKETS_PER_GROUP;
+
+    writer = ByteWriter();
+    writer.WriteHash256(bucketKey);
+    writer.WriteUint8('T');
+    writer.WriteUint16BE(Group(key.ip));
+    writer.WriteUint64(groupBucket);
+    uint64_t bucket = SaltedHash(writer) % ADDR_TRIED_BUCKETS;
+
+    writer = ByteWriter();
+    writer.WriteHash256(bucketKey);
+    writer.WriteUint8('t');
+    writer.WriteUint64(bucket);
+    writer.WriteBytes(key.ip);
+    writer.WriteUint16BE(key.port);
+    return bucket * ADDR_BUCKET_SIZE + SaltedHash(writer) % ADDR_BUCKET_SIZE;
+}
 
-    std::string key = MakeKey(addr);
+void AddrManager::Place(uint32_t id, AddrInfo& info, bool tried, size_t slot) {
+    Table(tried)[slot] = id;
+    info.tried = tried;
+    info.slot = slot;
+    info.index = TableIds(tried).size();
+    TableIds(tried).push_back(id);
+}
 
-    // we don't store our own address
-    if (key == selfAddr) {
-        return;
-    }
+void AddrManager::Unplace(AddrInfo& info) {
+    Table(info.tried)[info.slot] = 0;
+
+    // swap the last id into its place
+    std::vector<uint32_t>& tableIds = TableIds(info.tried);
+    uint32_t last = tableIds.back();
+    tableIds[info.index] = last;
+    infos.at(last).index = info.index;
+    tableIds.pop_back();
+}
+
+void AddrManager::Delete(uint32_t id) {
+    auto it = infos.find(id);
+    if (it == infos.end()) return;
+
+    Unplace(it->second);
+    idByKey.erase(MakeKey(it->second.addr));
+    infos.erase(it);
+}
 
+void AddrManager::AddLocked(const NetAddr& addr, uint16_t sourceGroup, uint32_t now) {
     // we reject addresses with port 0
     if (addr.port == 0) {
         return;
     }
 
     // don't add anything in future from clock skew
-    uint32_t now = static_cast<uint32_t>(std::time(nullptr));
-    if (addr.time > now + 600) return;
+    if (addr.time > now + 600) {
+        return;
+    }
 
-    auto it = addresses.find(key);
-    if (it != addresses.end()) {
+    AddrKey key = MakeKey(addr);
+
+    // we don't store our own address
+    if (selfKey && *selfKey == key) {
+        return;
+    }
+
+    auto it = idByKey.find(key);
+    if (it != idByKey.end()) {
         // if we know it we update timestamp if the new one is more recent
-        if (addr.time > it->second.time) {
-            it->second.time = addr.time;
+        AddrInfo& info = infos.at(it->second);
+        if (addr.time > info.addr.time) {
+            info.addr.time = addr.time;
         }
         return;
     }
 
-    // if we are at capacity, we evict the oldest address to make room
-    if (addresses.size() >= ADDR_MANAGER_MAX_ENTRIES) {
-        auto oldest = addresses.begin();
-        for (auto it2 = addresses.begin(); it2 != addresses.end(); ++it2) {
-            if (it2->second.time < oldest->second.time) {
-                oldest = it2;
-            }
+    // a newcomer only displaces an address that is stale or older than itself
+    size_t slot = NewSlot(key, sourceGroup);
+    if (uint32_t occupant = newTable[slot]; occupant != 0) {
+        const NetAddr& existing = infos.at(occupant).addr;
+        if (!IsStale(existing, now) && existing.time >= addr.time) {
+            return;
         }
-        addresses.erase(oldest);
+        Delete(occupant);
     }
 
-    addresses[key] = addr;
+    uint32_t id = nextId++;
+    AddrInfo& info = infos[id];
+    info.addr = addr;
+    info.sourceGroup = sourceGroup;
+    idByKey[key] = id;
+    Place(id, info, false, slot);
+}
+
+const AddrManager::AddrInfo& AddrManager::EntryAt(size_t index) const {
+    if (index < newIds.size()) return infos.at(newIds[index]);
+    return infos.at(triedIds[index - newIds.size()]);
 }
 
-void AddrManager::AddMultiple(const std::vector<NetAddr>& addrs) {
+void AddrManager::SetSelfAddr(const std::string& ip, uint16_t port) {
     std::lock_guard<std::mutex> lock(mtx);
+    selfKey = MakeKey(ip, port);
+}
 
-    uint32_t now = static_cast<uint32_t>(std::time(nullptr));
+void AddrManager::Add(const NetAddr& addr, const std::string& sourceIP) {
+    AddMultiple({addr}, sourceIP);
+}
 
-    for (const auto& addr : addrs) {
-        std::string key = MakeKey(addr);
+void AddrManager::AddMultiple(const std::vector<NetAddr>& addrs, const std::string& sourceIP) {
+    std::optional<AddrKey> source = sourceIP.empty() ? std::nullopt : MakeKey(sourceIP, 0);
 
-        if (key == selfAddr) {
-            continue;
-        }
+    std::lock_guard<std::mutex> lock(mtx);
 
-        if (addr.port == 0) {
-            continue;
-        }
+    uint32_t now = static_cast<uint32_t>(std::time(nullptr));
+    for (const auto& addr : addrs) {
+        AddLocked(addr, Group(source ? source->ip : addr.ip), now);
+    }
+}
 
-        // don't add anything in future from clock skew
-        if (addr.time > now + 600) {
-            continue;
-        }
+void AddrManager::MarkGood(const std::string& ip, uint16_t port) {
+    std::optional<AddrKey> key = MakeKey(ip, port);
+    if (!key) return;
 
-        auto it = addresses.find(key);
-        if (it != addresses.end()) {
-            if (addr.time > it->second.time) {
-                it->second.time = addr.time;
-            }
-            continue;
-        }
+    std::lock_guard<std::mutex> lock(mtx);
 
-        if (addresses.size() >= ADDR_MANAGER_MAX_ENTRIES) {
-            auto oldest = addresses.begin();
-            for (auto it2 = addresses.begin(); it2 != addresses.end(); ++it2) {
-                if (it2->second.time < oldest->second.time) {
-                    oldest = it2;
-                }
-            }
-            addresses.erase(oldest);
-        }
+    auto it = idByKey.find(*key);
+    if (it == idByKey.end()) {
+        return;
+    }
 
-        addresses[key] = addr;
+    uint32_t id = it->second;
+    AddrInfo& info = infos.at(id);
+    info.addr.time = static_cast<uint32_t>(std::time(nullptr));
+    if (info.tried) {
+        return;
     }
-}
 
-void AddrManager::MarkGood(const std::string& ip, uint16_t port) {
-    std::lock_guard<std::mutex> lock(mtx);
+    Unplace(info);
+
+    // whoever holds its tried slot goes back to the new table, taking the new slot it maps to
+    size_t slot = TriedSlot(*key);
+    if (uint32_t occupant = triedTable[slot]; occupant != 0) {
+        AddrInfo& evicted = infos.at(occupant);
+        Unplace(evicted);
 
-    std::string key = ip + ":" + std::to_string(port);
-    auto it = addresses.find(key);
-    if (it != addresses.end()) {
-        it->second.time = static_cast<uint32_t>(std::time(nullptr));
+        size_t newSlot = NewSlot(MakeKey(evicted.addr), evicted.sourceGroup);
+        if (newTable[newSlot] != 0) Delete(newTable[newSlot]);
+        Place(occupant, evicted, false, newSlot);
     }
+
+    Place(id, info, true, slot);
 }
 
 void AddrManager::Remove(const std::string& ip, uint16_t port) {
+    std::optional<AddrKey> key = MakeKey(ip, port);
+    if (!key) return;
+
     std::lock_guard<std::mutex> lock(mtx);
-    addresses.erase(ip + ":" + std::to_string(port));
+    auto it = idByKey.find(*key);
+    if (it != idByKey.end()) {
+        Delete(it->second);
+    }
 }
 
 std::vector<NetAddr> AddrManager::GetRandomAddresses(
     size_t count, const std::vector<std::string>& excludeAddrs) const {
+    // skip addresses we're already connected to
+    std::unordered_set<AddrKey> excluded;
+    for (const auto& ex : excludeAddrs) {
+        size_t colon = ex.rfind(':');
+        if (colon == std::string::npos) continue;
+        try {
+            auto port = static_cast<uint16_t>(std::stoi(ex.substr(colon + 1)));
+            if (auto key = MakeKey(ex.substr(0, colon), port)) excluded.insert(*key);
+        } catch (const std::exception&) {
+        }
+    }
+
     std::lock_guard<std::mutex> lock(mtx);
 
     uint32_t now = static_cast<uint32_t>(std::time(nullptr));
 
-    // we collect all non-stale addresses
-    std::vector<const NetAddr*> candidates;
-    candidates.reserve(addresses.size());
-
-    for (const auto& [key, addr] : addresses) {
-        // skip stale addresses
-        if (now - addr.time > ADDR_MAX_AGE_SECS) {
-            continue;
-        }
-
-        // skip addresses we're already connected to
-        bool excluded = false;
-        for (const auto& ex : excludeAddrs) {
-            if (key == ex) {
-                excluded = true;
-                break;
-            }
-        }
-        if (excluded) {
-            continue;
-        }
-
-        candidates.push_back(&addr);
-    }
+    // pick a table, then an address in it, until we have count or run out of tries
+    std::vector<NetAddr> result;
+    std::unordered_set<uint32_t> picked;
+    for (size_t tries = count * ADDR_SELECT_TRIES; tries > 0 && result.size() < count; tries--) {
+        if (newIds.empty() && triedIds.empty()) break;
 
-    // shuffle and take up to count
-    std::vector<size_t> indices(candidates.size());
-    std::iota(indices.begin(), indices.end(), 0);
+        bool tried = newIds.empty() || (!triedIds.empty() && (rng() & 1));
+        const std::vector<uint32_t>& tableIds = tried ? triedIds : newIds;
+        uint32_t id = tableIds[std::uniform_int_distribution<size_t>(0, tableIds.size() - 1)(rng)];
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::shuffle(indices.begin(), indices.end(), gen);
+        if (!picked.insert(id).second) continue;
 
-    std::vector<NetAddr> result;
-    size_t resultCount = std::min(count, candidates.size());
-    result.reserve(resultCount);
+        const NetAddr& addr = infos.at(id).addr;
+        if (IsStale(addr, now) || excluded.count(MakeKey(addr)) > 0) continue;
 
-    for (size_t i = 0; i < resultCount; i++) {
-        result.push_back(*candidates[indices[i]]);
+        result.push_back(addr);
     }
 
     return result;
@@ -181,30 +288,22 @@ std::vector<NetAddr> AddrManager::GetAddressesForGossip() const {
 
     uint32_t now = static_cast<uint32_t>(std::time(nullptr));
 
-    // collect all non-stale addresses
-    std::vector<const NetAddr*> candidates;
-    candidates.reserve(addresses.size());
-
-    for (const auto& [key, addr] : addresses) {
-        if (now - addr.time <= ADDR_MAX_AGE_SECS) {
-            candidates.push_back(&addr);
-        }
+    // Floyd's sampling, ADDR_GETADDR_MAX distinct entries without touching the rest
+    size_t total = newIds.size() + triedIds.size();
+    size_t sampleCount = std::min(ADDR_GETADDR_MAX, total);
+    std::unordered_set<size_t> sample;
+    sample.reserve(sampleCount);
+    for (size_t j = total - sampleCount; j < total; j++) {
+        size_t t = std::uniform_int_distribution<size_t>(0, j)(rng);
+        if (!sample.insert(t).second) sample.insert(j);
     }
 
-    // shuffle and take up to ADDR_GETADDR_MAX
-    std::vector<size_t> indices(candidates.size());
-    std::iota(indices.begin(), indices.end(), 0);
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::shuffle(indices.begin(), indices.end(), gen);
-
+    // the stale ones are dropped, not replaced
     std::vector<NetAddr> result;
-    size_t resultCount = std::min(static_cast<size_t>(ADDR_GETADDR_MAX), candidates.size());
-    result.reserve(resultCount);
-
-    for (size_t i = 0; i < resultCount; i++) {
-        result.push_back(*candidates[indices[i]]);
+    result.reserve(sample.size());
+    for (size_t index : sample) {
+        const NetAddr& addr = EntryAt(index).addr;
+        if (!IsStale(addr, now)) result.push_back(addr);
     }
 
     return result;
@@ -212,39 +311,67 @@ std::vector<NetAddr> AddrManager::GetAddressesForGossip() const {
 
 size_t AddrManager::Size() const {
     std::lock_guard<std::mutex> lock(mtx);
-    return addresses.size();
+    return infos.size();
 }
 
 bool AddrManager::Contains(const std::string& ip, uint16_t port) const {
+    std::optional<AddrKey> key = MakeKey(ip, port);
+    if (!key) return false;
+
     std::lock_guard<std::mutex> lock(mtx);
-    return addresses.count(ip + ":" + std::to_string(port)) > 0;
+    return idByKey.count(*key) > 0;
 }
 
 void AddrManager::SaveToFile() const {
-    std::lock_guard<std::mutex> lock(mtx);
+    // format: [version(4)] [bucket key(32)] [count(4)] [NetAddr with time, source group(2),
+    // tried(1)]..., the slots follow from the bucket key so they are not stored
+    std::vector<uint8_t> data;
+    size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        ByteWriter writer(ADDR_FILE_HEADER_SIZE + infos.size() * ADDR_FILE_ENTRY_SIZE);
+        writer.WriteUint32(ADDR_FILE_VERSION);
+        writer.WriteHash256(bucketKey);
+        writer.WriteUint32(static_cast<uint32_t>(infos.size()));
+        for (const auto& [id, info] : infos) {
+            info.addr.Serialize(writer, /*includeTime=*/true);
+            writer.WriteUint16BE(info.sourceGroup);
+            writer.WriteUint8(info.tried ? 1 : 0);
+        }
+        data = writer.Release();
+        count = infos.size();
+    }
 
+    // write a temporary file and rename it over the old one, so a crash mid write keeps the
+    // previous book intact
     std::string path = Config::GetPeersPath();
+    std::string tmpPath = path + ".new";
     std::filesystem::create_directories(std::filesystem::path(path).parent_path());
-
-    // format: [count(4)] [NetAddr with time]
-    std::vector<uint8_t> data;
-    WriteUint32(data, static_cast<uint32_t>(addresses.size()));
-
-    for (const auto& [key, addr] : addresses) {
-        std::vector<uint8_t> serialized = addr.Serialize(/*includeTime=*/true);
-        data.insert(data.end(), serialized.begin(), serialized.end());
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[addrmanager] Failed to open " << tmpPath << " for writing"
+                      << std::endl;
+            return;
+        }
+        out.write(reinterpret_cast<const char*>(data.data()),
+                  static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            std::cerr << "[addrmanager] Failed to write " << tmpPath << std::endl;
+            return;
+        }
     }
 
-    std::ofstream out(path, std::ios::binary);
-    if (!out) {
-        std::cerr << "[addrmanager] Failed to open " << path << " for writing" << std::endl;
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::cerr << "[addrmanager] Failed to replace " << path << ": " << ec.message()
+                  << std::endl;
         return;
     }
 
-    out.write(reinterpret_cast<const char*>(data.data()),
-              static_cast<std::streamsize>(data.size()));
-    std::cout << "[addrmanager] Saved " << addresses.size() << " addresses to " << path
-              << std::endl;
+    std::cout << "[addrmanager] Saved " << count << " addresses to " << path << std::endl;
 }
 
 void AddrManager::LoadFromFile() {
@@ -264,36 +391,64 @@ void AddrManager::LoadFromFile() {
     std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
                               std::istreambuf_iterator<char>());
 
-    if (data.size() < 4) {
+    if (data.size() < ADDR_FILE_HEADER_SIZE) {
         std::cerr << "[addrmanager] Peers file too small, ignoring" << std::endl;
         return;
     }
 
-    uint32_t count = ReadUint32(data, 0);
-    size_t offset = 4;
+    ByteReader reader(data);
+    uint32_t version = reader.ReadUint32();
+    if (version != ADDR_FILE_VERSION) {
+        std::cerr << "[addrmanager] Peers file has unsupported version " << version
+                  << ", ignoring" << std::endl;
+        return;
+    }
 
-    // cap to prevent corrupted file from allocating huge amounts
-    if (count > ADDR_MANAGER_MAX_ENTRIES) {
-        count = ADDR_MANAGER_MAX_ENTRIES;
+    Hash256 key = reader.ReadHash256();
+    uint32_t count = reader.ReadUint32();
+    if (reader.Remaining() != static_cast<size_t>(count) * ADDR_FILE_ENTRY_SIZE) {
+        std::cerr << "[addrmanager] Peers file is corrupted, ignoring" << std::endl;
+        return;
     }
 
+    // the slots were derived from the saved key, so start over with it
+    bucketKey = key;
+    infos.clear();
+    idByKey.clear();
+    std::fill(newTable.begin(), newTable.end(), 0);
+    std::fill(triedTable.begin(), triedTable.end(), 0);
+    newIds.clear();
+    triedIds.clear();
+
     size_t loaded = 0;
     for (uint32_t i = 0; i < count; ++i) {
-        try {
-            auto [addr, bytesRead] = NetAddr::Deserialize(data, offset, /*includeTime=*/true);
-            offset += bytesRead;
+        NetAddr addr = NetAddr::Deserialize(reader, /*includeTime=*/true);
+        uint16_t sourceGroup = reader.ReadUint16BE();
+        bool tried = reader.ReadUint8() != 0;
 
-            std::string key = MakeKey(addr);
-            if (key == selfAddr || addr.port == 0) continue;
+        AddrKey addrKey = MakeKey(addr);
+        if (addr.port == 0 || (selfKey && *selfKey == addrKey) || idByKey.count(addrKey) > 0) {
+            continue;
+        }
 
-            if (addresses.size() < ADDR_MANAGER_MAX_ENTRIES) {
-                addresses[key] = addr;
-                loaded++;
-            }
-        } catch (const std::exception&) {
-            // means it's a corrupted entry so we stop reading
-            break;
+        // a tried address whose slot is taken falls back to the new table
+        size_t slot = 0;
+        if (tried) {
+            slot = TriedSlot(addrKey);
+            if (triedTable[slot] != 0) tried = false;
+        }
+        if (!tried) {
+            slot = NewSlot(addrKey, sourceGroup);
+            if (newTable[slot] != 0) continue;
         }
+
+        uint32_t id = nextId++;
+        AddrInfo& info = infos[id];
+        info.addr = addr;
+        info.sourceGroup = sourceGroup;
+        idByKey[addrKey] = id;
+        Place(id, info, tried, slot);
+        loaded++;
     }
 
     std::cout << "[addrmanager] Loaded " << loaded << " addresses from " << path << std::endl;
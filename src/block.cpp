@@ -3,13 +3,14 @@
 #include <cstdint>
 #include <ctime>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
+#include "byteStream.h"
 #include "merkleTree.h"
 #include "proofOfWork.h"
-#include "serialization.h"
 
-Block::Block(const std::vector<Transaction>& transactions, const std::vector<uint8_t>& previousHash,
+Block::Block(const std::vector<Transaction>& transactions, const Hash256& previousHash,
              int32_t bits) {
     timestamp = std::time(nullptr);
     this->transactions = transactions;
@@ -17,113 +18,117 @@ Block::Block(const std::vector<Transaction>& transactions, const std::vector<uin
     this->bits = bits;
 
     ProofOfWork proofOfWork(this);
-    std::pair<int32_t, std::vector<uint8_t>> powResult = proofOfWork.Run();
+    std::pair<int32_t, Hash256> powResult = proofOfWork.Run();
     nonce = powResult.first;
     hash = powResult.second;
 }
 
+Block::Block(int64_t timestamp, std::vector<Transaction> transactions,
+             const Hash256& previousHash, const Hash256& hash, int32_t nonce, int32_t bits)
+    : timestamp(timestamp),
+      transactions(std::move(transactions)),
+      previousHash(previousHash),
+      hash(hash),
+      nonce(nonce),
+      bits(bits) {}
+
+size_t Block::SerializedSize() const {
+    // 8 (timestamp) + 4 (txcount) + 32 (prevHash) + 32 (hash) + 4 (nonce) + 4 (bits)
+    size_t size = 8 + 4 + 32 + 32 + 4 + 4;
+    for (const Transaction& tx : transactions) {
+        size += 4 + tx.SerializedSize();
+    }
+    return size;
+}
+
 std::vector<uint8_t> Block::Serialize() const {
-    std::vector<uint8_t> serialized;
+    ByteWriter writer(SerializedSize());
 
     // timestamp (8 bytes)
-    WriteUint64(serialized, static_cast<uint64_t>(timestamp));
+    writer.WriteUint64(static_cast<uint64_t>(timestamp));
 
     // number of transactions (4 bytes)
-    WriteUint32(serialized, static_cast<uint32_t>(transactions.size()));
+    writer.WriteUint32(static_cast<uint32_t>(transactions.size()));
 
     // each transaction
     for (const Transaction& tx : transactions) {
-        std::vector<uint8_t> txSerialized = tx.Serialize();
-
         // transaction size (4 bytes)
-        WriteUint32(serialized, static_cast<uint32_t>(txSerialized.size()));
+        writer.WriteUint32(static_cast<uint32_t>(tx.SerializedSize()));
 
         // transaction (variable bytes)
-        serialized.insert(serialized.end(), txSerialized.begin(), txSerialized.end());
+        tx.Serialize(writer);
     }
 
-    // previous hash (32 bytes)
-    if (!previousHash.empty()) {
-        serialized.insert(serialized.end(), previousHash.begin(), previousHash.end());
-    } else {
-        serialized.insert(serialized.end(), 32, 0);
-    }
+    // previous hash (32 bytes), all zero for the genesis block
+    writer.WriteHash256(previousHash);
 
     // hash (32 bytes)
-    serialized.insert(serialized.end(), hash.begin(), hash.end());
+    writer.WriteHash256(hash);
 
     // nonce (4 bytes)
-    WriteUint32(serialized, static_cast<uint32_t>(nonce));
+    writer.WriteUint32(static_cast<uint32_t>(nonce));
 
     // bits (4 bytes)
-    WriteUint32(serialized, static_cast<uint32_t>(bits));
+    writer.WriteUint32(static_cast<uint32_t>(bits));
 
-    return serialized;
+    return writer.Release();
 }
 
-Block Block::Deserialize(const std::vector<uint8_t>& serialized) {
+Block Block::Deserialize(std::span<const uint8_t> serialized) {
     Block block;
-    size_t offset = 0;
 
     // 8 (timestamp) + 4 (txcount) + 32 (prevHash) + 32 (hash) + 4 (nonce) + 4 (bits)
     if (serialized.size() < 8 + 4 + 32 + 32 + 4 + 4) {
         throw std::runtime_error("Block data too small to deserialize");
     }
 
+    ByteReader reader(serialized);
+
     // timestamp (8 bytes)
-    block.timestamp = static_cast<int64_t>(ReadUint64(serialized, offset));
-    offset += 8;
+    block.timestamp = static_cast<int64_t>(reader.ReadUint64());
 
     // number of transactions (4 bytes)
-    uint32_t txCount = ReadUint32(serialized, offset);
-    offset += 4;
+    uint32_t txCount = reader.ReadUint32();
 
     if (txCount > Policy::MAX_BLOCK_TXS) {
         throw std::runtime_error("Block transaction count " + std::to_string(txCount) +
                                  " exceeds maximum " + std::to_string(Policy::MAX_BLOCK_TXS));
     }
 
-    // each transaction
+    // each transaction, parsed in place from a view of the block buffer
+    block.transactions.reserve(txCount);
     for (uint32_t i = 0; i < txCount; i++) {
         // transaction size (4 bytes)
-        uint32_t txSize = ReadUint32(serialized, offset);
-        offset += 4;
+        uint32_t txSize = reader.ReadUint32();
 
-        if (offset + txSize > serialized.size()) {
+        if (txSize > reader.Remaining()) {
             throw std::runtime_error("Block data truncated: transaction extends past end");
         }
 
         // transaction (variable bytes)
-        block.transactions.push_back(Transaction::Deserialize(std::vector<uint8_t>(
-            serialized.begin() + offset, serialized.begin() + offset + txSize)));
-        offset += txSize;
+        block.transactions.push_back(Transaction::Deserialize(reader.ReadBytes(txSize)));
     }
 
-    if (offset + 32 + 32 + 4 + 4 > serialized.size()) {
+    if (reader.Remaining() < 32 + 32 + 4 + 4) {
         throw std::runtime_error("Block data truncated: missing hash, nonce, or bits");
     }
 
     // previous hash (32 bytes)
-    block.previousHash =
-        std::vector<uint8_t>(serialized.begin() + offset, serialized.begin() + offset + 32);
-    offset += 32;
+    block.previousHash = reader.ReadHash256();
 
     // hash (32 bytes)
-    block.hash =
-        std::vector<uint8_t>(serialized.begin() + offset, serialized.begin() + offset + 32);
-    offset += 32;
+    block.hash = reader.ReadHash256();
 
     // nonce (4 bytes)
-    block.nonce = static_cast<int32_t>(ReadUint32(serialized, offset));
-    offset += 4;
+    block.nonce = static_cast<int32_t>(reader.ReadUint32());
 
     // bits (4 bytes)
-    block.bits = static_cast<int32_t>(ReadUint32(serialized, offset));
+    block.bits = static_cast<int32_t>(reader.ReadUint32());
 
     return block;
 }
 
-std::vector<uint8_t> Block::HashTransactions() const {
+Hash256 Block::HashTransactions() const {
     MerkleTree tree(transactions);
     return tree.GetRootHash();
 }
@@ -135,7 +140,7 @@ bool Block::CheckBlockSize(const Block& block, size_t knownSerializedSize) {
 
     // coinbase must have exactly one input with empty txid and vout == -1
     const auto& coinBaseVin = txs[0].GetVin();
-    if (coinBaseVin.size() != 1 || !coinBaseVin[0].GetTxid().empty() ||
+    if (coinBaseVin.size() != 1 || !coinBaseVin[0].GetTxid().IsNull() ||
         coinBaseVin[0].GetVout() != -1) {
         return false;
     }
@@ -148,7 +153,7 @@ bool Block::CheckBlockSize(const Block& block, size_t knownSerializedSize) {
     if (txs.size() > Policy::MAX_BLOCK_TXS) return false;
 
     // if size is known, use it, otherwise serialize the block
-    size_t blockSize = knownSerializedSize > 0 ? knownSerializedSize : block.Serialize().size();
+    size_t blockSize = knownSerializedSize > 0 ? knownSerializedSize : block.SerializedSize();
 
     if (blockSize > Policy::MAX_BLOCK_SIZE) return false;
 
@@ -157,5 +162,5 @@ bool Block::CheckBlockSize(const Block& block, size_t knownSerializedSize) {
 
 Block Block::NewGenesisBlock(const Transaction& coinbase) {
     std::vector<Transaction> transactions = {coinbase};
-    return Block(transactions, std::vector<uint8_t>(32, 0), Consensus::INITIAL_BITS);
+    return Block(transactions, Hash256(), Consensus::INITIAL_BITS);
 }
\ No newline at end of file
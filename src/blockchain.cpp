@@ -8,9 +8,11 @@
 #include <iostream>
 #include <optional>
 #include <stdexcept>
+#include <unordered_set>
 
 #include "blockchainIterator.h"
 #include "config.h"
+#include "outPoint.h"
 #include "proofOfWork.h"
 #include "transactionOutput.h"
 #include "utils.h"
@@ -43,7 +45,8 @@ Blockchain::Blockchain() {
         throw std::runtime_error("Error reading tip: " + status.ToString());
     }
 
-    tip = std::vector<uint8_t>(tipString.begin(), tipString.end());
+    tip = Hash256::FromBytes(reinterpret_cast<const uint8_t*>(tipString.data()),
+                             tipString.size());
 
     std::vector<uint8_t> heightKey;
     heightKey.push_back('h');
@@ -85,7 +88,7 @@ std::unique_ptr<Blockchain> Blockchain::CreateBlockchain(const std::string& addr
                                                   Consensus::GENESIS_COINBASE_DATA);
     Block genesis = Block::NewGenesisBlock(cbtx);
 
-    std::vector<uint8_t> genesisHash = genesis.GetHash();
+    const Hash256& genesisHash = genesis.GetHash();
     std::vector<uint8_t> serialized = genesis.Serialize();
 
     std::vector<uint8_t> key;
@@ -133,7 +136,8 @@ Block Blockchain::MineBlock(const std::vector<Transaction>& transactions) {
         throw std::runtime_error("Error reading last hash: " + status.ToString());
     }
 
-    std::vector<uint8_t> lastHash(lastHashString.begin(), lastHashString.end());
+    Hash256 lastHash = Hash256::FromBytes(reinterpret_cast<const uint8_t*>(lastHashString.data()),
+                                          lastHashString.size());
 
     // compute the correct difficulty for the new block before running PoW
     int32_t nextBits = GetNextWorkRequired(GetChainHeight() + 1);
@@ -143,7 +147,7 @@ Block Blockchain::MineBlock(const std::vector<Transaction>& transactions) {
     std::vector<uint8_t> blockKey;
     // prefix for the Block
     blockKey.push_back('b');
-    std::vector<uint8_t> newHash = newBlock.GetHash();
+    const Hash256& newHash = newBlock.GetHash();
     blockKey.insert(blockKey.end(), newHash.begin(), newHash.end());
 
     std::vector<uint8_t> serialized = newBlock.Serialize();
@@ -200,7 +204,7 @@ void Blockchain::AddBlock(const Block& block) {
                                  std::to_string(now + Consensus::MAX_FUTURE_BLOCK_TIME) + ")");
     }
 
-    std::vector<uint8_t> blockHash = block.GetHash();
+    const Hash256& blockHash = block.GetHash();
 
     // check if we already have this block
     std::vector<uint8_t> key;
@@ -238,7 +242,7 @@ void Blockchain::AddBlock(const Block& block) {
     PushTimestamp(block.GetTimestamp());
 }
 
-Block Blockchain::GetBlock(const std::vector<uint8_t>& hash) const {
+Block Blockchain::GetBlock(const Hash256& hash) const {
     std::vector<uint8_t> key;
     key.push_back('b');
     key.insert(key.end(), hash.begin(), hash.end());
@@ -250,14 +254,12 @@ Block Blockchain::GetBlock(const std::vector<uint8_t>& hash) const {
         throw std::runtime_error("Block not found");
     }
 
-    std::vector<uint8_t> data(serializedBlock.begin(), serializedBlock.end());
-    return Block::Deserialize(data);
+    return Block::Deserialize(StringAsBytes(serializedBlock));
 }
 
-std::vector<std::vector<uint8_t>> Blockchain::GetBlockHashesAfter(
-    const std::vector<uint8_t>& afterHash) const {
+std::vector<Hash256> Blockchain::GetBlockHashesAfter(const Hash256& afterHash) const {
     // walk from tip backwards collecting all hashes
-    std::vector<std::vector<uint8_t>> allHashes;
+    std::vector<Hash256> allHashes;
     BlockchainIterator bci(tip, db.get());
 
     while (bci.hasNext()) {
@@ -272,7 +274,7 @@ std::vector<std::vector<uint8_t>> Blockchain::GetBlockHashesAfter(
     for (size_t i = 0; i < allHashes.size(); i++) {
         if (allHashes[i] == afterHash) {
             // return everything after this position
-            return std::vector<std::vector<uint8_t>>(allHashes.begin() + i + 1, allHashes.end());
+            return std::vector<Hash256>(allHashes.begin() + i + 1, allHashes.end());
         }
     }
 
@@ -280,9 +282,9 @@ std::vector<std::vector<uint8_t>> Blockchain::GetBlockHashesAfter(
     return {};
 }
 
-std::map<std::string, TXOutputs> Blockchain::FindUTXO() {
-    std::map<std::string, TXOutputs> UTXO;
-    std::map<std::string, std::vector<int>> spentTXOs;
+std::map<Hash256, TXOutputs> Blockchain::FindUTXO() {
+    std::map<Hash256, TXOutputs> UTXO;
+    std::unordered_set<OutPoint> spentTXOs;
     BlockchainIterator bci = Iterator();
 
     while (bci.hasNext()) {
@@ -290,22 +292,14 @@ std::map<std::string, TXOutputs> Blockchain::FindUTXO() {
         int32_t height = GetBlockHeight(block.GetHash());
 
         for (const Transaction& tx : block.GetTransactions()) {
-            std::string txID = ByteArrayToHexString(tx.GetID());
+            const Hash256& txID = tx.GetID();
             TXOutputs outs;
 
             for (size_t outIdx = 0; outIdx < tx.GetVout().size(); outIdx++) {
                 const TransactionOutput& out = tx.GetVout()[outIdx];
 
-                bool wasSpent = false;
                 // check if the output was spent
-                if (spentTXOs.count(txID)) {
-                    for (int spentOutIdx : spentTXOs[txID]) {
-                        if (spentOutIdx == static_cast<int>(outIdx)) {
-                            wasSpent = true;
-                            break;
-                        }
-                    }
-                }
+                bool wasSpent = spentTXOs.count({txID, static_cast<int>(outIdx)}) > 0;
                 if (!wasSpent) {
                     outs.outputs[static_cast<int>(outIdx)] = out;
                 }
@@ -322,8 +316,7 @@ std::map<std::string, TXOutputs> Blockchain::FindUTXO() {
             // gather spent outputs
             if (!tx.IsCoinbase()) {
                 for (const TransactionInput& in : tx.GetVin()) {
-                    std::string inputTxID = ByteArrayToHexString(in.GetTxid());
-                    spentTXOs[inputTxID].push_back(in.GetVout());
+                    spentTXOs.insert(in.GetPrevOut());
                 }
             }
         }
@@ -332,7 +325,7 @@ std::map<std::string, TXOutputs> Blockchain::FindUTXO() {
     return UTXO;
 }
 
-Transaction Blockchain::FindTransaction(const std::vector<uint8_t>& ID) {
+Transaction Blockchain::FindTransaction(const Hash256& ID) {
     BlockchainIterator bci = Iterator();
 
     while (bci.hasNext()) {
@@ -348,8 +341,7 @@ Transaction Blockchain::FindTransaction(const std::vector<uint8_t>& ID) {
     throw std::runtime_error("Transaction not found");
 }
 
-std::pair<Transaction, int32_t> Blockchain::FindTransactionWithHeight(
-    const std::vector<uint8_t>& ID) {
+std::pair<Transaction, int32_t> Blockchain::FindTransactionWithHeight(const Hash256& ID) {
     BlockchainIterator bci = Iterator();
 
     while (bci.hasNext()) {
@@ -367,12 +359,12 @@ std::pair<Transaction, int32_t> Blockchain::FindTransactionWithHeight(
 }
 
 void Blockchain::SignTransaction(Transaction* tx, Wallet* wallet) {
-    std::map<std::string, Transaction> prevTXs;
+    std::unordered_map<Hash256, Transaction> prevTXs;
 
     // collect all previous transactions being spent, the inputs this output is spending
     for (const auto& vin : tx->GetVin()) {
         Transaction prevTX = FindTransaction(vin.GetTxid());
-        prevTXs.insert({ByteArrayToHexString(prevTX.GetID()), prevTX});
+        prevTXs.insert({prevTX.GetID(), prevTX});
     }
 
     wallet->SignTransaction(tx, prevTXs);
@@ -383,7 +375,7 @@ std::optional<int64_t> Blockchain::VerifyTransaction(const Transaction* tx) {
 
     if (tx->GetVin().empty() || tx->GetVout().empty()) return std::nullopt;
 
-    std::map<std::string, Transaction> prevTXs;
+    std::unordered_map<Hash256, Transaction> prevTXs;
     int32_t currentHeight = GetChainHeight();
 
     // collect all previous transactions being spent, the inputs this output is spending
@@ -398,7 +390,7 @@ std::optional<int64_t> Blockchain::VerifyTransaction(const Transaction* tx) {
             }
         }
 
-        prevTXs.insert({ByteArrayToHexString(prevTX.GetID()), prevTX});
+        prevTXs.insert({prevTX.GetID(), prevTX});
     }
 
     // compute fee without a second DB lookup
@@ -410,26 +402,24 @@ std::optional<int64_t> Blockchain::VerifyTransaction(const Transaction* tx) {
 }
 
 std::optional<int64_t> Blockchain::VerifyTransaction(
-    const Transaction* tx, const std::map<std::string, Transaction>& blockCtx) {
+    const Transaction* tx, const std::unordered_map<Hash256, Transaction>& blockCtx) {
     if (tx->IsCoinbase()) return 0;
 
     if (tx->GetVin().empty() || tx->GetVout().empty()) return std::nullopt;
 
-    std::map<std::string, Transaction> prevTXs;
+    std::unordered_map<Hash256, Transaction> prevTXs;
 
     int32_t spendHeight = GetChainHeight() + 1;
 
     // collect all previous transactions being spent, the inputs this output is spending
     for (const auto& vin : tx->GetVin()) {
-        std::string txidHex = ByteArrayToHexString(vin.GetTxid());
-
         // check for intra block spending first
-        auto ctxIt = blockCtx.find(txidHex);
+        auto ctxIt = blockCtx.find(vin.GetTxid());
         if (ctxIt != blockCtx.end()) {
             if (ctxIt->second.IsCoinbase()) {
                 return std::nullopt;
             }
-            prevTXs.insert({txidHex, ctxIt->second});
+            prevTXs.insert({vin.GetTxid(), ctxIt->second});
         } else {
             auto [prevTX, prevHeight] = FindTransactionWithHeight(vin.GetTxid());
 
@@ -441,7 +431,7 @@ std::optional<int64_t> Blockchain::VerifyTransaction(
                 }
             }
 
-            prevTXs.insert({ByteArrayToHexString(prevTX.GetID()), prevTX});
+            prevTXs.insert({prevTX.GetID(), prevTX});
         }
     }
 
@@ -456,7 +446,7 @@ BlockchainIterator Blockchain::Iterator() const { return BlockchainIterator(tip,
 
 int32_t Blockchain::GetChainHeight() const { return tipHeight; }
 
-int32_t Blockchain::GetBlockHeight(const std::vector<uint8_t>& hash) const {
+int32_t Blockchain::GetBlockHeight(const Hash256& hash) const {
     std::vector<uint8_t> heightKey;
     heightKey.push_back('h');
     heightKey.insert(heightKey.end(), hash.begin(), hash.end());
@@ -474,10 +464,9 @@ int32_t Blockchain::GetBlockHeight(const std::vector<uint8_t>& hash) const {
 
 void Blockchain::LoadRecentTimestamps() {
     recentTimestamps.clear();
-    std::vector<uint8_t> current = tip;
+    Hash256 current = tip;
 
-    for (int32_t i = 0; i < Consensus::MEDIAN_TIME_SPAN && current != std::vector<uint8_t>(32, 0);
-         ++i) {
+    for (int32_t i = 0; i < Consensus::MEDIAN_TIME_SPAN && !current.IsNull(); ++i) {
         Block block = GetBlock(current);
         recentTimestamps.push_back(block.GetTimestamp());
         current = block.GetPreviousHash();
@@ -503,7 +492,7 @@ int64_t Blockchain::GetMedianTimePast() const {
 
 int32_t Blockchain::GetNextWorkRequired(int32_t nextBlockHeight) const {
     // during genesis creation path
-    if (tip.empty() || tip == std::vector<uint8_t>(32, 0)) {
+    if (tip.IsNull()) {
         return Consensus::INITIAL_BITS;
     }
 
@@ -515,12 +504,12 @@ int32_t Blockchain::GetNextWorkRequired(int32_t nextBlockHeight) const {
     }
 
     // walk back RETARGET_INTERVAL − 1 steps to find the anchor block
-    std::vector<uint8_t> anchorHash = tip;
+    Hash256 anchorHash = tip;
     for (int32_t i = 0; i < Consensus::RETARGET_INTERVAL - 1; ++i) {
         Block b = GetBlock(anchorHash);
         anchorHash = b.GetPreviousHash();
         // a redundancy check to ensure no issues
-        if (anchorHash == std::vector<uint8_t>(32, 0)) {
+        if (anchorHash.IsNull()) {
             return tipBlock.GetBits();
         }
     }
@@ -6,8 +6,8 @@
 #include "block.h"
 #include "utils.h"
 
-BlockchainIterator::BlockchainIterator(std::vector<uint8_t> tip, leveldb::DB* db)
-    : currentHash(std::move(tip)), db(db) {}
+BlockchainIterator::BlockchainIterator(const Hash256& tip, leveldb::DB* db)
+    : currentHash(tip), db(db) {}
 
 Block BlockchainIterator::Next() {
     std::vector<uint8_t> key;
@@ -23,16 +23,10 @@ Block BlockchainIterator::Next() {
         throw std::runtime_error("Failed to read block from database: " + status.ToString());
     }
 
-    std::vector<uint8_t> data(serializedBlock.begin(), serializedBlock.end());
-    Block block = Block::Deserialize(data);
+    Block block = Block::Deserialize(StringAsBytes(serializedBlock));
 
     currentHash = block.GetPreviousHash();
     return block;
 }
 
-bool BlockchainIterator::hasNext() const {
-    for (uint8_t byte : currentHash) {
-        if (byte != 0) return true;
-    }
-    return false;
-}
\ No newline at end of file
+bool BlockchainIterator::hasNext() const { return !currentHash.IsNull(); }
\ No newline at end of file
@@ -31,6 +31,10 @@ void CLI::printUsage() {
                  "to TO\n";
     std::cout << "  startnode -port PORT [-seed IP:PORT] [-rpcport PORT] [-mine -mineraddress ADDR]"
                  " - Start a network node\n";
+    std::cout << "      bandwidth caps in KB/s, 0 or unset is unlimited: [-maxupload N] "
+                 "[-maxdownload N]\n";
+    std::cout << "      [-maxhistoricalupload N] (serving old blocks to syncing peers) "
+                 "[-maxpeerupload N] [-maxpeerdownload N]\n";
     std::cout << "\nGlobal flags:\n";
     std::cout << "  -datadir DIR - Set the data directory (default: ./data)\n";
 }
@@ -162,8 +166,8 @@ namespace {
 }  // namespace
 
 void CLI::startNode(uint16_t port, const std::string& seedAddr, uint16_t rpcPort,
-                    const std::string& minerAddress) {
-    Node node("0.0.0.0", port, rpcPort, minerAddress);
+                    const std::string& minerAddress, const BandwidthLimits& limits) {
+    Node node("0.0.0.0", port, rpcPort, minerAddress, limits);
 
     g_shutdown = 0;
 
@@ -295,6 +299,8 @@ void CLI::run(int argc, char* argv[]) {
         uint16_t rpcPort = DEFAULT_RPC_PORT;
         std::string minerAddress;
         bool mineEnabled = false;
+        BandwidthLimits limits;
+        auto kbps = [](const char* arg) { return std::stoull(arg) * 1000; };
 
         // parse optional flags
         for (int i = 3; i < cmdArgc; i++) {
@@ -308,6 +314,16 @@ void CLI::run(int argc, char* argv[]) {
                     rpcPort = static_cast<uint16_t>(std::stoi(cmdArgv[++i]));
                 } else if (flag == "-mineraddress") {
                     minerAddress = cmdArgv[++i];
+                } else if (flag == "-maxupload") {
+                    limits.maxUpload = kbps(cmdArgv[++i]);
+                } else if (flag == "-maxdownload") {
+                    limits.maxDownload = kbps(cmdArgv[++i]);
+                } else if (flag == "-maxhistoricalupload") {
+                    limits.maxHistoricalUpload = kbps(cmdArgv[++i]);
+                } else if (flag == "-maxpeerupload") {
+                    limits.maxPeerUpload = kbps(cmdArgv[++i]);
+                } else if (flag == "-maxpeerdownload") {
+                    limits.maxPeerDownload = kbps(cmdArgv[++i]);
                 }
             }
         }
@@ -318,7 +334,7 @@ void CLI::run(int argc, char* argv[]) {
             return;
         }
 
-        startNode(port, seedAddr, rpcPort, minerAddress);
+        startNode(port, seedAddr, rpcPort, minerAddress, limits);
     } else {
         std::cout << "Error: unknown command '" << command << "'\n";
         printUsage();
@@ -332,8 +348,8 @@ void CLI::printChain() {
     while (bci.hasNext()) {
         Block block = bci.Next();
 
-        std::cout << "Block: " << ByteArrayToHexString(block.GetHash()) << std::endl;
-        std::cout << "Prev. block: " << ByteArrayToHexString(block.GetPreviousHash()) << std::endl;
+        std::cout << "Block: " << block.GetHash().ToHex() << std::endl;
+        std::cout << "Prev. block: " << block.GetPreviousHash().ToHex() << std::endl;
         std::cout << "Bits: " << block.GetBits() << "  (target = 1 << " << (256 - block.GetBits())
                   << ")" << std::endl;
 
@@ -343,14 +359,14 @@ void CLI::printChain() {
 
         // print each transaction on that block
         for (const Transaction& tx : block.GetTransactions()) {
-            std::cout << "--- Transaction " << ByteArrayToHexString(tx.GetID()) << ":" << std::endl;
+            std::cout << "--- Transaction " << tx.GetID().ToHex() << ":" << std::endl;
 
             if (tx.IsCoinbase()) {
                 std::cout << "\tCOINBASE" << std::endl;
             } else {
                 std::cout << "\tInputs:" << std::endl;
                 for (const auto& input : tx.GetVin()) {
-                    std::cout << "\t\tTxID: " << ByteArrayToHexString(input.GetTxid()) << std::endl;
+                    std::cout << "\t\tTxID: " << input.GetTxid().ToHex() << std::endl;
                     std::cout << "\t\tVout: " << input.GetVout() << std::endl;
                 }
             }
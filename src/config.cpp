@@ -27,4 +27,10 @@ namespace Config {
 
     std::string GetBanListPath() { return (std::filesystem::path(dataDir) / "banlist.dat").string(); }
 
+    std::string GetMempoolPath() { return (std::filesystem::path(dataDir) / "mempool.dat").string(); }
+
+    std::string GetFeeEstimatesPath() {
+        return (std::filesystem::path(dataDir) / "fee_estimates.dat").string();
+    }
+
 }  // namespace Config
\ No newline at end of file
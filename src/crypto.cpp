@@ -1,40 +1,95 @@
 #include "crypto.h"
 
-#include <openssl/evp.h>
-
 #include <memory>
 #include <stdexcept>
 
-static std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> makeCtx() {
-    auto ctx =
-        std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+using EVP_MD_CTX_ptr = std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>;
+
+static EVP_MD_CTX_ptr makeCtx() {
+    auto ctx = EVP_MD_CTX_ptr(EVP_MD_CTX_new(), EVP_MD_CTX_free);
     if (!ctx) throw std::runtime_error("Failed to allocate EVP_MD_CTX");
     return ctx;
 }
 
-static std::vector<uint8_t> evpDigest(const EVP_MD* algo, const std::vector<uint8_t>& data) {
-    auto ctx = makeCtx();
+// one context per thread, reinitialised for every digest instead of allocated per call
+static EVP_MD_CTX* threadCtx() {
+    thread_local EVP_MD_CTX_ptr ctx = makeCtx();
+    return ctx.get();
+}
+
+// fetched once, the EVP_sha256() style getters do an implicit fetch on every init
+static const EVP_MD* fetchDigest(const char* name, const EVP_MD* fallback) {
+    const EVP_MD* md = EVP_MD_fetch(nullptr, name, nullptr);
+    return md ? md : fallback;
+}
+
+static const EVP_MD* sha256Md() {
+    static const EVP_MD* md = fetchDigest("SHA256", EVP_sha256());
+    return md;
+}
+
+static const EVP_MD* ripemd160Md() {
+    static const EVP_MD* md = fetchDigest("RIPEMD160", EVP_ripemd160());
+    return md;
+}
 
-    unsigned char buf[EVP_MAX_MD_SIZE];
-    unsigned int len = 0;
+static void evpDigest(const EVP_MD* algo, std::span<const uint8_t> data, uint8_t* out) {
+    EVP_MD_CTX* ctx = threadCtx();
 
-    if (EVP_DigestInit_ex(ctx.get(), algo, nullptr) <= 0 ||
-        EVP_DigestUpdate(ctx.get(), data.data(), data.size()) <= 0 ||
-        EVP_DigestFinal_ex(ctx.get(), buf, &len) <= 0) {
+    if (EVP_DigestInit_ex(ctx, algo, nullptr) <= 0 ||
+        EVP_DigestUpdate(ctx, data.data(), data.size()) <= 0 ||
+        EVP_DigestFinal_ex(ctx, out, nullptr) <= 0) {
         throw std::runtime_error("EVP digest operation failed");
     }
+}
+
+Hash256 SHA256Digest(std::span<const uint8_t> data) {
+    Hash256 hash;
+    evpDigest(sha256Md(), data, hash.data());
+    return hash;
+}
 
-    return {buf, buf + len};
+Hash256 SHA256DoubleDigest(std::span<const uint8_t> data) {
+    return SHA256Digest(SHA256Digest(data).bytes);
+}
+
+Hash160 RIPEMD160Digest(std::span<const uint8_t> data) {
+    Hash160 hash;
+    evpDigest(ripemd160Md(), data, hash.data());
+    return hash;
 }
 
 std::vector<uint8_t> SHA256Hash(const std::vector<uint8_t>& data) {
-    return evpDigest(EVP_sha256(), data);
+    return SHA256Digest(data).ToVector();
 }
 
 std::vector<uint8_t> SHA256DoubleHash(const std::vector<uint8_t>& data) {
-    return SHA256Hash(SHA256Hash(data));
+    return SHA256DoubleDigest(data).ToVector();
 }
 
 std::vector<uint8_t> RIPEMD160Hash(const std::vector<uint8_t>& data) {
-    return evpDigest(EVP_ripemd160(), data);
+    Hash160 hash = RIPEMD160Digest(data);
+    return {hash.begin(), hash.end()};
+}
+
+SHA256Hasher::SHA256Hasher() : ctx(makeCtx()) {
+    if (EVP_DigestInit_ex(ctx.get(), sha256Md(), nullptr) <= 0) {
+        throw std::runtime_error("EVP digest init failed");
+    }
+}
+
+SHA256Hasher& SHA256Hasher::Write(std::span<const uint8_t> data) {
+    if (EVP_DigestUpdate(ctx.get(), data.data(), data.size()) <= 0) {
+        throw std::runtime_error("EVP digest update failed");
+    }
+    return *this;
+}
+
+Hash256 SHA256Hasher::Finalize() {
+    Hash256 hash;
+    if (EVP_DigestFinal_ex(ctx.get(), hash.data(), nullptr) <= 0 ||
+        EVP_DigestInit_ex(ctx.get(), sha256Md(), nullptr) <= 0) {
+        throw std::runtime_error("EVP digest final failed");
+    }
+    return hash;
 }
@@ -0,0 +1,230 @@
+#include "feeEstimator.h"
+
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "byteStream.h"
+#include "config.h"
+
+FeeEstimator::FeeEstimator() {
+    bucketBounds.push_back(0.0);
+    for (double bound = FEE_BUCKET_MIN; bound <= FEE_BUCKET_MAX; bound *= FEE_BUCKET_SPACING) {
+        bucketBounds.push_back(bound);
+    }
+
+    size_t buckets = bucketBounds.size();
+    confirmedCount.assign(buckets, 0.0);
+    feeRateSum.assign(buckets, 0.0);
+    confirmedWithin.assign(FEE_ESTIMATOR_MAX_TARGET, std::vector<double>(buckets, 0.0));
+    failedAfter.assign(FEE_ESTIMATOR_MAX_TARGET, std::vector<double>(buckets, 0.0));
+}
+
+size_t FeeEstimator::BucketIndex(double feeRate) const {
+    auto it = std::upper_bound(bucketBounds.begin(), bucketBounds.end(), feeRate);
+    return it == bucketBounds.begin() ? 0 : static_cast<size_t>(it - bucketBounds.begin()) - 1;
+}
+
+void FeeEstimator::SetBestHeight(int32_t height) {
+    std::lock_guard<std::mutex> lock(mtx);
+    bestHeight = height;
+}
+
+void FeeEstimator::TrackTransaction(const Hash256& txid, double feeRate) {
+    std::lock_guard<std::mutex> lock(mtx);
+    tracked[txid] = TrackedTx{bestHeight, BucketIndex(feeRate), feeRate};
+}
+
+void FeeEstimator::UntrackTransaction(const Hash256& txid) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = tracked.find(txid);
+    if (it == tracked.end()) return;
+
+    // evicted, replaced or conflicted, it failed every target it had already waited out
+    int32_t waited = std::min(bestHeight - it->second.entryHeight, FEE_ESTIMATOR_MAX_TARGET);
+    for (int32_t target = 1; target <= waited; target++) {
+        failedAfter[target - 1][it->second.bucket] += 1.0;
+    }
+    tracked.erase(it);
+}
+
+void FeeEstimator::ProcessBlock(int32_t height, const std::vector<Hash256>& txids) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (height <= bestHeight) return;
+    bestHeight = height;
+
+    for (size_t b = 0; b < bucketBounds.size(); b++) {
+        confirmedCount[b] *= FEE_ESTIMATOR_DECAY;
+        feeRateSum[b] *= FEE_ESTIMATOR_DECAY;
+    }
+    for (int32_t target = 0; target < FEE_ESTIMATOR_MAX_TARGET; target++) {
+        for (double& count : confirmedWithin[target]) count *= FEE_ESTIMATOR_DECAY;
+        for (double& count : failedAfter[target]) count *= FEE_ESTIMATOR_DECAY;
+    }
+
+    for (const Hash256& txid : txids) {
+        auto it = tracked.find(txid);
+        if (it == tracked.end()) continue;
+
+        const TrackedTx& tx = it->second;
+        int32_t blocks = std::max(height - tx.entryHeight, 1);
+        confirmedCount[tx.bucket] += 1.0;
+        feeRateSum[tx.bucket] += tx.feeRate;
+        for (int32_t target = blocks; target <= FEE_ESTIMATOR_MAX_TARGET; target++) {
+            confirmedWithin[target - 1][tx.bucket] += 1.0;
+        }
+        tracked.erase(it);
+    }
+}
+
+std::optional<double> FeeEstimator::EstimateFeeRate(int32_t target) const {
+    if (target < 1 || target > FEE_ESTIMATOR_MAX_TARGET) return std::nullopt;
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    // transactions still waiting longer than the target are failing it as well
+    std::vector<double> pendingTooLong(bucketBounds.size(), 0.0);
+    for (const auto& [_, tx] : tracked) {
+        if (bestHeight - tx.entryHeight >= target) pendingTooLong[tx.bucket] += 1.0;
+    }
+
+    const std::vector<double>& confirmed = confirmedWithin[target - 1];
+    const std::vector<double>& failed = failedAfter[target - 1];
+
+    // walk down from the highest fee rate, grouping buckets until a range has enough data,
+    // and stop at the first range confirming too rarely
+    std::optional<double> estimate;
+    double rangeConfirmed = 0.0;
+    double rangeTotal = 0.0;
+    double rangeFeeRates = 0.0;
+    double rangeCount = 0.0;
+    for (size_t b = bucketBounds.size(); b-- > 0;) {
+        rangeConfirmed += confirmed[b];
+        rangeTotal += confirmedCount[b] + failed[b] + pendingTooLong[b];
+        rangeFeeRates += feeRateSum[b];
+        rangeCount += confirmedCount[b];
+        if (rangeTotal < FEE_ESTIMATOR_SUFFICIENT_TXS) continue;
+
+        if (rangeConfirmed / rangeTotal < FEE_ESTIMATOR_SUCCESS_RATE) break;
+        estimate = rangeFeeRates / rangeCount;
+
+        rangeConfirmed = rangeTotal = rangeFeeRates = rangeCount = 0.0;
+    }
+
+    // peers won't relay anything paying less than the minimum, however fast it would confirm
+    if (estimate) estimate = std::max(*estimate, Policy::MIN_RELAY_FEE_RATE);
+    return estimate;
+}
+
+void FeeEstimator::SaveToFile() const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::string path = Config::GetFeeEstimatesPath();
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+
+    // format: [version(4)] [bestHeight(4)] [buckets(4)] [maxTarget(4)]
+    //         [confirmedCount(8) feeRateSum(8)] * buckets
+    //         [confirmedWithin(8)] * maxTarget * buckets [failedAfter(8)] * maxTarget * buckets
+    // counts are doubles stored bit for bit
+    size_t buckets = bucketBounds.size();
+    ByteWriter writer(16 + 16 * buckets + 16 * FEE_ESTIMATOR_MAX_TARGET * buckets);
+    writer.WriteUint32(FEE_ESTIMATES_FILE_VERSION);
+    writer.WriteUint32(static_cast<uint32_t>(bestHeight));
+    writer.WriteUint32(static_cast<uint32_t>(buckets));
+    writer.WriteUint32(static_cast<uint32_t>(FEE_ESTIMATOR_MAX_TARGET));
+    for (size_t b = 0; b < buckets; b++) {
+        writer.WriteUint64(std::bit_cast<uint64_t>(confirmedCount[b]));
+        writer.WriteUint64(std::bit_cast<uint64_t>(feeRateSum[b]));
+    }
+    for (const auto* table : {&confirmedWithin, &failedAfter}) {
+        for (const auto& row : *table) {
+            for (double count : row) writer.WriteUint64(std::bit_cast<uint64_t>(count));
+        }
+    }
+    std::vector<uint8_t> data = writer.Release();
+
+    // replace the old estimates only once the new ones are fully on disk
+    std::string tmpPath = path + ".new";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[feeestimator] Failed to open " << tmpPath << " for writing"
+                      << std::endl;
+            return;
+        }
+        out.write(reinterpret_cast<const char*>(data.data()),
+                  static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            std::cerr << "[feeestimator] Failed to write " << tmpPath << std::endl;
+            return;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::cerr << "[feeestimator] Failed to replace " << path << ": " << ec.message()
+                  << std::endl;
+    }
+}
+
+void FeeEstimator::LoadFromFile() {
+    std::string path = Config::GetFeeEstimatesPath();
+    if (!std::filesystem::exists(path)) return;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "[feeestimator] Failed to open " << path << " for reading" << std::endl;
+        return;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    try {
+        ByteReader reader(data);
+        uint32_t version = reader.ReadUint32();
+        int32_t savedHeight = static_cast<int32_t>(reader.ReadUint32());
+        uint32_t buckets = reader.ReadUint32();
+        uint32_t maxTarget = reader.ReadUint32();
+
+        // statistics over other buckets or targets can't be mapped onto ours
+        if (version != FEE_ESTIMATES_FILE_VERSION || buckets != bucketBounds.size() ||
+            maxTarget != static_cast<uint32_t>(FEE_ESTIMATOR_MAX_TARGET)) {
+            std::cerr << "[feeestimator] Ignoring incompatible " << path << std::endl;
+            return;
+        }
+
+        // read into copies so a truncated file leaves the estimator untouched
+        std::vector<double> counts(buckets), sums(buckets);
+        for (size_t b = 0; b < buckets; b++) {
+            counts[b] = std::bit_cast<double>(reader.ReadUint64());
+            sums[b] = std::bit_cast<double>(reader.ReadUint64());
+        }
+        auto within = confirmedWithin;
+        auto failed = failedAfter;
+        for (auto* table : {&within, &failed}) {
+            for (auto& row : *table) {
+                for (double& count : row) count = std::bit_cast<double>(reader.ReadUint64());
+            }
+        }
+
+        confirmedCount = std::move(counts);
+        feeRateSum = std::move(sums);
+        confirmedWithin = std::move(within);
+        failedAfter = std::move(failed);
+        bestHeight = savedHeight;
+    } catch (const std::exception& e) {
+        std::cerr << "[feeestimator] " << path << " is corrupted: " << e.what() << std::endl;
+        return;
+    }
+
+    std::cout << "[feeestimator] Loaded fee statistics from " << path << std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include "hash256.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "serialization.h"
+
+Hash256 Hash256::FromBytes(const uint8_t* data, size_t len) {
+    if (len != HASH256_SIZE) {
+        throw std::invalid_argument("Invalid hash size: expected 32 bytes, got " +
+                                    std::to_string(len));
+    }
+
+    Hash256 hash;
+    std::copy(data, data + HASH256_SIZE, hash.bytes.begin());
+    return hash;
+}
+
+Hash256 Hash256::FromVector(const std::vector<uint8_t>& data) {
+    return FromBytes(data.data(), data.size());
+}
+
+Hash256 Hash256::FromHex(const std::string& hex) {
+    if (hex.size() != HASH256_SIZE * 2) {
+        throw std::invalid_argument("Invalid hash hex: expected 64 characters, got " +
+                                    std::to_string(hex.size()));
+    }
+
+    Hash256 hash;
+    if (!HexDecode(hex.data(), hex.size(), hash.bytes.data())) {
+        throw std::invalid_argument("Invalid hash hex: non-hex character");
+    }
+    return hash;
+}
+
+bool Hash256::IsNull() const {
+    return std::all_of(bytes.begin(), bytes.end(), [](uint8_t b) { return b == 0; });
+}
+
+std::string Hash256::ToHex() const { return ByteArrayToHexString(bytes.data(), bytes.size()); }
+
+std::vector<uint8_t> Hash256::ToVector() const { return {bytes.begin(), bytes.end()}; }
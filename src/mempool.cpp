@@ -1,112 +1,741 @@
 #include "mempool.h"
 
 #include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 
+#include "byteStream.h"
+#include "config.h"
 #include "serialization.h"
 
-bool Mempool::EvictLowestFeeRate() {
-    if (entries.empty()) return false;
+// what the template may use of a block, leaving room for the header and coinbase
+static constexpr size_t TEMPLATE_MAX_BYTES = Policy::MAX_BLOCK_SIZE - Policy::BLOCK_RESERVED_SIZE;
+static constexpr size_t TEMPLATE_MAX_TXS = Policy::MAX_BLOCK_TXS - 1;
 
-    auto worst = entries.begin();
-    for (auto it = entries.begin(); it != entries.end(); ++it) {
-        if (it->second.feeRate < worst->second.feeRate) {
-            worst = it;
-        }
+Mempool::LookupShard& Mempool::ShardFor(const Hash256& txid) {
+    return shards[txid[HASH256_SIZE - 1] % MEMPOOL_LOOKUP_SHARDS];
+}
+
+const Mempool::LookupShard& Mempool::ShardFor(const Hash256& txid) const {
+    return shards[txid[HASH256_SIZE - 1] % MEMPOOL_LOOKUP_SHARDS];
+}
+
+void Mempool::CollectAncestors(const Hash256& txid, std::unordered_set<Hash256>& out) const {
+    for (const Hash256& parent : entries.at(txid).parents) {
+        if (out.insert(parent).second) CollectAncestors(parent, out);
     }
+}
 
-    totalBytes -= worst->second.txSize;
-    std::cout << "[mempool] Evicted " << worst->first.substr(0, 16) << "..."
-              << " feeRate=" << worst->second.feeRate << std::endl;
-    entries.erase(worst);
-    return true;
+void Mempool::CollectDescendants(const Hash256& txid, std::unordered_set<Hash256>& out) const {
+    for (const Hash256& child : entries.at(txid).children) {
+        if (out.insert(child).second) CollectDescendants(child, out);
+    }
 }
 
-bool Mempool::AddTransaction(const Transaction& tx, double feeRate) {
-    std::string txid = ByteArrayToHexString(tx.GetID());
-    size_t txSize = tx.Serialize().size();
+void Mempool::Rescore(const Hash256& txid, MempoolEntry& entry) {
+    byAncestorScore.erase(FeeRateKey{entry.ancestorScore, txid});
+    byEvictionScore.erase(FeeRateKey{entry.evictionScore, txid});
+
+    entry.ancestorScore = entry.ancestors.FeeRate();
+    entry.evictionScore = std::max(entry.feeRate, entry.descendants.FeeRate());
 
-    std::lock_guard<std::mutex> lock(mtx);
+    byAncestorScore.insert(FeeRateKey{entry.ancestorScore, txid});
+    byEvictionScore.insert(FeeRateKey{entry.evictionScore, txid});
+}
+
+void Mempool::RemoveEntry(std::unordered_map<Hash256, MempoolEntry>::iterator it) {
+    const Hash256 txid = it->first;
+    MempoolEntry& entry = it->second;
+
+    // every package this tx belonged to shrinks by it
+    std::unordered_set<Hash256> relatives;
+    CollectAncestors(txid, relatives);
+    for (const Hash256& ancestor : relatives) {
+        MempoolEntry& other = entries.at(ancestor);
+        other.descendants.fee -= entry.fee;
+        other.descendants.size -= entry.txSize;
+        other.descendants.count--;
+        Rescore(ancestor, other);
+    }
+
+    relatives.clear();
+    CollectDescendants(txid, relatives);
+    for (const Hash256& descendant : relatives) {
+        MempoolEntry& other = entries.at(descendant);
+        other.ancestors.fee -= entry.fee;
+        other.ancestors.size -= entry.txSize;
+        other.ancestors.count--;
+        Rescore(descendant, other);
+    }
+
+    for (const Hash256& parent : entry.parents) entries.at(parent).children.erase(txid);
+    for (const Hash256& child : entry.children) entries.at(child).parents.erase(txid);
+
+    if (!entry.tx->IsCoinbase()) {
+        for (const auto& vin : entry.tx->GetVin()) spentOutpoints.erase(vin.GetPrevOut());
+    }
+    totalBytes -= entry.txSize;
+    if (templateTxs.count(txid)) templateDirty = true;
+    // a no-op for mined transactions, the block already reported them
+    if (feeEstimator) feeEstimator->UntrackTransaction(txid);
+    byAncestorScore.erase(FeeRateKey{entry.ancestorScore, txid});
+    byEvictionScore.erase(FeeRateKey{entry.evictionScore, txid});
+    byEntryTime.erase({entry.entryTime, txid});
+    {
+        LookupShard& shard = ShardFor(txid);
+        std::lock_guard<std::shared_mutex> shardLock(shard.mtx);
+        shard.txs.erase(txid);
+    }
+    entries.erase(it);
+}
+
+void Mempool::RemoveEntries(const std::unordered_set<Hash256>& txids) {
+    // a descendant always has more ancestors than any of its ancestors
+    std::vector<Hash256> order(txids.begin(), txids.end());
+    std::sort(order.begin(), order.end(), [this](const Hash256& a, const Hash256& b) {
+        return entries.at(a).ancestors.count > entries.at(b).ancestors.count;
+    });
+
+    for (const Hash256& txid : order) RemoveEntry(entries.find(txid));
+}
+
+MempoolAddResult Mempool::AddTransaction(const Transaction& tx, int64_t fee) {
+    const Hash256& txid = tx.GetID();
+    size_t txSize = tx.SerializedSize();
+    double feeRate = txSize > 0 ? static_cast<double>(fee) / static_cast<double>(txSize) : 0.0;
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+
+    std::lock_guard<std::shared_mutex> lock(mtx);
 
     // already have it
-    if (entries.count(txid)) return true;
-
-    // evict until we're under both limits
-    while ((totalBytes + txSize > Policy::MAX_MEMPOOL_SIZE ||
-            entries.size() >= Policy::MAX_MEMPOOL_ENTRIES) &&
-           !entries.empty()) {
-        // don't evict if this tx has a lower fee rate than the worst entry
-        auto worst = entries.begin();
-        for (auto it = entries.begin(); it != entries.end(); ++it) {
-            if (it->second.feeRate < worst->second.feeRate) {
-                worst = it;
+    if (entries.count(txid)) return MempoolAddResult::Added;
+
+    // a constant time check, the price of getting in went up with the last trim
+    double minFeeRate = MinFeeRateLocked(now);
+    if (feeRate < minFeeRate) {
+        std::cerr << "[mempool] Rejected " << txid.ToHex().substr(0, 16) << "..."
+                  << ": fee rate " << feeRate << " below mempool minimum " << minFeeRate
+                  << std::endl;
+        stats.rejectedFeeTooLow++;
+        return MempoolAddResult::FeeTooLow;
+    }
+
+    // link to the in-pool transactions this one spends from
+    std::unordered_set<Hash256> parents;
+    if (!tx.IsCoinbase()) {
+        for (const auto& vin : tx.GetVin()) {
+            if (entries.count(vin.GetTxid())) parents.insert(vin.GetTxid());
+        }
+    }
+
+    std::unordered_set<Hash256> ancestors = parents;
+    for (const Hash256& parent : parents) CollectAncestors(parent, ancestors);
+
+    if (ancestors.size() + 1 > Policy::MAX_MEMPOOL_ANCESTORS) {
+        std::cerr << "[mempool] Rejected " << txid.ToHex().substr(0, 16) << "..."
+                  << ": " << ancestors.size() << " unconfirmed ancestors" << std::endl;
+        stats.rejectedTooLongChain++;
+        return MempoolAddResult::TooLongChain;
+    }
+    for (const Hash256& ancestor : ancestors) {
+        if (entries.at(ancestor).descendants.count + 1 > Policy::MAX_MEMPOOL_DESCENDANTS) {
+            std::cerr << "[mempool] Rejected " << txid.ToHex().substr(0, 16) << "..."
+                      << ": ancestor " << ancestor.ToHex().substr(0, 16) << "..."
+                      << " has too many unconfirmed descendants" << std::endl;
+            stats.rejectedTooLongChain++;
+            return MempoolAddResult::TooLongChain;
+        }
+    }
+
+    // mempool transactions spending any of the same outputs, which this one would replace
+    // together with their descendants
+    std::vector<Hash256> conflicts;
+    std::unordered_set<Hash256> doomed;
+    if (!tx.IsCoinbase()) {
+        for (const auto& vin : tx.GetVin()) {
+            auto spent = spentOutpoints.find(vin.GetPrevOut());
+            if (spent == spentOutpoints.end() || doomed.count(spent->second)) continue;
+
+            const MempoolEntry& conflict = entries.at(spent->second);
+            if (feeRate <= conflict.evictionScore || ancestors.count(spent->second)) {
+                std::cerr << "[mempool] Rejected " << txid.ToHex().substr(0, 16) << "..."
+                          << ": spends " << vin.GetPrevOut().ToString() << " already spent by "
+                          << spent->second.ToHex().substr(0, 16) << "..." << std::endl;
+                stats.rejectedConflict++;
+                return MempoolAddResult::Conflict;
             }
+            conflicts.push_back(spent->second);
+            doomed.insert(spent->second);
+            CollectDescendants(spent->second, doomed);
         }
-        if (feeRate <= worst->second.feeRate) {
-            std::cerr << "[mempool] Rejected " << txid.substr(0, 16) << "..."
-                      << ": fee rate " << feeRate << " too low for full mempool" << std::endl;
-            return false;
+    }
+
+    // replacing a conflict must not take one of our own parents with it
+    for (const Hash256& ancestor : ancestors) {
+        if (doomed.count(ancestor)) {
+            std::cerr << "[mempool] Rejected " << txid.ToHex().substr(0, 16) << "..."
+                      << ": conflicts with its own ancestor " << ancestor.ToHex().substr(0, 16)
+                      << "..." << std::endl;
+            stats.rejectedConflict++;
+            return MempoolAddResult::Conflict;
         }
-        EvictLowestFeeRate();
     }
 
-    entries[txid] = MempoolEntry{tx, feeRate, txSize};
+    // it has to pay for everything it evicts and for its own relay on top (BIP125 rules 3 and
+    // 4), or a small tx could push out a bigger total fee and each bump would be relayed free
+    if (doomed.size() > Policy::MAX_REPLACEMENT_EVICTIONS) {
+        std::cerr << "[mempool] Rejected " << txid.ToHex().substr(0, 16) << "..."
+                  << ": would replace " << doomed.size() << " transactions" << std::endl;
+        stats.rejectedConflict++;
+        return MempoolAddResult::Conflict;
+    }
+    int64_t replacedFee = 0;
+    size_t replacedBytes = 0;
+    for (const Hash256& gone : doomed) {
+        replacedFee += entries.at(gone).fee;
+        replacedBytes += entries.at(gone).txSize;
+    }
+    double requiredFee = static_cast<double>(replacedFee) +
+                         Policy::MIN_RELAY_FEE_RATE * static_cast<double>(txSize);
+    if (!doomed.empty() && static_cast<double>(fee) < requiredFee) {
+        std::cerr << "[mempool] Rejected " << txid.ToHex().substr(0, 16) << "..."
+                  << ": fee " << fee << " does not cover the " << replacedFee
+                  << " it replaces plus relay" << std::endl;
+        stats.rejectedConflict++;
+        return MempoolAddResult::Conflict;
+    }
+
+    // decided before anything is removed, a tx the trim below would take right back must not
+    // have replaced anything; its ancestors' eviction scores rise with it, so its package goes
+    // at the lowest of theirs and its own
+    double score = feeRate;
+    for (const Hash256& ancestor : ancestors) {
+        const MempoolEntry& other = entries.at(ancestor);
+        PackageTotals descendants = other.descendants;
+        descendants.fee += fee;
+        descendants.size += txSize;
+        score = std::min(score, std::max(other.feeRate, descendants.FeeRate()));
+    }
+    std::unordered_set<Hash256> unaffected = doomed;
+    unaffected.insert(ancestors.begin(), ancestors.end());
+    if (WouldTrimLocked(score, totalBytes - replacedBytes + txSize,
+                        entries.size() - doomed.size() + 1, unaffected)) {
+        std::cerr << "[mempool] Rejected " << txid.ToHex().substr(0, 16) << "..."
+                  << ": fee rate " << score << " would be trimmed from the full mempool"
+                  << std::endl;
+        stats.rejectedFeeTooLow++;
+        return MempoolAddResult::FeeTooLow;
+    }
+
+    for (const Hash256& conflict : conflicts) {
+        std::cout << "[mempool] Replaced " << conflict.ToHex().substr(0, 16) << "..."
+                  << " with " << txid.ToHex().substr(0, 16) << "..." << std::endl;
+    }
+    stats.replaced += doomed.size();
+    RemoveEntries(doomed);
+
+    auto shared = std::make_shared<const Transaction>(tx);
+    MempoolEntry entry{shared, fee, feeRate, txSize, parents, {}, {fee, txSize, 1},
+                       {fee, txSize, 1}, 0.0, 0.0, now};
+    for (const Hash256& ancestor : ancestors) {
+        MempoolEntry& other = entries.at(ancestor);
+        entry.ancestors.fee += other.fee;
+        entry.ancestors.size += other.txSize;
+        entry.ancestors.count++;
+
+        other.descendants.fee += fee;
+        other.descendants.size += txSize;
+        other.descendants.count++;
+        Rescore(ancestor, other);
+    }
+    for (const Hash256& parent : parents) entries.at(parent).children.insert(txid);
+
+    // the zero scores were never indexed, so Rescore only inserts here
+    auto [inserted, _] = entries.emplace(txid, std::move(entry));
+    Rescore(txid, inserted->second);
+
+    if (!tx.IsCoinbase()) {
+        for (const auto& vin : tx.GetVin()) spentOutpoints[vin.GetPrevOut()] = txid;
+    }
+    byEntryTime.insert({now, txid});
     totalBytes += txSize;
+    {
+        LookupShard& shard = ShardFor(txid);
+        std::lock_guard<std::shared_mutex> shardLock(shard.mtx);
+        shard.txs.emplace(txid, std::move(shared));
+    }
+    UpdateTemplateOnAdd(txid, inserted->second);
+    if (feeEstimator) feeEstimator->TrackTransaction(txid, feeRate);
+
+    std::cout << "[mempool] Added " << txid.ToHex().substr(0, 16) << "..."
+              << " feeRate=" << feeRate << " raf/byte";
+    if (!ancestors.empty()) {
+        std::cout << " packageFeeRate=" << inserted->second.ancestorScore << " ("
+                  << ancestors.size() << " unconfirmed ancestors)";
+    }
+    std::cout << " (" << entries.size() << " txs, " << totalBytes / 1024 << " KB)" << std::endl;
+
+    // both only do work when something is due, a tx trimmed here despite the check above is
+    // already counted as trimmed
+    ExpireLocked(now);
+    TrimLocked(now);
+    if (!entries.count(txid)) return MempoolAddResult::FeeTooLow;
+
+    stats.added++;
+    return MempoolAddResult::Added;
+}
+
+double Mempool::MinFeeRateLocked(int64_t now) const {
+    if (rollingMinFeeRate <= 0.0) return 0.0;
 
-    std::cout << "[mempool] Added " << txid.substr(0, 16) << "..."
-              << " feeRate=" << feeRate << " raf/byte"
-              << " (" << entries.size() << " txs, " << totalBytes / 1024 << " KB)" << std::endl;
-    return true;
+    double rate = rollingMinFeeRate;
+    if (blockSinceTrim) {
+        double halfLives = static_cast<double>(now - rollingDecayStart) /
+                           static_cast<double>(Policy::ROLLING_FEE_HALFLIFE_SECS);
+        rate *= std::exp2(-halfLives);
+    }
+
+    // once it has decayed this far there's no pressure left worth charging for
+    if (rate < Policy::INCREMENTAL_RELAY_FEE_RATE / 2) return 0.0;
+    return std::max(rate, Policy::INCREMENTAL_RELAY_FEE_RATE);
 }
 
-void Mempool::RemoveBlockTransactions(const Block& block) {
-    std::lock_guard<std::mutex> lock(mtx);
+void Mempool::ExpireLocked(int64_t now) {
+    std::unordered_set<Hash256> doomed;
+    for (auto it = byEntryTime.begin();
+         it != byEntryTime.end() && it->first + Policy::MEMPOOL_EXPIRY_SECS <= now; ++it) {
+        if (doomed.insert(it->second).second) CollectDescendants(it->second, doomed);
+    }
+    if (doomed.empty()) return;
 
+    RemoveEntries(doomed);
+    stats.expired += doomed.size();
+    std::cout << "[mempool] Expired " << doomed.size() << " transactions older than "
+              << Policy::MEMPOOL_EXPIRY_SECS / 3600 << "h" << std::endl;
+}
+
+void Mempool::TrimLocked(int64_t now) {
+    if (totalBytes <= Policy::MAX_MEMPOOL_SIZE && entries.size() <= Policy::MAX_MEMPOOL_ENTRIES) {
+        return;
+    }
+
+    // trimming below the limits leaves room for a while, so a burst of spam costs one batch
+    // per tenth of the pool instead of an eviction per admission
+    auto targetBytes = static_cast<size_t>(Policy::MAX_MEMPOOL_SIZE * Policy::MEMPOOL_TRIM_TARGET);
+    auto targetCount =
+        static_cast<size_t>(Policy::MAX_MEMPOOL_ENTRIES * Policy::MEMPOOL_TRIM_TARGET);
+
+    std::unordered_set<Hash256> doomed;
+    size_t bytesAfter = totalBytes;
+    size_t countAfter = entries.size();
+    double highestEvicted = 0.0;
+    for (auto it = byEvictionScore.begin();
+         it != byEvictionScore.end() && (bytesAfter > targetBytes || countAfter > targetCount);
+         ++it) {
+        if (doomed.count(it->txid)) continue;
+        highestEvicted = std::max(highestEvicted, it->feeRate);
+
+        std::unordered_set<Hash256> package{it->txid};
+        CollectDescendants(it->txid, package);
+        for (const Hash256& gone : package) {
+            if (!doomed.insert(gone).second) continue;
+            bytesAfter -= entries.at(gone).txSize;
+            countAfter--;
+        }
+    }
+
+    size_t bytesBefore = totalBytes;
+    RemoveEntries(doomed);
+    stats.trimmed += doomed.size();
+    stats.trims++;
+
+    // anything paying no more than what was just dropped would only be trimmed again
+    rollingMinFeeRate =
+        std::max(MinFeeRateLocked(now), highestEvicted + Policy::INCREMENTAL_RELAY_FEE_RATE);
+    blockSinceTrim = false;
+
+    std::cout << "[mempool] Trimmed " << doomed.size() << " transactions ("
+              << (bytesBefore - totalBytes) / 1024 << " KB), minimum fee rate now "
+              << rollingMinFeeRate << " raf/byte" << std::endl;
+}
+
+bool Mempool::WouldTrimLocked(double score, size_t bytesAfter, size_t countAfter,
+                              const std::unordered_set<Hash256>& skip) const {
+    if (bytesAfter <= Policy::MAX_MEMPOOL_SIZE && countAfter <= Policy::MAX_MEMPOOL_ENTRIES) {
+        return false;
+    }
+
+    auto targetBytes = static_cast<size_t>(Policy::MAX_MEMPOOL_SIZE * Policy::MEMPOOL_TRIM_TARGET);
+    auto targetCount =
+        static_cast<size_t>(Policy::MAX_MEMPOOL_ENTRIES * Policy::MEMPOOL_TRIM_TARGET);
+
+    // the same walk as TrimLocked, up to where the new package would come next
+    std::unordered_set<Hash256> gone;
+    for (auto it = byEvictionScore.begin();
+         it != byEvictionScore.end() && (bytesAfter > targetBytes || countAfter > targetCount);
+         ++it) {
+        if (it->feeRate >= score) return true;
+        if (skip.count(it->txid) || gone.count(it->txid)) continue;
+
+        std::unordered_set<Hash256> package{it->txid};
+        CollectDescendants(it->txid, package);
+        for (const Hash256& txid : package) {
+            if (skip.count(txid) || !gone.insert(txid).second) continue;
+            bytesAfter -= entries.at(txid).txSize;
+            countAfter--;
+        }
+    }
+    return bytesAfter > targetBytes || countAfter > targetCount;
+}
+
+void Mempool::Expire() {
+    std::lock_guard<std::shared_mutex> lock(mtx);
+    ExpireLocked(static_cast<int64_t>(std::time(nullptr)));
+}
+
+MempoolStats Mempool::GetStats() const {
+    std::shared_lock<std::shared_mutex> lock(mtx);
+
+    MempoolStats result = stats;
+    result.count = entries.size();
+    result.bytes = totalBytes;
+    result.minFeeRate = MinFeeRateLocked(static_cast<int64_t>(std::time(nullptr)));
+    return result;
+}
+
+void Mempool::SetFeeEstimator(FeeEstimator* estimator) {
+    std::lock_guard<std::shared_mutex> lock(mtx);
+    feeEstimator = estimator;
+}
+
+void Mempool::RemoveBlockTransactions(const Block& block, int32_t height) {
+    std::lock_guard<std::shared_mutex> lock(mtx);
+
+    if (feeEstimator) {
+        std::vector<Hash256> txids;
+        txids.reserve(block.GetTransactions().size());
+        for (const auto& tx : block.GetTransactions()) txids.push_back(tx.GetID());
+        feeEstimator->ProcessBlock(height, txids);
+    }
+
+    // block order puts parents first, so each mined tx has no in-pool parents left by the
+    // time it is removed and its children simply lose it as an ancestor
     for (const auto& tx : block.GetTransactions()) {
-        std::string txid = ByteArrayToHexString(tx.GetID());
-        auto it = entries.find(txid);
+        auto it = entries.find(tx.GetID());
         if (it != entries.end()) {
-            totalBytes -= it->second.txSize;
-            entries.erase(it);
-            std::cout << "[mempool] Removed mined transaction " << txid << std::endl;
+            RemoveEntry(it);
+            stats.mined++;
+            std::cout << "[mempool] Removed mined transaction " << tx.GetID().ToHex() << std::endl;
+        }
+    }
+
+    // whatever still spends an output the block spent can never be mined now, and neither can
+    // anything spending from it
+    std::unordered_set<Hash256> doomed;
+    for (const auto& tx : block.GetTransactions()) {
+        if (tx.IsCoinbase()) continue;
+        for (const auto& vin : tx.GetVin()) {
+            auto spent = spentOutpoints.find(vin.GetPrevOut());
+            if (spent == spentOutpoints.end() || doomed.count(spent->second)) continue;
+
+            std::cout << "[mempool] Removed " << spent->second.ToHex().substr(0, 16) << "..."
+                      << ": conflicts with block on " << vin.GetPrevOut().ToString() << std::endl;
+            doomed.insert(spent->second);
+            CollectDescendants(spent->second, doomed);
         }
     }
+    RemoveEntries(doomed);
+    stats.conflicted += doomed.size();
+
+    // blocks are clearing the backlog, let the minimum fee rate from the last trim decay
+    if (!blockSinceTrim && rollingMinFeeRate > 0.0) {
+        blockSinceTrim = true;
+        rollingDecayStart = static_cast<int64_t>(std::time(nullptr));
+    }
+
+    // the miner will want a template for the new tip right away
+    if (templateDirty) RebuildTemplate();
 }
 
-std::vector<Transaction> Mempool::GetTransactionsSortedByFeeRate() const {
-    std::lock_guard<std::mutex> lock(mtx);
+std::unordered_map<Hash256, Transaction> Mempool::GetParentTransactions(
+    const Transaction& tx) const {
+    std::shared_lock<std::shared_mutex> lock(mtx);
 
-    std::vector<const MempoolEntry*> ptrs;
-    ptrs.reserve(entries.size());
-    for (const auto& [_, entry] : entries) {
-        ptrs.push_back(&entry);
+    std::unordered_map<Hash256, Transaction> parents;
+    if (tx.IsCoinbase()) return parents;
+    for (const auto& vin : tx.GetVin()) {
+        auto it = entries.find(vin.GetTxid());
+        if (it != entries.end()) parents.emplace(it->first, *it->second.tx);
     }
+    return parents;
+}
 
-    // we sort the transactions by descending fee rate
-    std::sort(ptrs.begin(), ptrs.end(),
-              [](const MempoolEntry* a, const MempoolEntry* b) { return a->feeRate > b->feeRate; });
+std::vector<Hash256> Mempool::SelectPackages(size_t maxBytes, size_t maxCount,
+                                             double& lowestScore) const {
+    std::vector<Hash256> result;
+    size_t bytes = 0;
+    std::unordered_set<Hash256> inBlock;
+    std::unordered_set<Hash256> failed;
 
-    std::vector<Transaction> result;
-    result.reserve(ptrs.size());
-    for (const auto* entry : ptrs) {
-        result.push_back(entry->tx);
+    // entries with some ancestors already in the block need a smaller package than the one
+    // byAncestorScore ranks them by, so they are queued here with their remaining totals
+    std::unordered_map<Hash256, PackageTotals> modified;
+    std::set<FeeRateKey> modifiedQueue;
+
+    lowestScore = 0.0;
+    auto next = byAncestorScore.rbegin();
+    while (true) {
+        while (next != byAncestorScore.rend() &&
+               (inBlock.count(next->txid) || failed.count(next->txid) ||
+                modified.count(next->txid))) {
+            ++next;
+        }
+
+        // take the better package of the two queues
+        Hash256 txid;
+        PackageTotals package;
+        if (!modifiedQueue.empty() &&
+            (next == byAncestorScore.rend() || modifiedQueue.rbegin()->feeRate > next->feeRate)) {
+            auto best = std::prev(modifiedQueue.end());
+            txid = best->txid;
+            package = modified.at(txid);
+            modifiedQueue.erase(best);
+            modified.erase(txid);
+        } else if (next != byAncestorScore.rend()) {
+            txid = next->txid;
+            package = entries.at(txid).ancestors;
+            ++next;
+        } else {
+            break;
+        }
+
+        // each tx is stored behind a 4 byte size prefix in the block
+        if (bytes + package.size + 4 * package.count > maxBytes ||
+            result.size() + package.count > maxCount) {
+            failed.insert(txid);
+            continue;
+        }
+
+        // the candidate plus its ancestors not in the block yet, parents first
+        std::unordered_set<Hash256> ancestors;
+        CollectAncestors(txid, ancestors);
+        lowestScore = package.FeeRate();
+        std::vector<Hash256> members{txid};
+        for (const Hash256& ancestor : ancestors) {
+            if (!inBlock.count(ancestor)) members.push_back(ancestor);
+        }
+        std::sort(members.begin(), members.end(), [this](const Hash256& a, const Hash256& b) {
+            return entries.at(a).ancestors.count < entries.at(b).ancestors.count;
+        });
+
+        for (const Hash256& member : members) {
+            const MempoolEntry& entry = entries.at(member);
+            inBlock.insert(member);
+            auto stale = modified.find(member);
+            if (stale != modified.end()) {
+                modifiedQueue.erase(FeeRateKey{stale->second.FeeRate(), member});
+                modified.erase(stale);
+            }
+            result.push_back(member);
+            bytes += 4 + entry.txSize;
+
+            // everything waiting below this tx now needs less to be mined
+            std::unordered_set<Hash256> descendants;
+            CollectDescendants(member, descendants);
+            for (const Hash256& descendant : descendants) {
+                if (inBlock.count(descendant) || failed.count(descendant)) continue;
+
+                auto [it, added] =
+                    modified.try_emplace(descendant, entries.at(descendant).ancestors);
+                if (!added) modifiedQueue.erase(FeeRateKey{it->second.FeeRate(), descendant});
+                it->second.fee -= entry.fee;
+                it->second.size -= entry.txSize;
+                it->second.count--;
+                modifiedQueue.insert(FeeRateKey{it->second.FeeRate(), descendant});
+            }
+        }
     }
     return result;
 }
 
-std::map<std::string, Transaction> Mempool::GetTransactions() const {
-    std::lock_guard<std::mutex> lock(mtx);
-    std::map<std::string, Transaction> txs;
+void Mempool::RebuildTemplate() {
+    double lowestScore = 0.0;
+    std::vector<Hash256> selected =
+        SelectPackages(TEMPLATE_MAX_BYTES, TEMPLATE_MAX_TXS, lowestScore);
+
+    auto rebuilt = std::make_shared<BlockTemplate>();
+    rebuilt->transactions.reserve(selected.size());
+    templateTxs.clear();
+    for (const Hash256& txid : selected) {
+        const MempoolEntry& entry = entries.at(txid);
+        rebuilt->transactions.push_back(*entry.tx);
+        rebuilt->totalFees += entry.fee;
+        rebuilt->totalSize += 4 + entry.txSize;
+        templateTxs.insert(txid);
+    }
+
+    blockTemplate = std::move(rebuilt);
+    templateLowestScore = lowestScore;
+    templateDirty = false;
+}
+
+void Mempool::UpdateTemplateOnAdd(const Hash256& txid, const MempoolEntry& entry) {
+    if (templateDirty) return;
+
+    bool fits = blockTemplate->totalSize + 4 + entry.txSize <= TEMPLATE_MAX_BYTES &&
+                blockTemplate->transactions.size() + 1 <= TEMPLATE_MAX_TXS;
+    bool parentsIncluded = std::all_of(entry.parents.begin(), entry.parents.end(),
+                                       [this](const Hash256& p) { return templateTxs.count(p); });
+
+    if (fits && parentsIncluded) {
+        // the miner may still be holding the current template, so copy it before appending
+        if (blockTemplate.use_count() > 1) {
+            blockTemplate = std::make_shared<BlockTemplate>(*blockTemplate);
+        }
+        blockTemplate->transactions.push_back(*entry.tx);
+        blockTemplate->totalFees += entry.fee;
+        blockTemplate->totalSize += 4 + entry.txSize;
+        templateTxs.insert(txid);
+        return;
+    }
+
+    // a full template only changes for a package paying more than the worst one it holds
+    if (!fits && entry.ancestorScore <= templateLowestScore) return;
+
+    templateDirty = true;
+}
+
+std::shared_ptr<const BlockTemplate> Mempool::GetBlockTemplate() {
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        if (!templateDirty) return blockTemplate;
+    }
+
+    std::lock_guard<std::shared_mutex> lock(mtx);
+    if (templateDirty) RebuildTemplate();
+    return blockTemplate;
+}
+
+void Mempool::SaveToFile() const {
+    // format: [version(4)] [count(4)] [txSize(4) tx]...
+    std::vector<uint8_t> data;
+    size_t count = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+
+        // fewer ancestors first puts every parent ahead of its children
+        std::vector<const MempoolEntry*> ordered;
+        ordered.reserve(entries.size());
+        for (const auto& [_, entry] : entries) ordered.push_back(&entry);
+        std::sort(ordered.begin(), ordered.end(), [](const MempoolEntry* a, const MempoolEntry* b) {
+            return a->ancestors.count < b->ancestors.count;
+        });
+
+        ByteWriter writer(8 + 4 * entries.size() + totalBytes);
+        writer.WriteUint32(MEMPOOL_FILE_VERSION);
+        writer.WriteUint32(static_cast<uint32_t>(ordered.size()));
+        for (const MempoolEntry* entry : ordered) {
+            writer.WriteUint32(static_cast<uint32_t>(entry->txSize));
+            entry->tx->Serialize(writer);
+        }
+        data = writer.Release();
+        count = ordered.size();
+    }
+
+    // write a temporary file and rename it over the old one, so a crash mid write keeps the
+    // previous dump intact
+    std::string path = Config::GetMempoolPath();
+    std::string tmpPath = path + ".new";
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[mempool] Failed to open " << tmpPath << " for writing" << std::endl;
+            return;
+        }
+        out.write(reinterpret_cast<const char*>(data.data()),
+                  static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            std::cerr << "[mempool] Failed to write " << tmpPath << std::endl;
+            return;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::cerr << "[mempool] Failed to replace " << path << ": " << ec.message() << std::endl;
+        return;
+    }
+    std::cout << "[mempool] Saved " << count << " transactions to " << path << std::endl;
+}
+
+std::vector<Transaction> Mempool::ReadFromFile() {
+    std::vector<Transaction> txs;
+
+    std::string path = Config::GetMempoolPath();
+    if (!std::filesystem::exists(path)) return txs;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "[mempool] Failed to open " << path << " for reading" << std::endl;
+        return txs;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+
+    try {
+        ByteReader reader(data);
+        uint32_t version = reader.ReadUint32();
+        if (version != MEMPOOL_FILE_VERSION) {
+            std::cerr << "[mempool] Ignoring " << path << " with unknown version " << version
+                      << std::endl;
+            return txs;
+        }
+
+        // cap to prevent a corrupted file from allocating huge amounts
+        uint32_t count = std::min<uint32_t>(reader.ReadUint32(), Policy::MAX_MEMPOOL_ENTRIES);
+        txs.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t txSize = reader.ReadUint32();
+            txs.push_back(Transaction::Deserialize(reader.ReadBytes(txSize)));
+        }
+    } catch (const std::exception& e) {
+        // keep whatever was read before the corrupted entry
+        std::cerr << "[mempool] " << path << " is corrupted: " << e.what() << std::endl;
+    }
+
+    return txs;
+}
+
+std::unordered_map<Hash256, Transaction> Mempool::GetTransactions() const {
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    std::unordered_map<Hash256, Transaction> txs;
+    txs.reserve(entries.size());
     for (const auto& [txid, entry] : entries) {
-        txs[txid] = entry.tx;
+        txs[txid] = *entry.tx;
+    }
+    return txs;
+}
+
+std::vector<std::shared_ptr<const Transaction>> Mempool::GetTransactionRefs() const {
+    std::vector<std::shared_ptr<const Transaction>> txs;
+    for (const auto& shard : shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        for (const auto& [_, tx] : shard.txs) txs.push_back(tx);
     }
     return txs;
 }
 
 // TODO: not sure yet how useful this is once I want to add more RPC apis
-std::vector<std::string> Mempool::GetTransactionIDs() const {
-    std::lock_guard<std::mutex> lock(mtx);
-    std::vector<std::string> ids;
+std::vector<Hash256> Mempool::GetTransactionIDs() const {
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    std::vector<Hash256> ids;
     ids.reserve(entries.size());
 
     for (const auto& [txid, _] : entries) {
@@ -116,21 +745,26 @@ std::vector<std::string> Mempool::GetTransactionIDs() const {
     return ids;
 }
 
-std::optional<Transaction> Mempool::FindTransaction(const std::string& txid) const {
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = entries.find(txid);
-    if (it != entries.end()) {
-        return it->second.tx;
+std::optional<Transaction> Mempool::FindTransaction(const Hash256& txid) const {
+    std::shared_ptr<const Transaction> tx;
+    {
+        const LookupShard& shard = ShardFor(txid);
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        auto it = shard.txs.find(txid);
+        if (it == shard.txs.end()) return std::nullopt;
+        tx = it->second;
     }
-    return std::nullopt;
+    // copy outside the lock, the shared pointer keeps it alive if it is removed meanwhile
+    return *tx;
 }
 
-bool Mempool::Contains(const std::string& txid) const {
-    std::lock_guard<std::mutex> lock(mtx);
-    return entries.find(txid) != entries.end();
+bool Mempool::Contains(const Hash256& txid) const {
+    const LookupShard& shard = ShardFor(txid);
+    std::shared_lock<std::shared_mutex> lock(shard.mtx);
+    return shard.txs.count(txid) > 0;
 }
 
 size_t Mempool::GetCount() const {
-    std::lock_guard<std::mutex> lock(mtx);
+    std::shared_lock<std::shared_mutex> lock(mtx);
     return entries.size();
 }
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "merkleCache.h"
+
+#include "blockchain.h"
+
+MerkleCache::IndexedBlock MerkleCache::IndexBlockLocked(const Block& block) {
+    IndexedBlock indexed{block.GetHash(), {}};
+    const auto& txs = block.GetTransactions();
+    indexed.txids.reserve(txs.size());
+    for (uint32_t i = 0; i < static_cast<uint32_t>(txs.size()); i++) {
+        txIndex[txs[i].GetID()] = TxLocation{indexed.hash, i};
+        indexed.txids.push_back(txs[i].GetID());
+    }
+    return indexed;
+}
+
+void MerkleCache::EvictOldestLocked() {
+    const IndexedBlock& oldest = indexedBlocks.front();
+    for (const Hash256& txid : oldest.txids) {
+        // a later block may have reused the txid, keep its entry
+        auto it = txIndex.find(txid);
+        if (it != txIndex.end() && it->second.blockHash == oldest.hash) txIndex.erase(it);
+    }
+    // the evicted block is now the first one below the window
+    scanCursor = oldest.hash;
+    indexedBlocks.pop_front();
+}
+
+void MerkleCache::AddBlock(const Block& block) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    // everything below the first block we see connect is left for FindTransaction to scan
+    if (!cursorSet) {
+        scanCursor = block.GetPreviousHash();
+        cursorSet = true;
+    }
+
+    indexedBlocks.push_back(IndexBlockLocked(block));
+    while (indexedBlocks.size() > maxIndexedBlocks) EvictOldestLocked();
+}
+
+std::optional<TxLocation> MerkleCache::FindTransaction(const Blockchain& chain,
+                                                       const Hash256& txid) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = txIndex.find(txid);
+    if (it != txIndex.end()) return it->second;
+
+    if (!cursorSet) {
+        scanCursor = chain.GetTip();
+        cursorSet = true;
+    }
+
+    // extend the index downwards, newest first, until it holds the window
+    while (!scanCursor.IsNull() && indexedBlocks.size() < maxIndexedBlocks) {
+        Block block = chain.GetBlock(scanCursor);
+        indexedBlocks.push_front(IndexBlockLocked(block));
+        scanCursor = block.GetPreviousHash();
+
+        it = txIndex.find(txid);
+        if (it != txIndex.end()) return it->second;
+    }
+
+    // below the window, read the blocks without keeping them in the index
+    for (Hash256 hash = scanCursor; !hash.IsNull();) {
+        Block block = chain.GetBlock(hash);
+        const auto& txs = block.GetTransactions();
+        for (uint32_t i = 0; i < static_cast<uint32_t>(txs.size()); i++) {
+            if (txs[i].GetID() == txid) return TxLocation{hash, i};
+        }
+        hash = block.GetPreviousHash();
+    }
+
+    return std::nullopt;
+}
+
+std::shared_ptr<const CachedMerkleTree> MerkleCache::GetTree(const Blockchain& chain,
+                                                             const Hash256& blockHash) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = trees.find(blockHash);
+    if (it != trees.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        return *it->second;
+    }
+
+    Block block = chain.GetBlock(blockHash);
+    auto entry = std::make_shared<const CachedMerkleTree>(CachedMerkleTree{
+        blockHash, chain.GetBlockHeight(blockHash), MerkleTree(block.GetTransactions())});
+
+    lru.push_front(entry);
+    trees[blockHash] = lru.begin();
+
+    if (lru.size() > maxTrees) {
+        trees.erase(lru.back()->blockHash);
+        lru.pop_back();
+    }
+
+    return entry;
+}
\ No newline at end of file
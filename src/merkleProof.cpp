@@ -1,32 +1,96 @@
 #include "merkleProof.h"
 
+#include <utility>
+
 #include "crypto.h"
 
-static std::vector<uint8_t> combineAndHash(const std::vector<uint8_t>& left,
-                                           const std::vector<uint8_t>& right) {
-    std::vector<uint8_t> combined;
-    combined.reserve(left.size() + right.size());
-    combined.insert(combined.end(), left.begin(), left.end());
-    combined.insert(combined.end(), right.begin(), right.end());
-    return SHA256Hash(combined);
+Hash256 HashMerkleNode(const Hash256& left, const Hash256& right) {
+    thread_local SHA256Hasher hasher;
+    return hasher.Write(left.bytes).Write(right.bytes).Finalize();
 }
 
 bool VerifyMerkleProof(const MerkleProof& proof) {
-    if (proof.txHash.empty() || proof.merkleRoot.empty()) {
+    if (proof.txHash.IsNull() || proof.merkleRoot.IsNull()) {
         return false;
     }
 
-    std::vector<uint8_t> current = proof.txHash;
+    Hash256 current = proof.txHash;
 
     for (const MerkleProofStep& step : proof.path) {
         if (step.isLeft) {
             // sibling is the left child so combine as sibling | current
-            current = combineAndHash(step.hash, current);
+            current = HashMerkleNode(step.hash, current);
         } else {
             // sibling is the right child so combine as current | sibling
-            current = combineAndHash(current, step.hash);
+            current = HashMerkleNode(current, step.hash);
         }
     }
 
     return current == proof.merkleRoot;
 }
+
+
+// progress through a multiproof's flag bits and hashes
+struct MultiProofCursor {
+        size_t bitsUsed = 0;
+        size_t hashesUsed = 0;
+        std::vector<MerkleMultiProofMatch> matches;
+};
+
+// rebuilds node (level, idx) in the same depth-first order MerkleTree emitted it
+// returns false once the proof runs out of bits or hashes, or duplicates a real sibling
+static bool WalkMultiProof(const MerkleMultiProof& proof, const std::vector<size_t>& widths,
+                           size_t level, size_t idx, MultiProofCursor& cursor, Hash256& out) {
+    if (cursor.bitsUsed >= proof.flags.size() * 8) return false;
+    bool flag = (proof.flags[cursor.bitsUsed / 8] >> (cursor.bitsUsed % 8)) & 1;
+    cursor.bitsUsed++;
+
+    if (level == 0 || !flag) {
+        if (cursor.hashesUsed >= proof.hashes.size()) return false;
+        out = proof.hashes[cursor.hashesUsed++];
+        if (flag) cursor.matches.push_back({static_cast<uint32_t>(idx), out});
+        return true;
+    }
+
+    Hash256 left, right;
+    if (!WalkMultiProof(proof, widths, level - 1, 2 * idx, cursor, left)) return false;
+    if (2 * idx + 1 < widths[level - 1]) {
+        if (!WalkMultiProof(proof, widths, level - 1, 2 * idx + 1, cursor, right)) return false;
+        // a right sibling equal to the left one would let a proof pass off an odd level
+        if (right == left) return false;
+    } else {
+        right = left;
+    }
+
+    out = HashMerkleNode(left, right);
+    return true;
+}
+
+bool VerifyMerkleMultiProof(const MerkleMultiProof& proof,
+                            std::vector<MerkleMultiProofMatch>* matches) {
+    if (proof.txCount == 0 || proof.merkleRoot.IsNull() || proof.hashes.empty() ||
+        proof.hashes.size() > proof.txCount) {
+        return false;
+    }
+
+    // same shape as MerkleTree, widths from the leaves up, reducing the leaf level at least once
+    std::vector<size_t> widths{proof.txCount};
+    do {
+        widths.push_back((widths.back() + 1) / 2);
+    } while (widths.back() > 1);
+
+    MultiProofCursor cursor;
+    Hash256 root;
+    if (!WalkMultiProof(proof, widths, widths.size() - 1, 0, cursor, root)) return false;
+
+    // every hash used and no whole flag byte left over
+    if (cursor.hashesUsed != proof.hashes.size() ||
+        (cursor.bitsUsed + 7) / 8 != proof.flags.size()) {
+        return false;
+    }
+
+    if (root != proof.merkleRoot || cursor.matches.empty()) return false;
+
+    if (matches) *matches = std::move(cursor.matches);
+    return true;
+}
\ No newline at end of file
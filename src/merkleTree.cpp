@@ -1,18 +1,35 @@
 #include "merkleTree.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <string>
+#include <thread>
 
-#include "crypto.h"
+#include "sha256.h"
 #include "transaction.h"
 
-std::vector<uint8_t> MerkleTree::combineAndHash(const std::vector<uint8_t>& left,
-                                                const std::vector<uint8_t>& right) {
-    std::vector<uint8_t> combined;
-    combined.reserve(left.size() + right.size());
-    combined.insert(combined.end(), left.begin(), left.end());
-    combined.insert(combined.end(), right.begin(), right.end());
-    return SHA256Hash(combined);
+// levels are hashed in place as raw bytes, which needs nodes packed without padding
+static_assert(sizeof(Hash256) == HASH256_SIZE);
+
+// runs fn(begin, end) over [0, count), split across hardware threads for large counts
+template <typename Fn>
+static void ParallelFor(size_t count, Fn fn) {
+    size_t workers = std::min<size_t>(std::thread::hardware_concurrency(),
+                                      count / (MERKLE_PARALLEL_THRESHOLD / 2));
+    if (count < MERKLE_PARALLEL_THRESHOLD || workers < 2) {
+        fn(0, count);
+        return;
+    }
+
+    size_t chunk = (count + workers - 1) / workers;
+    std::vector<std::jthread> threads;
+    threads.reserve(workers - 1);
+
+    // the calling thread takes the first chunk itself
+    for (size_t begin = chunk; begin < count; begin += chunk) {
+        threads.emplace_back(fn, begin, std::min(begin + chunk, count));
+    }
+    fn(0, std::min(chunk, count));
 }
 
 MerkleTree::MerkleTree(const std::vector<Transaction>& transactions) {
@@ -20,66 +37,78 @@ MerkleTree::MerkleTree(const std::vector<Transaction>& transactions) {
         throw std::invalid_argument("Cannot build Merkle tree from empty transaction list");
     }
 
-    // at level 0, one leaf hash per transaction
-    std::vector<std::vector<uint8_t>> currentLevel;
-    currentLevel.reserve(transactions.size());
-    for (const Transaction& tx : transactions) {
-        currentLevel.push_back(SHA256Hash(tx.Serialize()));
-    }
-
-    // pad odd length levels by duplicating the last hash
-    if (currentLevel.size() % 2 != 0) {
-        currentLevel.push_back(currentLevel.back());
-    }
+    // lay out every level up front so the whole tree is a single allocation
+    // the leaf level is always reduced once, so a lone transaction is paired with itself
+    levelOffsets.push_back(0);
+    size_t width = transactions.size();
+    size_t total = width;
+    levelOffsets.push_back(total);
+    do {
+        width = (width + 1) / 2;
+        total += width;
+        levelOffsets.push_back(total);
+    } while (width > 1);
 
-    levels.push_back(currentLevel);
+    nodes.resize(total);
 
-    // reduce level by level until we reach the single root
-    while (currentLevel.size() > 1) {
-        if (currentLevel.size() % 2 != 0) {
-            currentLevel.push_back(currentLevel.back());
-        }
-
-        std::vector<std::vector<uint8_t>> nextLevel;
-        nextLevel.reserve(currentLevel.size() / 2);
-        for (size_t i = 0; i + 1 < currentLevel.size(); i += 2) {
-            nextLevel.push_back(combineAndHash(currentLevel[i], currentLevel[i + 1]));
+    // at level 0, one leaf hash per transaction
+    ParallelFor(transactions.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            nodes[i] = transactions[i].Hash();
         }
+    });
 
-        levels.push_back(nextLevel);
-        currentLevel = nextLevel;
+    // reduce level by level until we reach the single root
+    for (size_t level = 0; level + 1 < LevelCount(); level++) {
+        size_t childWidth = LevelWidth(level);
+        const Hash256* children = nodes.data() + levelOffsets[level];
+        Hash256* parents = nodes.data() + levelOffsets[level + 1];
+
+        // sibling pairs are adjacent, so every complete pair is one 64 byte batch message
+        size_t pairs = childWidth / 2;
+        ParallelFor(LevelWidth(level + 1), [&](size_t begin, size_t end) {
+            size_t batchEnd = std::min(end, pairs);
+            if (begin < batchEnd) {
+                SHA256Batch(children[2 * begin].data(), 2 * HASH256_SIZE, batchEnd - begin,
+                            parents[begin].data());
+            }
+
+            // an odd level's last node pairs with itself
+            if (end > pairs) {
+                parents[pairs] = HashMerkleNode(children[2 * pairs], children[2 * pairs]);
+            }
+        });
     }
 }
 
 MerkleProof MerkleTree::GenerateProof(uint32_t txIndex) const {
-    if (levels.empty() || txIndex >= levels[0].size()) {
+    if (nodes.empty() || txIndex >= LevelWidth(0)) {
         throw std::out_of_range("txIndex " + std::to_string(txIndex) +
                                 " out of range (leaf level has " +
-                                std::to_string(levels[0].size()) + " entries)");
+                                std::to_string(LevelWidth(0)) + " entries)");
     }
 
     MerkleProof proof;
-    proof.txHash = levels[0][txIndex];
+    proof.txHash = Node(0, txIndex);
     proof.txIndex = txIndex;
-    proof.merkleRoot = levels.back()[0];
+    proof.merkleRoot = GetRootHash();
 
     uint32_t idx = txIndex;
 
     // walk from the leaf level up, collecting the sibling at each level
-    for (size_t level = 0; level + 1 < levels.size(); level++) {
-        const auto& currentLevel = levels[level];
-
+    proof.path.reserve(LevelCount() - 1);
+    for (size_t level = 0; level + 1 < LevelCount(); level++) {
         // both lines below get the sibling index
         // uint32_t siblingIdx = (idx % 2 == 0) ? idx + 1 : idx - 1;
         uint32_t siblingIdx = idx ^ 1;
 
         // for odd length levels, the sibling is the duplicate
-        if (siblingIdx >= currentLevel.size()) {
+        if (siblingIdx >= LevelWidth(level)) {
             siblingIdx = idx;
         }
 
         MerkleProofStep step;
-        step.hash = currentLevel[siblingIdx];
+        step.hash = Node(level, siblingIdx);
         step.isLeft = (idx % 2 == 1);
         proof.path.push_back(step);
 
@@ -89,4 +118,53 @@ MerkleProof MerkleTree::GenerateProof(uint32_t txIndex) const {
     return proof;
 }
 
+// emits node (level, idx): its flag bit, then either its hash or both of its children
+void MerkleTree::BuildMultiProof(size_t level, size_t idx, const std::vector<bool>& covered,
+                                 MerkleMultiProof& proof, size_t& bitsUsed) const {
+    bool flag = covered[levelOffsets[level] + idx];
+    if (bitsUsed % 8 == 0) proof.flags.push_back(0);
+    proof.flags.back() |= static_cast<uint8_t>(flag) << (bitsUsed % 8);
+    bitsUsed++;
+
+    if (level == 0 || !flag) {
+        proof.hashes.push_back(Node(level, idx));
+        return;
+    }
+
+    BuildMultiProof(level - 1, 2 * idx, covered, proof, bitsUsed);
+    if (2 * idx + 1 < LevelWidth(level - 1)) {
+        BuildMultiProof(level - 1, 2 * idx + 1, covered, proof, bitsUsed);
+    }
+}
+
+MerkleMultiProof MerkleTree::GenerateMultiProof(const std::vector<uint32_t>& txIndices) const {
+    if (txIndices.empty()) {
+        throw std::invalid_argument("Cannot build a multiproof for no transactions");
+    }
+
+    // mark every node with a proven leaf below it, from the leaves up
+    std::vector<bool> covered(nodes.size(), false);
+    for (uint32_t txIndex : txIndices) {
+        if (txIndex >= LevelWidth(0)) {
+            throw std::out_of_range("txIndex " + std::to_string(txIndex) +
+                                    " out of range (leaf level has " +
+                                    std::to_string(LevelWidth(0)) + " entries)");
+        }
+        covered[txIndex] = true;
+    }
+    for (size_t level = 0; level + 1 < LevelCount(); level++) {
+        for (size_t i = 0; i < LevelWidth(level); i++) {
+            if (covered[levelOffsets[level] + i]) covered[levelOffsets[level + 1] + i / 2] = true;
+        }
+    }
+
+    MerkleMultiProof proof;
+    proof.txCount = static_cast<uint32_t>(LevelWidth(0));
+    proof.merkleRoot = GetRootHash();
+
+    size_t bitsUsed = 0;
+    BuildMultiProof(LevelCount() - 1, 0, covered, proof, bitsUsed);
+    return proof;
+}
+
 bool MerkleTree::VerifyProof(const MerkleProof& proof) { return VerifyMerkleProof(proof); }
\ No newline at end of file
@@ -1,21 +1,23 @@
 #include "message.h"
 
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
+#include <utility>
 
+#include "byteStream.h"
 #include "crypto.h"
-#include "serialization.h"
 
 Message::Message(const std::array<uint8_t, MAGIC_LENGTH>& magic, const std::string& command,
-                 const std::vector<uint8_t>& payload)
-    : magic(magic), payload(payload) {
+                 std::vector<uint8_t> payload)
+    : magic(magic), payload(std::move(payload)) {
     if (command.length() > 12) {
         throw std::runtime_error("Command name cannot exceed 12 characters");
     }
 
     this->command = CreateCommand(command);
-    this->payloadLength = static_cast<uint32_t>(payload.size());
-    this->checksum = CalculateChecksum(payload);
+    this->payloadLength = static_cast<uint32_t>(this->payload.size());
+    this->checksum = CalculateChecksum(this->payload);
 }
 
 std::string Message::GetCommandString() const {
@@ -28,84 +30,57 @@ std::string Message::GetCommandString() const {
 }
 
 std::vector<uint8_t> Message::Serialize() const {
-    std::vector<uint8_t> result;
+    ByteWriter writer(MAGIC_LENGTH + COMMAND_LENGTH + 4 + CHECKSUM_LENGTH + payload.size());
 
     // magic (4 bytes)
-    result.insert(result.end(), magic.begin(), magic.end());
+    writer.WriteBytes(magic);
 
     // command (12 bytes)
-    result.insert(result.end(), command.begin(), command.end());
+    writer.WriteBytes({reinterpret_cast<const uint8_t*>(command.data()), COMMAND_LENGTH});
 
     // length (4 bytes)
-    WriteUint32(result, payloadLength);
+    writer.WriteUint32(payloadLength);
 
     // checksum (4 bytes)
-    result.insert(result.end(), checksum.begin(), checksum.end());
+    writer.WriteBytes(checksum);
 
     // payload (variable bytes)
-    result.insert(result.end(), payload.begin(), payload.end());
+    writer.WriteBytes(payload);
 
-    return result;
+    return writer.Release();
 }
 
-Message Message::Deserialize(const std::vector<uint8_t>& data) {
-    Message msg;
-    size_t offset = 0;
-
+Message Message::Deserialize(std::span<const uint8_t> data) {
     // minimum message size: 4 (magic) + 12 (command) + 4 (length) + 4 (checksum) = 24 bytes
     if (data.size() < 24) {
         throw std::runtime_error("Message data too small to deserialize");
     }
 
-    // magic (4 bytes)
-    std::copy(data.begin() + offset, data.begin() + offset + 4, msg.magic.begin());
-    offset += 4;
-
-    if (msg.magic != MAGIC_CUSTOM) {
-        throw std::runtime_error("Invalid network magic number");
-    }
-
-    // command (12 bytes)
-    std::copy(data.begin() + offset, data.begin() + offset + 12, msg.command.begin());
-    offset += 12;
-
-    // length (4 bytes)
-    msg.payloadLength = ReadUint32(data, offset);
-    offset += 4;
-
-    // checksum (4 bytes)
-    std::copy(data.begin() + offset, data.begin() + offset + 4, msg.checksum.begin());
-    offset += 4;
+    Message msg = DeserializeHeader(data.first(24));
 
     // payload (variable bytes)
-    if (offset + msg.payloadLength > data.size()) {
+    if (msg.payloadLength > data.size() - 24) {
         throw std::runtime_error("Message data truncated: payload extends past end");
     }
 
-    msg.payload =
-        std::vector<uint8_t>(data.begin() + offset, data.begin() + offset + msg.payloadLength);
-
-    // verify checksum
-    std::array<uint8_t, CHECKSUM_LENGTH> calculatedChecksum = CalculateChecksum(msg.payload);
-    if (calculatedChecksum != msg.checksum) {
-        throw std::runtime_error("Message checksum verification failed");
-    }
+    std::span<const uint8_t> payload = data.subspan(24, msg.payloadLength);
+    msg.AttachPayload(std::vector<uint8_t>(payload.begin(), payload.end()));
 
     return msg;
 }
 
-Message Message::DeserializeHeader(const std::vector<uint8_t>& data) {
+Message Message::DeserializeHeader(std::span<const uint8_t> data) {
     Message msg;
 
     if (data.size() < 24) {
         throw std::runtime_error("Message header data too small");
     }
 
-    size_t offset = 0;
+    ByteReader reader(data);
 
     // magic (4 bytes)
-    std::copy(data.begin() + offset, data.begin() + offset + 4, msg.magic.begin());
-    offset += 4;
+    std::span<const uint8_t> magic = reader.ReadBytes(MAGIC_LENGTH);
+    std::copy(magic.begin(), magic.end(), msg.magic.begin());
 
     // validate magic matches the network
     if (msg.magic != MAGIC_CUSTOM) {
@@ -113,22 +88,37 @@ Message Message::DeserializeHeader(const std::vector<uint8_t>& data) {
     }
 
     // command (12 bytes)
-    std::copy(data.begin() + offset, data.begin() + offset + 12, msg.command.begin());
-    offset += 12;
+    std::span<const uint8_t> command = reader.ReadBytes(COMMAND_LENGTH);
+    std::copy(command.begin(), command.end(), msg.command.begin());
 
     // payload length (4 bytes)
-    msg.payloadLength = ReadUint32(data, offset);
-    offset += 4;
+    msg.payloadLength = reader.ReadUint32();
 
     // checksum (4 bytes)
-    std::copy(data.begin() + offset, data.begin() + offset + 4, msg.checksum.begin());
+    std::span<const uint8_t> checksum = reader.ReadBytes(CHECKSUM_LENGTH);
+    std::copy(checksum.begin(), checksum.end(), msg.checksum.begin());
 
     return msg;
 }
 
-std::array<uint8_t, CHECKSUM_LENGTH> CalculateChecksum(const std::vector<uint8_t>& payload) {
+void Message::AttachPayload(std::vector<uint8_t> data) {
+    if (data.size() != payloadLength) {
+        throw std::runtime_error("Message payload size " + std::to_string(data.size()) +
+                                 " does not match header length " +
+                                 std::to_string(payloadLength));
+    }
+
+    // verify checksum
+    if (CalculateChecksum(data) != checksum) {
+        throw std::runtime_error("Message checksum verification failed");
+    }
+
+    payload = std::move(data);
+}
+
+std::array<uint8_t, CHECKSUM_LENGTH> CalculateChecksum(std::span<const uint8_t> payload) {
     // checksum is the first 4 bytes of SHA256(SHA256(payload))
-    std::vector<uint8_t> hash = SHA256Hash(SHA256Hash(payload));
+    Hash256 hash = SHA256DoubleDigest(payload);
 
     std::array<uint8_t, CHECKSUM_LENGTH> checksum;
     std::copy(hash.begin(), hash.begin() + CHECKSUM_LENGTH, checksum.begin());
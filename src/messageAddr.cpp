@@ -2,8 +2,6 @@
 
 #include <stdexcept>
 
-#include "serialization.h"
-
 MessageAddr::MessageAddr(const std::vector<NetAddr>& addresses) : addresses(addresses) {
     if (addresses.size() > MAX_ADDR_PER_MSG) {
         throw std::runtime_error("addr message exceeds maximum of " +
@@ -12,30 +10,29 @@ MessageAddr::MessageAddr(const std::vector<NetAddr>& addresses) : addresses(addr
 }
 
 std::vector<uint8_t> MessageAddr::Serialize() const {
-    std::vector<uint8_t> result;
+    // count(4) + per address: time(4) + services(8) + ip(16) + port(2)
+    ByteWriter writer(4 + addresses.size() * 30);
 
     // address count (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(addresses.size()));
+    writer.WriteUint32(static_cast<uint32_t>(addresses.size()));
 
     // each address serialized with time
     for (const auto& addr : addresses) {
-        std::vector<uint8_t> addrSerialized = addr.Serialize(/*includeTime=*/true);
-        result.insert(result.end(), addrSerialized.begin(), addrSerialized.end());
+        addr.Serialize(writer, /*includeTime=*/true);
     }
 
-    return result;
+    return writer.Release();
 }
 
-MessageAddr MessageAddr::Deserialize(const std::vector<uint8_t>& data) {
+MessageAddr MessageAddr::Deserialize(std::span<const uint8_t> data) {
     if (data.size() < 4) {
         throw std::runtime_error("MessageAddr data too small to deserialize");
     }
 
-    size_t offset = 0;
+    ByteReader reader(data);
 
     // address count (4 bytes)
-    uint32_t count = ReadUint32(data, offset);
-    offset += 4;
+    uint32_t count = reader.ReadUint32();
 
     if (count > MAX_ADDR_PER_MSG) {
         throw std::runtime_error("addr message contains " + std::to_string(count) +
@@ -47,9 +44,7 @@ MessageAddr MessageAddr::Deserialize(const std::vector<uint8_t>& data) {
     addresses.reserve(count);
 
     for (uint32_t i = 0; i < count; i++) {
-        auto [addr, bytesRead] = NetAddr::Deserialize(data, offset, /*includeTime=*/true);
-        addresses.push_back(addr);
-        offset += bytesRead;
+        addresses.push_back(NetAddr::Deserialize(reader, /*includeTime=*/true));
     }
 
     return MessageAddr(addresses);
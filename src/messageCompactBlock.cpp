@@ -0,0 +1,271 @@
+#include "messageCompactBlock.h"
+
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "byteStream.h"
+#include "crypto.h"
+
+static uint64_t RotateLeft(uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+
+static void SipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+    v0 += v1;
+    v1 = RotateLeft(v1, 13);
+    v1 ^= v0;
+    v0 = RotateLeft(v0, 32);
+    v2 += v3;
+    v3 = RotateLeft(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = RotateLeft(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = RotateLeft(v1, 17);
+    v1 ^= v2;
+    v2 = RotateLeft(v2, 32);
+}
+
+// SipHash-2-4 of a 32 byte hash, unrolled for the fixed length
+static uint64_t SipHash(uint64_t k0, uint64_t k1, const Hash256& h) {
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+    for (size_t i = 0; i < HASH256_SIZE; i += 8) {
+        uint64_t m = 0;
+        for (size_t j = 0; j < 8; j++) m |= static_cast<uint64_t>(h[i + j]) << (8 * j);
+        v3 ^= m;
+        SipRound(v0, v1, v2, v3);
+        SipRound(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    // the last block only carries the message length
+    uint64_t last = static_cast<uint64_t>(HASH256_SIZE) << 56;
+    v3 ^= last;
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    v0 ^= last;
+
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++) SipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// counts a block can't hold are rejected before anything is reserved for them
+static void CheckTransactionCount(uint64_t count) {
+    if (count > Policy::MAX_BLOCK_TXS) {
+        throw std::runtime_error("Transaction count " + std::to_string(count) +
+                                 " exceeds maximum " + std::to_string(Policy::MAX_BLOCK_TXS));
+    }
+}
+
+// for the compact block
+MessageCompactBlock::MessageCompactBlock(const Block& block)
+    : timestamp(block.GetTimestamp()),
+      previousHash(block.GetPreviousHash()),
+      merkleRoot(block.HashTransactions()),
+      hash(block.GetHash()),
+      nonce(block.GetNonce()),
+      bits(block.GetBits()) {
+    std::random_device rd;
+    salt = (static_cast<uint64_t>(rd()) << 32) | rd();
+    DeriveKeys();
+
+    const auto& txs = block.GetTransactions();
+    if (txs.empty()) throw std::runtime_error("Cannot build a compact block without transactions");
+
+    prefilled.push_back({0, txs[0]});
+    shortIDs.reserve(txs.size() - 1);
+    for (size_t i = 1; i < txs.size(); i++) {
+        shortIDs.push_back(ShortID(txs[i].GetID()));
+    }
+}
+
+void MessageCompactBlock::DeriveKeys() {
+    // SHA-256(block hash || salt), its first two little-endian words key the SipHash
+    uint8_t saltBytes[8];
+    for (int i = 0; i < 8; i++) saltBytes[i] = static_cast<uint8_t>(salt >> (8 * i));
+
+    SHA256Hasher hasher;
+    Hash256 digest = hasher.Write(hash.bytes).Write(saltBytes).Finalize();
+
+    key0 = 0;
+    key1 = 0;
+    for (int i = 0; i < 8; i++) {
+        key0 |= static_cast<uint64_t>(digest[i]) << (8 * i);
+        key1 |= static_cast<uint64_t>(digest[8 + i]) << (8 * i);
+    }
+}
+
+uint64_t MessageCompactBlock::ShortID(const Hash256& txid) const {
+    return SipHash(key0, key1, txid) & 0xffff'ffff'ffffULL;
+}
+
+std::vector<uint8_t> MessageCompactBlock::Serialize() const {
+    size_t size = 8 + 32 + 32 + 32 + 4 + 4 + 8 + 4 + shortIDs.size() * SHORT_TXID_SIZE + 4;
+    for (const auto& p : prefilled) size += 4 + 4 + p.tx.SerializedSize();
+    ByteWriter writer(size);
+
+    // header: timestamp (8 bytes), previous hash (32 bytes), merkle root (32 bytes),
+    // hash (32 bytes), nonce (4 bytes), bits (4 bytes)
+    writer.WriteUint64(static_cast<uint64_t>(timestamp));
+    writer.WriteHash256(previousHash);
+    writer.WriteHash256(merkleRoot);
+    writer.WriteHash256(hash);
+    writer.WriteUint32(static_cast<uint32_t>(nonce));
+    writer.WriteUint32(static_cast<uint32_t>(bits));
+
+    // salt (8 bytes)
+    writer.WriteUint64(salt);
+
+    // short txids, count (4 bytes) then 6 bytes each
+    writer.WriteUint32(static_cast<uint32_t>(shortIDs.size()));
+    for (uint64_t id : shortIDs) {
+        writer.WriteUint32(static_cast<uint32_t>(id));
+        writer.WriteUint8(static_cast<uint8_t>(id >> 32));
+        writer.WriteUint8(static_cast<uint8_t>(id >> 40));
+    }
+
+    // prefilled transactions, count (4 bytes) then index (4 bytes), size (4 bytes) and tx
+    writer.WriteUint32(static_cast<uint32_t>(prefilled.size()));
+    for (const auto& p : prefilled) {
+        writer.WriteUint32(p.index);
+        writer.WriteUint32(static_cast<uint32_t>(p.tx.SerializedSize()));
+        p.tx.Serialize(writer);
+    }
+
+    return writer.Release();
+}
+
+MessageCompactBlock MessageCompactBlock::Deserialize(std::span<const uint8_t> data) {
+    MessageCompactBlock compact;
+    ByteReader reader(data);
+
+    // header
+    compact.timestamp = static_cast<int64_t>(reader.ReadUint64());
+    compact.previousHash = reader.ReadHash256();
+    compact.merkleRoot = reader.ReadHash256();
+    compact.hash = reader.ReadHash256();
+    compact.nonce = static_cast<int32_t>(reader.ReadUint32());
+    compact.bits = static_cast<int32_t>(reader.ReadUint32());
+
+    // salt
+    compact.salt = reader.ReadUint64();
+    compact.DeriveKeys();
+
+    // short txids
+    uint32_t shortIDCount = reader.ReadUint32();
+    CheckTransactionCount(shortIDCount);
+    compact.shortIDs.reserve(shortIDCount);
+    for (uint32_t i = 0; i < shortIDCount; i++) {
+        uint64_t id = reader.ReadUint32();
+        id |= static_cast<uint64_t>(reader.ReadUint8()) << 32;
+        id |= static_cast<uint64_t>(reader.ReadUint8()) << 40;
+        compact.shortIDs.push_back(id);
+    }
+
+    // prefilled transactions
+    uint32_t prefilledCount = reader.ReadUint32();
+    CheckTransactionCount(static_cast<uint64_t>(shortIDCount) + prefilledCount);
+    compact.prefilled.reserve(prefilledCount);
+    for (uint32_t i = 0; i < prefilledCount; i++) {
+        uint32_t index = reader.ReadUint32();
+        if (index >= shortIDCount + prefilledCount ||
+            (i > 0 && index <= compact.prefilled.back().index)) {
+            throw std::runtime_error("Compact block prefilled index " + std::to_string(index) +
+                                     " out of order or range");
+        }
+        uint32_t txSize = reader.ReadUint32();
+        compact.prefilled.push_back({index, Transaction::Deserialize(reader.ReadBytes(txSize))});
+    }
+
+    if (compact.GetTransactionCount() == 0) {
+        throw std::runtime_error("Compact block has no transactions");
+    }
+    if (!reader.Empty()) {
+        throw std::runtime_error("Compact block has trailing data");
+    }
+
+    return compact;
+}
+
+// for the getblocktxn
+MessageGetBlockTxn::MessageGetBlockTxn(const Hash256& blockHash, std::vector<uint32_t> indexes)
+    : blockHash(blockHash), indexes(std::move(indexes)) {}
+
+std::vector<uint8_t> MessageGetBlockTxn::Serialize() const {
+    ByteWriter writer(32 + 4 + indexes.size() * 4);
+
+    // block hash (32 bytes)
+    writer.WriteHash256(blockHash);
+
+    // count (4 bytes) then each index (4 bytes)
+    writer.WriteUint32(static_cast<uint32_t>(indexes.size()));
+    for (uint32_t index : indexes) writer.WriteUint32(index);
+
+    return writer.Release();
+}
+
+MessageGetBlockTxn MessageGetBlockTxn::Deserialize(std::span<const uint8_t> data) {
+    ByteReader reader(data);
+
+    Hash256 blockHash = reader.ReadHash256();
+
+    uint32_t count = reader.ReadUint32();
+    CheckTransactionCount(count);
+    std::vector<uint32_t> indexes;
+    indexes.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = reader.ReadUint32();
+        if (i > 0 && index <= indexes.back()) {
+            throw std::runtime_error("getblocktxn indexes are not ascending");
+        }
+        indexes.push_back(index);
+    }
+
+    return MessageGetBlockTxn(blockHash, std::move(indexes));
+}
+
+// for the blocktxn
+MessageBlockTxn::MessageBlockTxn(const Hash256& blockHash, std::vector<Transaction> transactions)
+    : blockHash(blockHash), transactions(std::move(transactions)) {}
+
+std::vector<uint8_t> MessageBlockTxn::Serialize() const {
+    size_t size = 32 + 4;
+    for (const auto& tx : transactions) size += 4 + tx.SerializedSize();
+    ByteWriter writer(size);
+
+    // block hash (32 bytes)
+    writer.WriteHash256(blockHash);
+
+    // count (4 bytes) then each transaction, size (4 bytes) and tx
+    writer.WriteUint32(static_cast<uint32_t>(transactions.size()));
+    for (const auto& tx : transactions) {
+        writer.WriteUint32(static_cast<uint32_t>(tx.SerializedSize()));
+        tx.Serialize(writer);
+    }
+
+    return writer.Release();
+}
+
+MessageBlockTxn MessageBlockTxn::Deserialize(std::span<const uint8_t> data) {
+    ByteReader reader(data);
+
+    Hash256 blockHash = reader.ReadHash256();
+
+    uint32_t count = reader.ReadUint32();
+    CheckTransactionCount(count);
+    std::vector<Transaction> transactions;
+    transactions.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t txSize = reader.ReadUint32();
+        transactions.push_back(Transaction::Deserialize(reader.ReadBytes(txSize)));
+    }
+
+    return MessageBlockTxn(blockHash, std::move(transactions));
+}
\ No newline at end of file
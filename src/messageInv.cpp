@@ -2,56 +2,38 @@
 
 #include <stdexcept>
 
-#include "serialization.h"
-
 // for the inventory vector
-std::vector<uint8_t> InvVector::Serialize() const {
-    std::vector<uint8_t> result;
-
+void InvVector::Serialize(ByteWriter& writer) const {
     // type (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(type));
+    writer.WriteUint32(static_cast<uint32_t>(type));
 
     // hash size (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(hash.size()));
-
-    // hash (variable bytes)
-    result.insert(result.end(), hash.begin(), hash.end());
+    writer.WriteUint32(static_cast<uint32_t>(hash.size()));
 
-    return result;
+    // hash (32 bytes)
+    writer.WriteHash256(hash);
 }
 
-std::pair<InvVector, size_t> InvVector::Deserialize(const std::vector<uint8_t>& data,
-                                                    size_t offset) {
+InvVector InvVector::Deserialize(ByteReader& reader) {
     InvVector invVec;
-    size_t startOffset = offset;
 
     // type (4 bytes)
-    if (offset + 4 > data.size()) {
-        throw std::runtime_error("InvVector data truncated at type");
-    }
-    uint32_t rawType = ReadUint32(data, offset);
+    uint32_t rawType = reader.ReadUint32();
     if (rawType > static_cast<uint32_t>(InvType::Block)) {
         throw std::runtime_error("Unknown inventory type: " + std::to_string(rawType));
     }
     invVec.type = static_cast<InvType>(rawType);
-    offset += 4;
 
     // hash size (4 bytes)
-    if (offset + 4 > data.size()) {
-        throw std::runtime_error("InvVector data truncated at hash size");
-    }
-    uint32_t hashSize = ReadUint32(data, offset);
-    offset += 4;
+    uint32_t hashSize = reader.ReadUint32();
 
-    // hash (variable bytes)
-    if (offset + hashSize > data.size()) {
-        throw std::runtime_error("InvVector data truncated at hash");
+    // hash (32 bytes)
+    if (hashSize != HASH256_SIZE) {
+        throw std::runtime_error("InvVector has invalid hash size " + std::to_string(hashSize));
     }
-    invVec.hash = std::vector<uint8_t>(data.begin() + offset, data.begin() + offset + hashSize);
-    offset += hashSize;
+    invVec.hash = reader.ReadHash256();
 
-    size_t bytesRead = offset - startOffset;
-    return {invVec, bytesRead};
+    return invVec;
 }
 
 // for the messageInv and the messageGetData
@@ -63,39 +45,35 @@ MessageInv::MessageInv(const std::vector<InvVector>& inventory) : inventory(inve
 }
 
 std::vector<uint8_t> MessageInv::Serialize() const {
-    std::vector<uint8_t> result;
+    ByteWriter writer(1 + inventory.size() * InvVector::SERIALIZED_SIZE);
 
     // count (1 byte)
-    result.push_back(count);
+    writer.WriteUint8(count);
 
     // inventory vectors (variable bytes)
     for (const auto& invVec : inventory) {
-        std::vector<uint8_t> invVecData = invVec.Serialize();
-        result.insert(result.end(), invVecData.begin(), invVecData.end());
+        invVec.Serialize(writer);
     }
 
-    return result;
+    return writer.Release();
 }
 
-MessageInv MessageInv::Deserialize(const std::vector<uint8_t>& data) {
+MessageInv MessageInv::Deserialize(std::span<const uint8_t> data) {
     if (data.empty()) {
         throw std::runtime_error("MessageInv data too small to deserialize");
     }
 
-    size_t offset = 0;
+    ByteReader reader(data);
 
     // count (1 byte)
-    uint8_t count = data[offset];
-    offset += 1;
+    uint8_t count = reader.ReadUint8();
 
     // inventory vectors
     std::vector<InvVector> inventory;
     inventory.reserve(count);
 
     for (uint8_t i = 0; i < count; i++) {
-        auto [invVec, bytesRead] = InvVector::Deserialize(data, offset);
-        inventory.push_back(invVec);
-        offset += bytesRead;
+        inventory.push_back(InvVector::Deserialize(reader));
     }
 
     return MessageInv(inventory);
@@ -3,26 +3,26 @@
 #include <random>
 #include <stdexcept>
 
-#include "serialization.h"
+#include "byteStream.h"
 
 MessagePing::MessagePing(uint64_t nonce) : nonce(nonce) {}
 
 std::vector<uint8_t> MessagePing::Serialize() const {
-    std::vector<uint8_t> result;
+    ByteWriter writer(8);
 
     // nonce (8 bytes)
-    WriteUint64(result, nonce);
+    writer.WriteUint64(nonce);
 
-    return result;
+    return writer.Release();
 }
 
-MessagePing MessagePing::Deserialize(const std::vector<uint8_t>& data) {
+MessagePing MessagePing::Deserialize(std::span<const uint8_t> data) {
     if (data.size() < 8) {
         throw std::runtime_error("MessagePing data too small to deserialize");
     }
 
-    uint64_t nonce = ReadUint64(data, 0);
-    return MessagePing(nonce);
+    ByteReader reader(data);
+    return MessagePing(reader.ReadUint64());
 }
 
 std::pair<Message, uint64_t> CreatePingMessage() {
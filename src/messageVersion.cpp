@@ -4,8 +4,6 @@
 #include <random>
 #include <stdexcept>
 
-#include "serialization.h"
-
 MessageVersion::MessageVersion(const std::string& receiverIP, uint16_t receiverPort,
                                const std::string& senderIP, uint16_t senderPort,
                                int32_t startHeight, bool relay)
@@ -28,104 +26,81 @@ MessageVersion::MessageVersion(const std::string& receiverIP, uint16_t receiverP
 }
 
 std::vector<uint8_t> MessageVersion::Serialize() const {
-    std::vector<uint8_t> result;
+    if (userAgent.length() > 255) {
+        throw std::runtime_error("User agent too long (max 255 characters)");
+    }
+
+    ByteWriter writer(4 + 8 + 8 + 26 + 26 + 8 + 1 + userAgent.length() + 4 + 1);
 
     // version (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(version));
+    writer.WriteUint32(static_cast<uint32_t>(version));
 
     // services (8 bytes)
-    WriteUint64(result, services);
+    writer.WriteUint64(services);
 
     // timestamp (8 bytes)
-    WriteUint64(result, static_cast<uint64_t>(timestamp));
+    writer.WriteUint64(static_cast<uint64_t>(timestamp));
 
     // addrRecv (26 bytes)
-    std::vector<uint8_t> recvSerialized = addrRecv.Serialize(false);
-    result.insert(result.end(), recvSerialized.begin(), recvSerialized.end());
+    addrRecv.Serialize(writer, false);
 
     // addrFrom (26 bytes)
-    std::vector<uint8_t> fromSerialized = addrFrom.Serialize(false);
-    result.insert(result.end(), fromSerialized.begin(), fromSerialized.end());
+    addrFrom.Serialize(writer, false);
 
     // nonce (8 bytes)
-    WriteUint64(result, nonce);
+    writer.WriteUint64(nonce);
 
     // userAgent (variable bytes)
-    if (userAgent.length() > 255) {
-        throw std::runtime_error("User agent too long (max 255 characters)");
-    }
-    result.push_back(static_cast<uint8_t>(userAgent.length()));
-    result.insert(result.end(), userAgent.begin(), userAgent.end());
+    writer.WriteUint8(static_cast<uint8_t>(userAgent.length()));
+    writer.WriteBytes(StringAsBytes(userAgent));
 
     // startHeight (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(startHeight));
+    writer.WriteUint32(static_cast<uint32_t>(startHeight));
 
     // relay (1 byte)
-    result.push_back(relay ? 0x01 : 0x00);
+    writer.WriteUint8(relay ? 0x01 : 0x00);
 
-    return result;
+    return writer.Release();
 }
 
-MessageVersion MessageVersion::Deserialize(const std::vector<uint8_t>& data) {
+MessageVersion MessageVersion::Deserialize(std::span<const uint8_t> data) {
     MessageVersion msg;
-    size_t offset = 0;
 
     // minimum size: 4+8+8+26+26+8+1+4+1 = 86 bytes
     if (data.size() < 86) {
         throw std::runtime_error("MessageVersion data too small to deserialize");
     }
 
+    ByteReader reader(data);
+
     // version (4 bytes)
-    msg.version = static_cast<int32_t>(ReadUint32(data, offset));
-    offset += 4;
+    msg.version = static_cast<int32_t>(reader.ReadUint32());
 
     // services (8 bytes)
-    msg.services = ReadUint64(data, offset);
-    offset += 8;
+    msg.services = reader.ReadUint64();
 
     // timestamp (8 bytes)
-    msg.timestamp = static_cast<int64_t>(ReadUint64(data, offset));
-    offset += 8;
+    msg.timestamp = static_cast<int64_t>(reader.ReadUint64());
 
     // addrRecv (26 bytes)
-    auto [addrRecv, recvBytes] = NetAddr::Deserialize(data, offset, false);
-    msg.addrRecv = addrRecv;
-    offset += recvBytes;
+    msg.addrRecv = NetAddr::Deserialize(reader, false);
 
     // addrFrom (26 bytes)
-    auto [addrFrom, fromBytes] = NetAddr::Deserialize(data, offset, false);
-    msg.addrFrom = addrFrom;
-    offset += fromBytes;
+    msg.addrFrom = NetAddr::Deserialize(reader, false);
 
     // nonce (8 bytes)
-    msg.nonce = ReadUint64(data, offset);
-    offset += 8;
+    msg.nonce = reader.ReadUint64();
 
     // userAgent (variable bytes)
-    if (offset >= data.size()) {
-        throw std::runtime_error("MessageVersion data truncated at user agent length");
-    }
-    uint8_t userAgentLen = data[offset];
-    offset += 1;
-
-    if (offset + userAgentLen > data.size()) {
-        throw std::runtime_error("MessageVersion data truncated at user agent");
-    }
-    msg.userAgent = std::string(data.begin() + offset, data.begin() + offset + userAgentLen);
-    offset += userAgentLen;
+    uint8_t userAgentLen = reader.ReadUint8();
+    std::span<const uint8_t> userAgent = reader.ReadBytes(userAgentLen);
+    msg.userAgent = std::string(userAgent.begin(), userAgent.end());
 
     // startHeight (4 bytes)
-    if (offset + 4 > data.size()) {
-        throw std::runtime_error("MessageVersion data truncated at start height");
-    }
-    msg.startHeight = static_cast<int32_t>(ReadUint32(data, offset));
-    offset += 4;
+    msg.startHeight = static_cast<int32_t>(reader.ReadUint32());
 
     // relay (1 byte)
-    if (offset >= data.size()) {
-        throw std::runtime_error("MessageVersion data truncated at relay flag");
-    }
-    msg.relay = data[offset] != 0x00;
+    msg.relay = reader.ReadUint8() != 0x00;
 
     return msg;
 }
\ No newline at end of file
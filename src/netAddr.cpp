@@ -1,11 +1,10 @@
 #include "netAddr.h"
 
+#include <algorithm>
 #include <ctime>
 #include <sstream>
 #include <stdexcept>
 
-#include "serialization.h"
-
 NetAddr::NetAddr(uint64_t services, const std::string& ipv4, uint16_t port)
     : time(0), services(services), port(port) {
     // parse IPv4 address string
@@ -33,66 +32,38 @@ NetAddr::NetAddr(uint64_t services, const std::string& ipv4, uint16_t port)
     std::copy(ipv4Bytes.begin(), ipv4Bytes.end(), ip.begin() + 12);
 }
 
-std::vector<uint8_t> NetAddr::Serialize(bool includeTime) const {
-    std::vector<uint8_t> result;
-
+void NetAddr::Serialize(ByteWriter& writer, bool includeTime) const {
     // only serialize time if includeTime is true
     if (includeTime) {
         // time (4 bytes)
-        WriteUint32(result, time);
+        writer.WriteUint32(time);
     }
 
     // services (8 bytes)
-    WriteUint64(result, services);
+    writer.WriteUint64(services);
 
     // IP address (16 bytes)
-    result.insert(result.end(), ip.begin(), ip.end());
+    writer.WriteBytes(ip);
 
     // port (2 bytes, big-endian for network byte order)
-    result.push_back((port >> 8) & 0xFF);
-    result.push_back(port & 0xFF);
-
-    return result;
+    writer.WriteUint16BE(port);
 }
 
-std::pair<NetAddr, size_t> NetAddr::Deserialize(const std::vector<uint8_t>& data, size_t offset,
-                                                bool includeTime) {
+NetAddr NetAddr::Deserialize(ByteReader& reader, bool includeTime) {
     NetAddr addr;
-    size_t startOffset = offset;
 
     // time (4 bytes)
-    if (includeTime) {
-        if (offset + 4 > data.size()) {
-            throw std::runtime_error("NetAddr data truncated at time");
-        }
-        addr.time = ReadUint32(data, offset);
-        offset += 4;
-    } else {
-        addr.time = 0;
-    }
+    addr.time = includeTime ? reader.ReadUint32() : 0;
 
     // services (8 bytes)
-    if (offset + 8 > data.size()) {
-        throw std::runtime_error("NetAddr data truncated at services");
-    }
-    addr.services = ReadUint64(data, offset);
-    offset += 8;
+    addr.services = reader.ReadUint64();
 
     // IP address (16 bytes)
-    if (offset + 16 > data.size()) {
-        throw std::runtime_error("NetAddr data truncated at IP");
-    }
-    std::copy(data.begin() + offset, data.begin() + offset + 16, addr.ip.begin());
-    offset += 16;
+    std::span<const uint8_t> ipBytes = reader.ReadBytes(addr.ip.size());
+    std::copy(ipBytes.begin(), ipBytes.end(), addr.ip.begin());
 
     // port (2 bytes, big-endian)
-    if (offset + 2 > data.size()) {
-        throw std::runtime_error("NetAddr data truncated at port");
-    }
-    addr.port =
-        (static_cast<uint16_t>(data[offset]) << 8) | static_cast<uint16_t>(data[offset + 1]);
-    offset += 2;
+    addr.port = reader.ReadUint16BE();
 
-    size_t bytesRead = offset - startOffset;
-    return {addr, bytesRead};
-}
+    return addr;
+}
\ No newline at end of file
@@ -1,23 +1,34 @@
 #include "node.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <iostream>
+#include <optional>
 #include <random>
-#include <set>
 #include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "addrManager.h"
 #include "blockchain.h"
-#include "blockchainIterator.h"
 #include "config.h"
+#include "merkleCache.h"
 #include "merkleTree.h"
 #include "message.h"
 #include "messageAddr.h"
+#include "messageCompactBlock.h"
 #include "messageGetBlocks.h"
 #include "messageInv.h"
 #include "messagePing.h"
 #include "messageVerack.h"
 #include "messageVersion.h"
+#include "outPoint.h"
 #include "overflow.h"
 #include "proofOfWork.h"
 #include "serialization.h"
@@ -28,14 +39,20 @@
 
 using json = nlohmann::json;
 
-Node::Node(const std::string& ip, uint16_t port, uint16_t rpcPort, const std::string& minerAddress)
+Node::Node(const std::string& ip, uint16_t port, uint16_t rpcPort, const std::string& minerAddress,
+           const BandwidthLimits& limits)
     : port(port),
       ip(ip),
       server(port),
       running(false),
       blockchainHeight(-1),
       rpcServer(rpcPort),
+      bandwidthLimits(limits),
+      nodeTraffic(limits.maxUpload, limits.maxDownload, limits.maxHistoricalUpload,
+                  MAX_NODE_MESSAGES_PER_SEC),
       minerAddress(minerAddress) {
+    mempool.SetFeeEstimator(&feeEstimator);
+
     // open persistent blockchain handle if the database exists
     if (Blockchain::DBExists()) {
         try {
@@ -73,13 +90,40 @@ bool Node::VerifyTransaction(const Transaction& tx) {
 void Node::RegisterRPCMethods() {
     rpcServer.RegisterMethod("getmempool", [this](const json&) -> json {
         auto ids = mempool.GetTransactionIDs();
+
+        // hex only at the RPC boundary
+        json txids = json::array();
+        for (const auto& id : ids) {
+            txids.push_back(id.ToHex());
+        }
+
         json result;
         result["size"] = ids.size();
-        result["transactions"] = std::move(ids);
+        result["transactions"] = std::move(txids);
 
         return result;
     });
 
+    rpcServer.RegisterMethod("getmempoolinfo", [this](const json&) -> json {
+        MempoolStats stats = mempool.GetStats();
+
+        json result;
+        result["size"] = stats.count;
+        result["bytes"] = stats.bytes;
+        result["minfeerate"] = stats.minFeeRate;
+        result["added"] = stats.added;
+        result["mined"] = stats.mined;
+        result["replaced"] = stats.replaced;
+        result["conflicted"] = stats.conflicted;
+        result["trimmed"] = stats.trimmed;
+        result["expired"] = stats.expired;
+        result["trims"] = stats.trims;
+        result["rejected"] = json{{"feeTooLow", stats.rejectedFeeTooLow},
+                                  {"conflict", stats.rejectedConflict},
+                                  {"tooLongChain", stats.rejectedTooLongChain}};
+        return result;
+    });
+
     rpcServer.RegisterMethod("getblockcount",
                              [this](const json&) -> json { return blockchainHeight.load(); });
 
@@ -111,28 +155,35 @@ void Node::RegisterRPCMethods() {
         Wallet* wallet = wallets.GetWallet(from);
         if (!wallet) throw std::runtime_error("Wallet not found for address: " + from);
 
+        // verify and admit under one lock, like HandleTx, so no block connects in between
         Transaction tx;
-        double feeRate = 0.0;
+        MempoolAddResult added;
         {
             std::lock_guard<std::mutex> lock(blockchainMutex);
             if (!blockchain) throw std::runtime_error("No blockchain available");
             UTXOSet utxoSet(blockchain.get());
             tx = Transaction::NewUTXOTransaction(wallet, blockchain.get(), to, amount, &utxoSet);
 
-            auto fee = blockchain->VerifyTransaction(&tx);
-            if (!fee) throw std::runtime_error("Transaction failed verification after signing");
+            auto verifiedFee = blockchain->VerifyTransaction(&tx);
+            if (!verifiedFee) {
+                throw std::runtime_error("Transaction failed verification after signing");
+            }
 
-            size_t txSize = tx.Serialize().size();
-            feeRate = txSize > 0 ? static_cast<double>(*fee) / static_cast<double>(txSize) : 0.0;
+            if (mempool.Contains(tx.GetID())) {
+                return json{{"txid", tx.GetID().ToHex()}, {"status", "already in mempool"}};
+            }
+            added = mempool.AddTransaction(tx, *verifiedFee);
         }
 
-        std::string txid = ByteArrayToHexString(tx.GetID());
+        std::string txid = tx.GetID().ToHex();
 
-        if (mempool.Contains(txid)) {
-            return json{{"txid", txid}, {"status", "already in mempool"}};
+        if (added == MempoolAddResult::Conflict) {
+            return json{{"error", "conflicts with mempool transactions it does not pay to replace"}};
         }
-
-        if (!mempool.AddTransaction(tx, feeRate)) {
+        if (added == MempoolAddResult::TooLongChain) {
+            return json{{"error", "too many unconfirmed ancestors or descendants"}};
+        }
+        if (added != MempoolAddResult::Added) {
             return json{{"error", "mempool full, fee rate too low"}};
         }
         minerCV.notify_one();
@@ -142,52 +193,96 @@ void Node::RegisterRPCMethods() {
         return json{{"txid", txid}};
     });
 
+    // fee rate a transaction should pay to confirm within the given number of blocks
+    rpcServer.RegisterMethod("estimatefee", [this](const json& params) -> json {
+        int32_t blocks = params.value("blocks", static_cast<int32_t>(6));
+        if (blocks < 1 || blocks > FEE_ESTIMATOR_MAX_TARGET) {
+            throw std::runtime_error("'blocks' must be between 1 and " +
+                                     std::to_string(FEE_ESTIMATOR_MAX_TARGET));
+        }
+
+        // with too little data for the target, fall back to the nearest longer one that has it
+        for (int32_t target = blocks; target <= FEE_ESTIMATOR_MAX_TARGET; target++) {
+            std::optional<double> feeRate = feeEstimator.EstimateFeeRate(target);
+            if (feeRate) return json{{"feerate", *feeRate}, {"blocks", target}};
+        }
+        return json{{"error", "not enough confirmed transactions to estimate a fee rate yet"},
+                    {"blocks", blocks}};
+    });
+
     // a lightweight (SPV) client can verify the proof without the full blockchain
     rpcServer.RegisterMethod("getmerkleproof", [this](const json& params) -> json {
         std::string txidHex = params.value("txid", "");
         if (txidHex.empty()) throw std::runtime_error("Missing 'txid' parameter");
 
-        std::vector<uint8_t> txid = HexStringToByteArray(txidHex);
+        Hash256 txid = Hash256::FromHex(txidHex);
 
         std::lock_guard<std::mutex> lock(blockchainMutex);
         if (!blockchain) throw std::runtime_error("No blockchain available");
 
-        // scan newest to oldest
-        BlockchainIterator bci = blockchain->Iterator();
+        std::optional<TxLocation> location = merkleCache.FindTransaction(*blockchain, txid);
+        if (!location) throw std::runtime_error("Transaction not found: " + txidHex);
 
-        while (bci.hasNext()) {
-            Block block = bci.Next();
-            const auto& txs = block.GetTransactions();
+        auto cached = merkleCache.GetTree(*blockchain, location->blockHash);
+        MerkleProof proof = cached->tree.GenerateProof(location->index);
+        proof.txid = txid;
+        proof.blockHash = cached->blockHash;
+        proof.blockHeight = static_cast<uint32_t>(cached->blockHeight);
 
-            for (uint32_t i = 0; i < static_cast<uint32_t>(txs.size()); i++) {
-                if (txs[i].GetID() != txid) {
-                    continue;
-                }
+        json path = json::array();
+        for (const auto& step : proof.path) {
+            path.push_back({{"hash", step.hash.ToHex()}, {"isLeft", step.isLeft}});
+        }
 
-                MerkleTree tree(txs);
-                MerkleProof proof = tree.GenerateProof(i);
-                proof.txid = txid;
-                proof.blockHash = block.GetHash();
-                proof.blockHeight =
-                    static_cast<uint32_t>(blockchain->GetBlockHeight(block.GetHash()));
-
-                json path = json::array();
-                for (const auto& step : proof.path) {
-                    path.push_back(
-                        {{"hash", ByteArrayToHexString(step.hash)}, {"isLeft", step.isLeft}});
-                }
+        return json{{"txid", txidHex},
+                    {"txHash", proof.txHash.ToHex()},
+                    {"txIndex", proof.txIndex},
+                    {"blockHash", proof.blockHash.ToHex()},
+                    {"blockHeight", proof.blockHeight},
+                    {"merkleRoot", proof.merkleRoot.ToHex()},
+                    {"path", path}};
+    });
 
-                return json{{"txid", txidHex},
-                            {"txHash", ByteArrayToHexString(proof.txHash)},
-                            {"txIndex", proof.txIndex},
-                            {"blockHash", ByteArrayToHexString(proof.blockHash)},
-                            {"blockHeight", proof.blockHeight},
-                            {"merkleRoot", ByteArrayToHexString(proof.merkleRoot)},
-                            {"path", path}};
-            }
+    // one multiproof per block for a batch of txids, siblings shared between them are sent once
+    rpcServer.RegisterMethod("getmerkleproofs", [this](const json& params) -> json {
+        if (!params.contains("txids") || !params["txids"].is_array() || params["txids"].empty()) {
+            throw std::runtime_error("Missing 'txids' parameter");
+        }
+
+        std::lock_guard<std::mutex> lock(blockchainMutex);
+        if (!blockchain) throw std::runtime_error("No blockchain available");
+
+        // group the requested transactions by block, keeping the order blocks were first seen
+        std::vector<std::pair<Hash256, std::vector<uint32_t>>> blocks;
+        std::unordered_map<Hash256, size_t> blockSlots;
+        for (const auto& txidJson : params["txids"]) {
+            std::string txidHex = txidJson.get<std::string>();
+            std::optional<TxLocation> location =
+                merkleCache.FindTransaction(*blockchain, Hash256::FromHex(txidHex));
+            if (!location) throw std::runtime_error("Transaction not found: " + txidHex);
+
+            auto [it, inserted] = blockSlots.try_emplace(location->blockHash, blocks.size());
+            if (inserted) blocks.push_back({location->blockHash, {}});
+            blocks[it->second].second.push_back(location->index);
+        }
+
+        json proofs = json::array();
+        for (const auto& [blockHash, txIndices] : blocks) {
+            auto cached = merkleCache.GetTree(*blockchain, blockHash);
+            MerkleMultiProof proof = cached->tree.GenerateMultiProof(txIndices);
+
+            json hashes = json::array();
+            for (const Hash256& hash : proof.hashes) hashes.push_back(hash.ToHex());
+
+            proofs.push_back({{"blockHash", cached->blockHash.ToHex()},
+                              {"blockHeight", cached->blockHeight},
+                              {"merkleRoot", proof.merkleRoot.ToHex()},
+                              {"txCount", proof.txCount},
+                              {"hashes", hashes},
+                              {"flags", ByteArrayToHexString(proof.flags)}});
         }
 
-        throw std::runtime_error("Transaction not found: " + txidHex);
+        return json{{"proofs", proofs}};
     });
 
     // mine one block from the current mempool on demand
@@ -201,7 +296,7 @@ void Node::RegisterRPCMethods() {
         std::string tipHash;
         {
             std::lock_guard<std::mutex> lock(blockchainMutex);
-            if (blockchain) tipHash = ByteArrayToHexString(blockchain->GetTip());
+            if (blockchain) tipHash = blockchain->GetTip().ToHex();
         }
 
         return json{{"hash", tipHash}, {"height", blockchainHeight.load()}};
@@ -237,6 +332,10 @@ void Node::RegisterRPCMethods() {
                 peerInfo["useragent"] = peerState->userAgent;
                 peerInfo["services"] = peerState->services;
 
+                TrafficTotals traffic = peerState->traffic.GetTotals();
+                peerInfo["bytessent"] = traffic.bytesSent;
+                peerInfo["bytesrecv"] = traffic.bytesReceived;
+
                 peersArray.push_back(std::move(peerInfo));
             }
         }
@@ -245,18 +344,132 @@ void Node::RegisterRPCMethods() {
         result["inbound"] = inbound;
         result["outbound"] = outbound;
         result["address_book_size"] = addrManager.Size();
+
+        TrafficTotals traffic = nodeTraffic.GetTotals();
+        result["totalbytessent"] = traffic.bytesSent;
+        result["totalbytesrecv"] = traffic.bytesReceived;
         result["peers"] = std::move(peersArray);
 
         return result;
     });
 }
 
+void Node::Send(PeerState& peerState, const Message& msg) {
+    Send(peerState, msg, ClassifyCommand(msg.GetCommandString()));
+}
+
+void Node::Send(PeerState& peerState, const Message& msg, TrafficClass trafficClass) {
+    peerState.peer->SendMessage(msg);
+    peerState.traffic.ChargeUpload(msg.GetSerializedSize(), trafficClass);
+    nodeTraffic.ChargeUpload(msg.GetSerializedSize(), trafficClass);
+}
+
+void Node::QueueSend(PeerState& peerState, const Message& msg) {
+    {
+        std::lock_guard<std::mutex> lock(peerState.sendQueueMutex);
+        peerState.sendQueue.emplace_back(msg, ClassifyCommand(msg.GetCommandString()));
+    }
+    WakeWriter();
+}
+
+void Node::WakeWriter() {
+    // a full pipe already has the writer awake
+    if (writerWake[1] >= 0) {
+        uint8_t byte = 0;
+        [[maybe_unused]] ssize_t n = write(writerWake[1], &byte, 1);
+    }
+}
+
+FlushResult Node::DrainSendQueue(PeerState& peerState) {
+    FlushResult result;
+    while ((result = peerState.peer->FlushPending()) == FlushResult::Flushed) {
+        std::pair<Message, TrafficClass> next;
+        {
+            std::lock_guard<std::mutex> lock(peerState.sendQueueMutex);
+            if (peerState.sendQueue.empty()) return FlushResult::Flushed;
+            next = std::move(peerState.sendQueue.front());
+            peerState.sendQueue.pop_front();
+        }
+
+        peerState.peer->QueueMessage(next.first);
+        peerState.traffic.ChargeUpload(next.first.GetSerializedSize(), next.second);
+        nodeTraffic.ChargeUpload(next.first.GetSerializedSize(), next.second);
+    }
+    return result;
+}
+
+void Node::RunWriter(std::stop_token stoken) {
+    std::vector<pollfd> fds;
+    while (!stoken.stop_requested()) {
+        std::vector<std::shared_ptr<PeerState>> peersSnapshot;
+        {
+            std::lock_guard<std::mutex> lock(peersMutex);
+            peersSnapshot = peers;
+        }
+
+        // the sockets still full after a round wait in poll, the wake pipe for new messages
+        fds.assign(1, pollfd{writerWake[0], POLLIN, 0});
+        bool senderBusy = false;
+        for (const auto& peerState : peersSnapshot) {
+            if (!peerState->peer->IsConnected()) continue;
+            try {
+                FlushResult result = DrainSendQueue(*peerState);
+                if (result == FlushResult::SocketFull) {
+                    fds.push_back(pollfd{peerState->peer->GetSocket(), POLLOUT, 0});
+                } else if (result == FlushResult::SenderBusy) {
+                    senderBusy = true;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "[node] Failed to send to " << peerState->peer->GetRemoteAddress()
+                          << ": " << e.what() << std::endl;
+                // wakes the reader, which winds the peer down
+                peerState->peer->Disconnect();
+            }
+        }
+
+        // a peer that stays full is looked at every second for its send timeout, one whose
+        // reader is sending is retried shortly, poll can't tell when that send is done
+        int timeoutMs = senderBusy ? WRITER_RETRY_MS : fds.size() > 1 ? 1000 : -1;
+        if (poll(fds.data(), fds.size(), timeoutMs) < 0 && errno != EINTR) {
+            std::cerr << "[node] Writer poll failed, errno " << errno << std::endl;
+            return;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint8_t buffer[64];
+            while (read(writerWake[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+    }
+}
+
+std::chrono::steady_clock::duration Node::UploadDelay(PeerState& peerState,
+                                                      TrafficClass trafficClass) {
+    return std::max(peerState.traffic.UploadDelay(trafficClass),
+                    nodeTraffic.UploadDelay(trafficClass));
+}
+
+void Node::WaitForUpload(PeerState& peerState, TrafficClass trafficClass) {
+    WaitForBudget(peerState, [&] { return UploadDelay(peerState, trafficClass); });
+}
+
+void Node::WaitForBudget(PeerState& peerState,
+                         const std::function<std::chrono::steady_clock::duration()>& delay) {
+    auto remaining = delay();
+    while (remaining > std::chrono::steady_clock::duration::zero() && running &&
+           peerState.peer->IsConnected()) {
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+            remaining, std::chrono::milliseconds(INV_FLUSH_INTERVAL_MS)));
+        remaining = delay();
+    }
+}
+
 void Node::SendVersion(PeerState& peerState) {
     MessageVersion version(peerState.peer->GetRemoteIP(), peerState.peer->GetRemotePort(), ip, port,
                            blockchainHeight, true);
 
     Message msg(MAGIC_CUSTOM, CMD_VERSION, version.Serialize());
-    peerState.peer->SendMessage(msg);
+    Send(peerState, msg);
     peerState.versionSent = true;
 
     std::cout << "[node] Sent version (height=" << blockchainHeight << ") to "
@@ -283,7 +496,7 @@ void Node::HandleVersion(PeerState& peerState, const std::vector<uint8_t>& paylo
     }
 
     // acknowledge their version
-    peerState.peer->SendMessage(CreateVerackMessage());
+    Send(peerState, CreateVerackMessage());
     std::cout << "[node] Sent verack to " << peerState.peer->GetRemoteAddress() << std::endl;
 
     // compare heights and initiate sync if behind
@@ -309,7 +522,7 @@ void Node::HandleVersion(PeerState& peerState, const std::vector<uint8_t>& paylo
             }
 
             if (shouldSync) {
-                peerState.peer->SendMessage(getBlocksMsg);
+                Send(peerState, getBlocksMsg);
                 std::cout << "[node] Sent getblocks to " << peerState.peer->GetRemoteAddress()
                           << std::endl;
             }
@@ -331,7 +544,7 @@ void Node::HandleVerack(PeerState& peerState) {
 
     // we ask the peer for addresses it knows about
     try {
-        peerState.peer->SendMessage(CreateGetAddrMessage());
+        Send(peerState, CreateGetAddrMessage());
         std::cout << "[node] Sent getaddr to " << peerState.peer->GetRemoteAddress() << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "[node] Failed to send getaddr to " << peerState.peer->GetRemoteAddress()
@@ -345,7 +558,7 @@ void Node::HandleVerack(PeerState& peerState) {
     // only add if the peer advertised a valid listening port
     // note: it's also checked in the addrmanager
     if (peerAddr.port != 0) {
-        addrManager.Add(peerAddr);
+        addrManager.Add(peerAddr, ExtractIP(peerState.peer->GetRemoteAddress()));
         GossipAddr(peerAddr, peerState.peer->GetRemoteAddress());
     }
 }
@@ -355,7 +568,7 @@ void Node::HandlePing(PeerState& peerState, const std::vector<uint8_t>& payload)
 
     // immediately echo back the nonce in a pong
     Message pong = CreatePongMessage(ping.GetNonce());
-    peerState.peer->SendMessage(pong);
+    Send(peerState, pong);
 
     std::cout << "[node] Replied pong to " << peerState.peer->GetRemoteAddress() << std::endl;
 }
@@ -363,13 +576,28 @@ void Node::HandlePing(PeerState& peerState, const std::vector<uint8_t>& payload)
 void Node::HandlePong(PeerState& peerState, const std::vector<uint8_t>& payload) {
     MessagePong pong = MessagePong::Deserialize(payload);
 
-    // signal the monitor thread that a pong was received
     {
-        std::lock_guard<std::mutex> lock(peerState.pongMutex);
-        peerState.pongNonce = pong.GetNonce();
-        peerState.pongReceived = true;
+        std::unique_lock<std::mutex> lock(peerState.pingMutex);
+
+        // unsolicited, or the answer to a ping that already timed out
+        if (!peerState.pingPending) return;
+
+        if (pong.GetNonce() != peerState.pingNonce) {
+            std::cerr << "[node] Nonce mismatch from " << peerState.peer->GetRemoteAddress()
+                      << ": expected " << peerState.pingNonce << ", got " << pong.GetNonce()
+                      << " -- disconnecting" << std::endl;
+            lock.unlock();
+            DisconnectPeer(peerState.peer->GetRemoteAddress());
+            return;
+        }
+
+        // the deadline is replaced by the next ping
+        peerState.pingPending = false;
+        timers.Cancel(peerState.pingTimer);
+        SchedulePing(peerState);
     }
-    peerState.pongCV.notify_one();
+
+    std::cout << "[node] Got pong from " << peerState.peer->GetRemoteAddress() << std::endl;
 }
 
 void Node::HandleInv(PeerState& peerState, const std::vector<uint8_t>& payload) {
@@ -378,38 +606,47 @@ void Node::HandleInv(PeerState& peerState, const std::vector<uint8_t>& payload)
     std::cout << "[node] Received inv with " << +inv.GetCount() << " items from "
               << peerState.peer->GetRemoteAddress() << std::endl;
 
+    // whatever it announces it has, no need to announce back
+    {
+        std::lock_guard<std::mutex> lock(peerState.invMutex);
+        for (const auto& item : inv.GetInventory()) peerState.knownInventory.Insert(item.hash);
+    }
+
     // only request objects we don't already have
-    std::vector<InvVector> toRequest;
-    toRequest.reserve(inv.GetInventory().size());
+    std::vector<InvVector> wanted;
+    wanted.reserve(inv.GetInventory().size());
 
+    std::vector<InvVector> blocks;
     for (const auto& item : inv.GetInventory()) {
-        // if item is a transaction, check if we already have it
-        if (item.type == InvType::Tx) {
-            std::string txid = ByteArrayToHexString(item.hash);
-            // check if we already have it
-            if (!mempool.Contains(txid)) {
-                toRequest.push_back(item);
-            } else {
-                std::cout << "[node] Already have tx " << txid.substr(0, 16) << "..., skipping"
-                          << std::endl;
-            }
+        if (item.type == InvType::Block) {
+            blocks.push_back(item);
+        } else if (!mempool.Contains(item.hash) && !orphanPool.Contains(item.hash)) {
+            wanted.push_back(item);
+        } else {
+            std::cout << "[node] Already have tx " << item.hash.ToHex().substr(0, 16)
+                      << "..., skipping" << std::endl;
         }
-        // if item is a block, add it to the request list without checking if we already have it
-        else {
-            toRequest.push_back(item);
+    }
+
+    if (!blocks.empty()) {
+        std::lock_guard<std::mutex> lock(blockchainMutex);
+        if (!blockchain) return;
+        for (const auto& item : blocks) {
+            if (blockchain->GetBlockHeight(item.hash) < 0) wanted.push_back(item);
         }
     }
 
+    // what another peer is already sending us is only remembered as a fallback
+    std::vector<InvVector> toRequest =
+        requestTracker.Announce(peerState.peer->GetRemoteAddress(), wanted);
     if (toRequest.empty()) {
         return;
     }
 
-    MessageGetData getData(toRequest);
-    Message msg(MAGIC_CUSTOM, CMD_GETDATA, getData.Serialize());
-    peerState.peer->SendMessage(msg);
+    SendGetData(peerState, toRequest);
 
-    std::cout << "[node] Sent getdata for " << +getData.GetCount() << " items to "
-              << peerState.peer->GetRemoteAddress() << std::endl;
+    std::cout << "[node] Sent getdata for " << toRequest.size() << " of " << wanted.size()
+              << " wanted items to " << peerState.peer->GetRemoteAddress() << std::endl;
 }
 
 void Node::HandleGetBlocks(PeerState& peerState, const std::vector<uint8_t>& payload) {
@@ -417,7 +654,7 @@ void Node::HandleGetBlocks(PeerState& peerState, const std::vector<uint8_t>& pay
         MessageGetBlocks getBlocks = MessageGetBlocks::Deserialize(payload);
 
         // gather hashes under lock
-        std::vector<std::vector<uint8_t>> hashes;
+        std::vector<Hash256> hashes;
         bool noCommonAncestor = false;
         {
             std::lock_guard<std::mutex> lock(blockchainMutex);
@@ -437,7 +674,7 @@ void Node::HandleGetBlocks(PeerState& peerState, const std::vector<uint8_t>& pay
 
         if (hashes.empty()) {
             if (noCommonAncestor) {
-                std::string peerTip = ByteArrayToHexString(getBlocks.GetTipHash()).substr(0, 16);
+                std::string peerTip = getBlocks.GetTipHash().ToHex().substr(0, 16);
                 std::cerr << "[node] No common ancestor with " << peerState.peer->GetRemoteAddress()
                           << " (their tip: " << peerTip << "...)" << std::endl;
             } else {
@@ -456,7 +693,8 @@ void Node::HandleGetBlocks(PeerState& peerState, const std::vector<uint8_t>& pay
 
         MessageInv inv(inventory);
         Message msg(MAGIC_CUSTOM, CMD_INV, inv.Serialize());
-        peerState.peer->SendMessage(msg);
+        WaitForUpload(peerState, TrafficClass::Other);
+        Send(peerState, msg);
 
         std::cout << "[node] Sent inv with " << hashes.size() << " block hashes to "
                   << peerState.peer->GetRemoteAddress() << std::endl;
@@ -474,8 +712,8 @@ void Node::HandleGetData(PeerState& peerState, const std::vector<uint8_t>& paylo
                   << peerState.peer->GetRemoteAddress() << std::endl;
 
         // separate requested items by type
-        std::vector<std::vector<uint8_t>> blockHashes;
-        std::vector<std::vector<uint8_t>> txHashes;
+        std::vector<Hash256> blockHashes;
+        std::vector<Hash256> txHashes;
 
         for (const auto& inv : getData.GetInventory()) {
             if (inv.type == InvType::Block) {
@@ -486,39 +724,50 @@ void Node::HandleGetData(PeerState& peerState, const std::vector<uint8_t>& paylo
         }
 
         // gather all requested blocks under one lock, send outside
-        std::vector<Block> blocksToSend;
+        // blocks deep below the tip are for a syncing peer and wait for the historical budget,
+        // recent ones are relay
+        std::vector<std::pair<Block, TrafficClass>> blocksToSend;
         {
             std::lock_guard<std::mutex> lock(blockchainMutex);
             if (blockchain) {
+                int32_t tipHeight = blockchain->GetChainHeight();
                 blocksToSend.reserve(blockHashes.size());
                 for (const auto& hash : blockHashes) {
                     try {
-                        blocksToSend.push_back(blockchain->GetBlock(hash));
+                        Block block = blockchain->GetBlock(hash);
+                        int32_t depth = tipHeight - blockchain->GetBlockHeight(hash);
+                        TrafficClass trafficClass = depth >= HISTORICAL_BLOCK_DEPTH
+                                                        ? TrafficClass::Historical
+                                                        : TrafficClass::Block;
+                        blocksToSend.emplace_back(std::move(block), trafficClass);
                     } catch (const std::exception&) {
                         std::cerr << "[node] Block not found: "
-                                  << ByteArrayToHexString(hash).substr(0, 16) << "..." << std::endl;
+                                  << hash.ToHex().substr(0, 16) << "..." << std::endl;
                     }
                 }
             }
         }
 
-        for (const auto& block : blocksToSend) {
+        for (const auto& [block, trafficClass] : blocksToSend) {
+            WaitForUpload(peerState, trafficClass);
             Message msg(MAGIC_CUSTOM, CMD_BLOCK, block.Serialize());
-            peerState.peer->SendMessage(msg);
+            Send(peerState, msg, trafficClass);
+            MarkKnown(peerState, block.GetHash());
 
-            std::cout << "[node] Sent block " << ByteArrayToHexString(block.GetHash()).substr(0, 16)
+            std::cout << "[node] Sent block " << block.GetHash().ToHex().substr(0, 16)
                       << "... to " << peerState.peer->GetRemoteAddress() << std::endl;
         }
 
         // look up each transaction individually
         for (const auto& hash : txHashes) {
-            std::string txid = ByteArrayToHexString(hash);
-            auto tx = mempool.FindTransaction(txid);
+            auto tx = mempool.FindTransaction(hash);
             if (tx) {
+                WaitForUpload(peerState, TrafficClass::Other);
                 Message msg(MAGIC_CUSTOM, CMD_TX, tx->Serialize());
-                peerState.peer->SendMessage(msg);
+                Send(peerState, msg);
+                MarkKnown(peerState, hash);
 
-                std::cout << "[node] Sent tx " << txid.substr(0, 16) << "... to "
+                std::cout << "[node] Sent tx " << hash.ToHex().substr(0, 16) << "... to "
                           << peerState.peer->GetRemoteAddress() << std::endl;
             }
         }
@@ -531,13 +780,15 @@ void Node::HandleGetData(PeerState& peerState, const std::vector<uint8_t>& paylo
 void Node::HandleTx(PeerState& peerState, const std::vector<uint8_t>& payload) {
     try {
         Transaction tx = Transaction::Deserialize(payload);
-        std::string txid = ByteArrayToHexString(tx.GetID());
+        std::string txid = tx.GetID().ToHex();
 
         std::cout << "[node] Received transaction " << txid << " from "
                   << peerState.peer->GetRemoteAddress() << std::endl;
+        MarkKnown(peerState, tx.GetID());
+        requestTracker.Received(tx.GetID());
 
-        // ignore transactions already in the mempool
-        if (mempool.Contains(txid)) {
+        // ignore transactions already in the mempool or waiting on a parent
+        if (mempool.Contains(tx.GetID()) || orphanPool.Contains(tx.GetID())) {
             std::cout << "[node] Already have tx " << txid.substr(0, 16) << "..., ignoring"
                       << std::endl;
             return;
@@ -549,55 +800,160 @@ void Node::HandleTx(PeerState& peerState, const std::vector<uint8_t>& payload) {
             return;
         }
 
-        // consensus validation: full signature and structural verification against previous outputs
-        double feeRate = 0.0;
-        if (!tx.IsCoinbase()) {
+        // consensus validation: full signature and structural verification against previous
+        // outputs, which may still be unconfirmed in our mempool
+        // admission stays under the same lock, so the mempool parents the tx was verified
+        // against can't be evicted or mined before it joins them
+        std::string peerAddr = peerState.peer->GetRemoteAddress();
+        std::vector<Hash256> missingParents;
+        std::vector<std::pair<Transaction, std::string>> acceptedOrphans;
+        {
             std::lock_guard<std::mutex> lock(blockchainMutex);
-            if (!blockchain) {
-                std::cerr << "[node] Rejected tx " << txid << ": no blockchain available"
-                          << std::endl;
-                return;
-            }
-            try {
-                auto fee = blockchain->VerifyTransaction(&tx);
-                if (!fee) {
-                    Misbehave(peerState, 10, "invalid transaction " + txid);
+            int64_t fee = 0;
+            double feeRate = 0.0;
+            if (!tx.IsCoinbase()) {
+                if (!blockchain) {
+                    std::cerr << "[node] Rejected tx " << txid << ": no blockchain available"
+                              << std::endl;
                     return;
                 }
-                size_t txSize = tx.Serialize().size();
-                feeRate =
-                    txSize > 0 ? static_cast<double>(*fee) / static_cast<double>(txSize) : 0.0;
-            } catch (const std::exception& e) {
-                std::cerr << "[node] Rejected transaction " << txid << ": " << e.what()
-                          << std::endl;
-                return;
+                try {
+                    auto verifiedFee =
+                        blockchain->VerifyTransaction(&tx, mempool.GetParentTransactions(tx));
+                    if (!verifiedFee) {
+                        Misbehave(peerState, 10, "invalid transaction " + txid);
+                        return;
+                    }
+                    fee = *verifiedFee;
+                    size_t txSize = tx.SerializedSize();
+                    feeRate =
+                        txSize > 0 ? static_cast<double>(fee) / static_cast<double>(txSize) : 0.0;
+                } catch (const std::exception& e) {
+                    // relay can reorder a parent and its child, hold the child until the
+                    // parent shows up
+                    missingParents = FindMissingParents(tx);
+                    if (missingParents.empty()) {
+                        std::cerr << "[node] Rejected transaction " << txid << ": " << e.what()
+                                  << std::endl;
+                        return;
+                    }
+                }
             }
-        }
 
-        if (feeRate < Policy::MIN_RELAY_FEE_RATE) {
-            std::cerr << "[node] Rejected transaction " << txid << ": fee rate " << feeRate
-                      << " < minimum " << Policy::MIN_RELAY_FEE_RATE << std::endl;
-            return;
+            if (!missingParents.empty()) {
+                if (!orphanPool.Add(tx, peerAddr, missingParents)) {
+                    std::cerr << "[node] Dropped orphan transaction " << txid << " from "
+                              << peerAddr << std::endl;
+                    return;
+                }
+                std::cout << "[node] Holding orphan tx " << txid.substr(0, 16) << "..., "
+                          << missingParents.size() << " missing parent(s), "
+                          << orphanPool.Size() << " orphans" << std::endl;
+            } else {
+                if (feeRate < Policy::MIN_RELAY_FEE_RATE) {
+                    std::cerr << "[node] Rejected transaction " << txid << ": fee rate "
+                              << feeRate << " < minimum " << Policy::MIN_RELAY_FEE_RATE
+                              << std::endl;
+                    return;
+                }
+
+                if (mempool.AddTransaction(tx, fee) != MempoolAddResult::Added) {
+                    return;
+                }
+
+                acceptedOrphans = ProcessOrphans({tx.GetID()});
+            }
         }
 
-        if (!mempool.AddTransaction(tx, feeRate)) {
+        if (!missingParents.empty()) {
+            // ask the sender for the parents it must have had, unless they are orphans too
+            std::vector<InvVector> wanted;
+            for (const auto& parent : missingParents) {
+                if (!orphanPool.Contains(parent)) wanted.push_back({InvType::Tx, parent});
+            }
+            std::vector<InvVector> toRequest = requestTracker.Announce(peerAddr, wanted);
+            if (!toRequest.empty()) SendGetData(peerState, toRequest);
             return;
         }
         minerCV.notify_one();
 
         // flood the inventory to all other peers
-        RelayTransaction(tx, peerState.peer->GetRemoteAddress());
+        RelayTransaction(tx, peerAddr);
+        for (const auto& [orphan, fromPeer] : acceptedOrphans) {
+            RelayTransaction(orphan, fromPeer);
+        }
     } catch (const std::exception& e) {
         std::cerr << "[node] Failed to deserialize tx from " << peerState.peer->GetRemoteAddress()
                   << ": " << e.what() << std::endl;
     }
 }
 
+std::vector<Hash256> Node::FindMissingParents(const Transaction& tx) {
+    std::vector<Hash256> missing;
+    UTXOSet utxoSet(blockchain.get());
+    for (const auto& vin : tx.GetVin()) {
+        const Hash256& parent = vin.GetTxid();
+        if (std::find(missing.begin(), missing.end(), parent) != missing.end()) continue;
+        if (mempool.Contains(parent)) continue;
+        if (utxoSet.IsUnspent(vin.GetPrevOut())) continue;
+        missing.push_back(parent);
+    }
+    return missing;
+}
+
+std::vector<std::pair<Transaction, std::string>> Node::ProcessOrphans(
+    std::vector<Hash256> parents) {
+    std::vector<std::pair<Transaction, std::string>> accepted;
+
+    // an accepted orphan is appended to parents, so its own orphans are picked up in turn
+    for (size_t next = 0; next < parents.size();) {
+        std::vector<Hash256> batch(parents.begin() + static_cast<std::ptrdiff_t>(next),
+                                   parents.end());
+        next = parents.size();
+
+        for (const OrphanEntry& orphan : orphanPool.GetChildren(batch)) {
+            const Transaction& tx = orphan.tx;
+            Hash256 txid = tx.GetID();
+
+            std::optional<int64_t> fee;
+            try {
+                fee = blockchain->VerifyTransaction(&tx, mempool.GetParentTransactions(tx));
+            } catch (const std::exception&) {
+                // keep waiting while another parent is still missing
+                if (!FindMissingParents(tx).empty()) continue;
+            }
+            orphanPool.Erase(txid);
+
+            size_t txSize = tx.SerializedSize();
+            double feeRate =
+                fee && txSize > 0 ? static_cast<double>(*fee) / static_cast<double>(txSize) : 0.0;
+            if (!fee || feeRate < Policy::MIN_RELAY_FEE_RATE) {
+                std::cerr << "[node] Rejected orphan transaction " << txid.ToHex() << std::endl;
+                continue;
+            }
+            if (mempool.AddTransaction(tx, *fee) != MempoolAddResult::Added) continue;
+
+            std::cout << "[node] Accepted orphan tx " << txid.ToHex().substr(0, 16) << "..."
+                      << std::endl;
+            accepted.push_back({tx, orphan.fromPeer});
+            parents.push_back(txid);
+        }
+    }
+
+    return accepted;
+}
+
 void Node::QueueInv(PeerState& peerState, const InvVector& inv) {
     std::lock_guard<std::mutex> lock(peerState.invMutex);
+    if (peerState.knownInventory.Contains(inv.hash)) return;
     peerState.pendingInv.push_back(inv);
 }
 
+void Node::MarkKnown(PeerState& peerState, const Hash256& hash) {
+    std::lock_guard<std::mutex> lock(peerState.invMutex);
+    peerState.knownInventory.Insert(hash);
+}
+
 void Node::RelayTransaction(const Transaction& tx, const std::string& sourcePeerAddr) {
     InvVector invVec{InvType::Tx, tx.GetID()};
 
@@ -611,57 +967,71 @@ void Node::RelayTransaction(const Transaction& tx, const std::string& sourcePeer
     }
 }
 
-void Node::RunInvFlushLoop(std::stop_token stoken) {
-    while (!stoken.stop_requested()) {
-        {
-            std::unique_lock<std::mutex> lock(invFlushCVMtx);
-            invFlushCV.wait_for(lock, std::chrono::milliseconds(INV_FLUSH_INTERVAL_MS),
-                                [&] { return stoken.stop_requested(); });
-        }
+void Node::FlushInv() {
+    // take a snapshot of peers under peersMutex
+    std::vector<std::shared_ptr<PeerState>> peersSnapshot;
+    {
+        std::lock_guard<std::mutex> lock(peersMutex);
+        peersSnapshot = peers;
+    }
 
-        if (stoken.stop_requested()) break;
+    for (const auto& peerState : peersSnapshot) {
+        if (!peerState->peer->IsConnected() || !peerState->handshakeComplete) continue;
 
-        // take a snapshot of peers under peersMutex
-        std::vector<std::shared_ptr<PeerState>> peersSnapshot;
-        {
-            std::lock_guard<std::mutex> lock(peersMutex);
-            peersSnapshot = peers;
+        // out of upload budget, the items stay queued for a later flush
+        if (UploadDelay(*peerState, TrafficClass::Other) >
+            std::chrono::steady_clock::duration::zero()) {
+            continue;
         }
 
-        for (const auto& peerState : peersSnapshot) {
-            if (!peerState->peer->IsConnected() || !peerState->handshakeComplete) continue;
+        // so is the writer still working through the last flush, a slow peer doesn't pile up
+        // a backlog of announcements
+        {
+            std::lock_guard<std::mutex> lock(peerState->sendQueueMutex);
+            if (!peerState->sendQueue.empty()) continue;
+        }
 
-            // drain the pending inv buffer
-            std::vector<InvVector> batch;
-            {
-                std::lock_guard<std::mutex> lock(peerState->invMutex);
-                if (peerState->pendingInv.empty()) continue;
-                batch.swap(peerState->pendingInv);
+        // drain the pending inv buffer, dropping what the peer announced to us since it was
+        // queued and remembering the rest as known to it
+        std::vector<InvVector> batch;
+        {
+            std::lock_guard<std::mutex> lock(peerState->invMutex);
+            if (peerState->pendingInv.empty()) continue;
+            batch.reserve(peerState->pendingInv.size());
+            for (const auto& inv : peerState->pendingInv) {
+                if (peerState->knownInventory.Contains(inv.hash)) continue;
+                peerState->knownInventory.Insert(inv.hash);
+                batch.push_back(inv);
             }
+            peerState->pendingInv.clear();
+        }
+        if (batch.empty()) continue;
 
-            // send in chunks of MAX_INV_BATCH_SIZE
-            for (size_t i = 0; i < batch.size(); i += MAX_INV_BATCH_SIZE) {
-                size_t end = std::min(i + MAX_INV_BATCH_SIZE, batch.size());
-                std::vector<InvVector> chunk(batch.begin() + i, batch.begin() + end);
-
-                MessageInv invMsg(chunk);
-                Message msg(MAGIC_CUSTOM, CMD_INV, invMsg.Serialize());
+        // send in chunks of MAX_INV_BATCH_SIZE
+        for (size_t i = 0; i < batch.size(); i += MAX_INV_BATCH_SIZE) {
+            size_t end = std::min(i + MAX_INV_BATCH_SIZE, batch.size());
+            std::vector<InvVector> chunk(batch.begin() + i, batch.begin() + end);
 
-                try {
-                    peerState->peer->SendMessage(msg);
-                } catch (const std::exception& e) {
-                    std::cerr << "[node] Failed to flush inv batch to "
-                              << peerState->peer->GetRemoteAddress() << ": " << e.what()
-                              << std::endl;
-                    break;
-                }
-            }
+            MessageInv invMsg(chunk);
+            QueueSend(*peerState, Message(MAGIC_CUSTOM, CMD_INV, invMsg.Serialize()));
         }
     }
+
+    // requests that timed out at another peer or were waiting for a free slot
+    // one addressed to a peer that is gone times out again and moves on
+    RequestBatches batches = requestTracker.Dispatch();
+    for (const auto& peerState : peersSnapshot) {
+        auto it = batches.find(peerState->peer->GetRemoteAddress());
+        if (it == batches.end() || !peerState->peer->IsConnected()) continue;
+
+        SendGetData(*peerState, it->second);
+        std::cout << "[node] Queued getdata for " << it->second.size() << " items to " << it->first
+                  << " (" << requestTracker.Size() << " tracked)" << std::endl;
+    }
 }
 
 void Node::BroadcastTransaction(const Transaction& tx) {
-    std::string txid = ByteArrayToHexString(tx.GetID());
+    std::string txid = tx.GetID().ToHex();
 
     if (!VerifyTransaction(tx)) {
         std::cerr << "[node] BroadcastTransaction: rejected invalid transaction " << txid
@@ -669,165 +1039,375 @@ void Node::BroadcastTransaction(const Transaction& tx) {
         return;
     }
 
-    if (!mempool.Contains(txid)) {
-        double feeRate = 0.0;
+    std::vector<std::pair<Transaction, std::string>> acceptedOrphans;
+    if (!mempool.Contains(tx.GetID())) {
+        // verify and admit under one lock, like HandleTx
+        std::lock_guard<std::mutex> lock(blockchainMutex);
+        int64_t fee = 0;
         if (!tx.IsCoinbase()) {
             if (!blockchain) {
                 std::cerr << "[node] BroadcastTransaction: no blockchain available" << std::endl;
                 return;
             }
-            // serialize outside the lock
-            size_t txSize = tx.Serialize().size();
             try {
-                std::lock_guard<std::mutex> lock(blockchainMutex);
-                auto fee = blockchain->VerifyTransaction(&tx);
-                if (!fee) {
+                auto verifiedFee =
+                    blockchain->VerifyTransaction(&tx, mempool.GetParentTransactions(tx));
+                if (!verifiedFee) {
                     std::cerr << "[node] BroadcastTransaction: tx " << txid
                               << " failed verification" << std::endl;
                     return;
                 }
-                feeRate =
-                    txSize > 0 ? static_cast<double>(*fee) / static_cast<double>(txSize) : 0.0;
+                fee = *verifiedFee;
             } catch (const std::exception& e) {
                 std::cerr << "[node] BroadcastTransaction: verification error for " << txid << ": "
                           << e.what() << std::endl;
                 return;
             }
         }
-        if (!mempool.AddTransaction(tx, feeRate)) {
+        if (mempool.AddTransaction(tx, fee) != MempoolAddResult::Added) {
             return;
         }
+        acceptedOrphans = ProcessOrphans({tx.GetID()});
         minerCV.notify_one();
     }
 
     // empty source
     RelayTransaction(tx, "");
+    for (const auto& [orphan, fromPeer] : acceptedOrphans) {
+        RelayTransaction(orphan, fromPeer);
+    }
 }
 
 void Node::HandleBlock(PeerState& peerState, const std::vector<uint8_t>& payload) {
     try {
+        peerState.blockRequested = false;
         Block block = Block::Deserialize(payload);
-        std::string blockHash = ByteArrayToHexString(block.GetHash());
 
-        std::cout << "[node] Received block " << blockHash << " from "
+        std::cout << "[node] Received block " << block.GetHash().ToHex() << " from "
                   << peerState.peer->GetRemoteAddress() << std::endl;
+        MarkKnown(peerState, block.GetHash());
+
+        ProcessBlock(peerState, block, payload.size(), false);
+    } catch (const std::exception& e) {
+        std::cerr << "[node] Failed to process block from " << peerState.peer->GetRemoteAddress()
+                  << ": " << e.what() << std::endl;
+    }
+}
 
-        // verify proof of work
-        ProofOfWork pow(&block);
-        if (!pow.Validate()) {
-            Misbehave(peerState, 100, "invalid proof of work on block " + blockHash);
+void Node::ProcessBlock(PeerState& peerState, const Block& block, size_t serializedSize,
+                        bool reconstructed) {
+    std::string blockHash = block.GetHash().ToHex();
+
+    // whatever comes of it, no other peer has to send it anymore
+    requestTracker.Received(block.GetHash());
+
+    // verify proof of work
+    ProofOfWork pow(&block);
+    if (!pow.Validate()) {
+        // the merkle root of a rebuilt block is off when a short txid matched the wrong
+        // transaction, the header alone can't tell that apart from a bad block
+        if (reconstructed) {
+            std::cout << "[node] Rebuilt block " << blockHash.substr(0, 16)
+                      << "... does not match its header, fetching it whole" << std::endl;
+            RequestBlock(peerState, block.GetHash());
             return;
         }
+        Misbehave(peerState, 100, "invalid proof of work on block " + blockHash);
+        return;
+    }
 
-        // check block size and structure
-        if (!Block::CheckBlockSize(block, payload.size())) {
-            Misbehave(peerState, 100, "block size/structure check failed: " + blockHash);
+    // check block size and structure
+    if (!Block::CheckBlockSize(block, serializedSize)) {
+        Misbehave(peerState, 100, "block size/structure check failed: " + blockHash);
+        return;
+    }
+
+    // persist block and check sync status under one lock
+    std::vector<std::pair<Transaction, std::string>> acceptedOrphans;
+    bool relay = false;
+    {
+        std::lock_guard<std::mutex> lock(blockchainMutex);
+        if (!blockchain) {
+            std::cerr << "[node] Cannot store block: no blockchain" << std::endl;
             return;
         }
 
-        // persist block and check sync status under one lock
-        {
-            std::lock_guard<std::mutex> lock(blockchainMutex);
-            if (!blockchain) {
-                std::cerr << "[node] Cannot store block: no blockchain" << std::endl;
-                return;
-            }
+        int32_t nextHeight = blockchain->GetChainHeight() + 1;
 
-            int32_t nextHeight = blockchain->GetChainHeight() + 1;
+        // full verification with topological ordering
+        int64_t totalFees = 0;
+        std::unordered_map<Hash256, Transaction> blockCtx;
+        // outpoints spent so far, for double-spend detection
+        std::unordered_set<OutPoint> spentInBlock;
+        for (const auto& tx : block.GetTransactions()) {
+            if (tx.IsCoinbase()) {
+                blockCtx[tx.GetID()] = tx;
+                continue;
+            }
 
-            // full verification with topological ordering
-            int64_t totalFees = 0;
-            std::map<std::string, Transaction> blockCtx;
-            // "txid:vout" keys for double-spend detection
-            std::set<std::string> spentInBlock;
-            for (const auto& tx : block.GetTransactions()) {
-                if (tx.IsCoinbase()) {
-                    blockCtx[ByteArrayToHexString(tx.GetID())] = tx;
-                    continue;
+            // we check for double-spends within this block
+            for (const auto& vin : tx.GetVin()) {
+                OutPoint outpoint = vin.GetPrevOut();
+                if (!spentInBlock.insert(outpoint).second) {
+                    Misbehave(peerState, 100,
+                              "double-spend in block " + blockHash + " on " +
+                                  outpoint.ToString());
+                    return;
                 }
+            }
 
-                // we check for double-spends within this block
-                for (const auto& vin : tx.GetVin()) {
-                    std::string outpoint =
-                        ByteArrayToHexString(vin.GetTxid()) + ":" + std::to_string(vin.GetVout());
-                    if (!spentInBlock.insert(outpoint).second) {
-                        Misbehave(peerState, 100,
-                                  "double-spend in block " + blockHash + " on " + outpoint);
-                        return;
-                    }
+            try {
+                auto fee = blockchain->VerifyTransaction(&tx, blockCtx);
+                if (!fee) {
+                    Misbehave(peerState, 100,
+                              "invalid tx " + tx.GetID().ToHex() + " in block " + blockHash);
+                    return;
                 }
-
-                try {
-                    auto fee = blockchain->VerifyTransaction(&tx, blockCtx);
-                    if (!fee) {
-                        Misbehave(peerState, 100,
-                                  "invalid tx " + ByteArrayToHexString(tx.GetID()) + " in block " +
-                                      blockHash);
-                        return;
-                    }
-                    // this overflow check is a necessary compiler builtin, in order to make sure
-                    // transactions don't overflow
-                    if (CheckedAdd(totalFees, *fee, totalFees)) {
-                        Misbehave(peerState, 100, "fee overflow in block " + blockHash);
-                        return;
-                    }
-                } catch (const std::exception& e) {
-                    std::cerr << "[node] Rejected block " << blockHash
-                              << ": tx verification failed: " << e.what() << std::endl;
+                // this overflow check is a necessary compiler builtin, in order to make sure
+                // transactions don't overflow
+                if (CheckedAdd(totalFees, *fee, totalFees)) {
+                    Misbehave(peerState, 100, "fee overflow in block " + blockHash);
                     return;
                 }
-                blockCtx[ByteArrayToHexString(tx.GetID())] = tx;
+            } catch (const std::exception& e) {
+                std::cerr << "[node] Rejected block " << blockHash
+                          << ": tx verification failed: " << e.what() << std::endl;
+                return;
             }
+            blockCtx[tx.GetID()] = tx;
+        }
 
-            // validate coinbase reward
-            int64_t maxCoinbase;
-            if (CheckedAdd(Consensus::GetBlockSubsidy(nextHeight), totalFees, maxCoinbase)) {
-                Misbehave(peerState, 100, "subsidy + fees overflow in block " + blockHash);
+        // validate coinbase reward
+        int64_t maxCoinbase;
+        if (CheckedAdd(Consensus::GetBlockSubsidy(nextHeight), totalFees, maxCoinbase)) {
+            Misbehave(peerState, 100, "subsidy + fees overflow in block " + blockHash);
+            return;
+        }
+        int64_t coinbaseValue = 0;
+        for (const auto& out : block.GetTransactions()[0].GetVout()) {
+            if (CheckedAdd(coinbaseValue, out.GetValue(), coinbaseValue)) {
+                Misbehave(peerState, 100, "coinbase value overflow in block " + blockHash);
                 return;
             }
-            int64_t coinbaseValue = 0;
-            for (const auto& out : block.GetTransactions()[0].GetVout()) {
-                if (CheckedAdd(coinbaseValue, out.GetValue(), coinbaseValue)) {
-                    Misbehave(peerState, 100, "coinbase value overflow in block " + blockHash);
-                    return;
-                }
+        }
+        if (coinbaseValue > maxCoinbase) {
+            Misbehave(peerState, 100,
+                      "coinbase value " + std::to_string(coinbaseValue) + " exceeds allowed " +
+                          std::to_string(maxCoinbase) + " in block " + blockHash);
+            return;
+        }
+
+        blockchain->AddBlock(block);
+        merkleCache.AddBlock(block);
+
+        // incrementally update the UTXO set per block
+        UTXOSet utxoSet(blockchain.get());
+        utxoSet.Update(block);
+
+        // remove mined transactions from mempool
+        mempool.RemoveBlockTransactions(block, nextHeight);
+
+        // orphans the block confirmed or made invalid go, those it confirmed a parent of
+        // get another try
+        orphanPool.EraseForBlock(block);
+        std::vector<Hash256> blockTxids;
+        blockTxids.reserve(block.GetTransactions().size());
+        for (const auto& tx : block.GetTransactions()) blockTxids.push_back(tx.GetID());
+        acceptedOrphans = ProcessOrphans(std::move(blockTxids));
+
+        blockchainHeight.store(blockchain->GetChainHeight());
+        std::cout << "[node] Stored block " << blockHash.substr(0, 16)
+                  << "... (height=" << blockchainHeight << ")" << std::endl;
+
+        // a new tip goes on to our other peers, blocks fetched while syncing are old news
+        relay = !syncing;
+
+        // check if sync is complete
+        if (syncing && peerState.peer->GetRemoteAddress() == syncPeerAddr) {
+            if (blockchainHeight >= peerState.remoteHeight) {
+                syncing = false;
+                syncPeerAddr.clear();
+                std::cout << "[node] Sync complete. Chain is up to date at height "
+                          << blockchainHeight << std::endl;
+            }
+        }
+    }
+
+    for (const auto& [orphan, fromPeer] : acceptedOrphans) {
+        RelayTransaction(orphan, fromPeer);
+    }
+
+    if (relay) BroadcastBlock(block);
+}
+
+void Node::RequestBlock(PeerState& peerState, const Hash256& hash) {
+    MessageGetData getData({InvVector{InvType::Block, hash}});
+    Send(peerState, Message(MAGIC_CUSTOM, CMD_GETDATA, getData.Serialize()));
+    peerState.blockRequested = true;
+}
+
+void Node::SendGetData(PeerState& peerState, const std::vector<InvVector>& items) {
+    for (size_t i = 0; i < items.size(); i += MAX_INV_BATCH_SIZE) {
+        size_t end = std::min(i + MAX_INV_BATCH_SIZE, items.size());
+        MessageGetData getData(std::vector<InvVector>(items.begin() + i, items.begin() + end));
+        QueueSend(peerState, Message(MAGIC_CUSTOM, CMD_GETDATA, getData.Serialize()));
+    }
+}
+
+void Node::HandleCompactBlock(PeerState& peerState, const std::vector<uint8_t>& payload) {
+    try {
+        MessageCompactBlock compact = MessageCompactBlock::Deserialize(payload);
+        std::string blockHash = compact.GetHash().ToHex();
+
+        std::cout << "[node] Received compact block " << blockHash << " ("
+                  << compact.GetTransactionCount() << " txs) from "
+                  << peerState.peer->GetRemoteAddress() << std::endl;
+
+        // the header has to carry its proof of work before we spend anything on rebuilding it
+        if (!ProofOfWork::ValidateHeader(compact.GetPreviousHash(), compact.GetMerkleRoot(),
+                                         compact.GetTimestamp(), compact.GetBits(),
+                                         compact.GetNonce(), compact.GetHash())) {
+            Misbehave(peerState, 100, "invalid proof of work on compact block " + blockHash);
+            return;
+        }
+        MarkKnown(peerState, compact.GetHash());
+
+        // while syncing the block comes in with the rest
+        if (syncing) return;
+
+        {
+            std::lock_guard<std::mutex> lock(blockchainMutex);
+            if (!blockchain) return;
+            if (blockchain->GetBlockHeight(compact.GetHash()) >= 0) return;
+            if (compact.GetPreviousHash() != blockchain->GetTip()) {
+                std::cout << "[node] Compact block " << blockHash.substr(0, 16)
+                          << "... does not extend our tip, ignoring" << std::endl;
+                return;
             }
-            if (coinbaseValue > maxCoinbase) {
-                Misbehave(peerState, 100,
-                          "coinbase value " + std::to_string(coinbaseValue) + " exceeds allowed " +
-                              std::to_string(maxCoinbase) + " in block " + blockHash);
+            // easy work on our tip is as cheap to forge as none
+            int32_t expectedBits =
+                blockchain->GetNextWorkRequired(blockchain->GetChainHeight() + 1);
+            if (compact.GetBits() != expectedBits) {
+                Misbehave(peerState, 100, "compact block " + blockHash + " with bits " +
+                                              std::to_string(compact.GetBits()) + ", expected " +
+                                              std::to_string(expectedBits));
                 return;
             }
+        }
 
-            blockchain->AddBlock(block);
+        // nearly every transaction of a new block went through our mempool already
+        PartialBlock partial(std::move(compact));
+        size_t fromMempool = partial.FillFrom(mempool.GetTransactionRefs());
 
-            // incrementally update the UTXO set per block
-            UTXOSet utxoSet(blockchain.get());
-            utxoSet.Update(block);
+        if (partial.IsComplete()) {
+            std::cout << "[node] Rebuilt block " << blockHash.substr(0, 16) << "... with "
+                      << fromMempool << " mempool txs" << std::endl;
+            ProcessBlock(peerState, partial.ToBlock(), 0, true);
+            return;
+        }
 
-            // remove mined transactions from mempool
-            mempool.RemoveBlockTransactions(block);
+        // one round trip for whatever we are missing, a newer compact block replaces this one
+        std::vector<uint32_t> missing = partial.GetMissing();
+        MessageGetBlockTxn request(partial.GetHash(), missing);
+        Send(peerState, Message(MAGIC_CUSTOM, CMD_GETBLOCKTXN, request.Serialize()));
+        peerState.partialBlock = std::move(partial);
 
-            blockchainHeight.store(blockchain->GetChainHeight());
-            std::cout << "[node] Stored block " << blockHash.substr(0, 16)
-                      << "... (height=" << blockchainHeight << ")" << std::endl;
-
-            // check if sync is complete
-            if (syncing && peerState.peer->GetRemoteAddress() == syncPeerAddr) {
-                if (blockchainHeight >= peerState.remoteHeight) {
-                    syncing = false;
-                    syncPeerAddr.clear();
-                    std::cout << "[node] Sync complete. Chain is up to date at height "
-                              << blockchainHeight << std::endl;
-                }
+        std::cout << "[node] Requested " << missing.size() << " of "
+                  << peerState.partialBlock->GetTransactionCount() << " txs of block "
+                  << blockHash.substr(0, 16) << "... from " << peerState.peer->GetRemoteAddress()
+                  << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "[node] Failed to process compact block from "
+                  << peerState.peer->GetRemoteAddress() << ": " << e.what() << std::endl;
+    }
+}
+
+void Node::HandleGetBlockTxn(PeerState& peerState, const std::vector<uint8_t>& payload) {
+    try {
+        MessageGetBlockTxn request = MessageGetBlockTxn::Deserialize(payload);
+        std::string blockHash = request.GetBlockHash().ToHex();
+
+        // only blocks still being relayed, a syncing peer gets old ones through getdata and
+        // the historical upload cap
+        Block block;
+        {
+            std::lock_guard<std::mutex> lock(blockchainMutex);
+            if (!blockchain) return;
+            int32_t height = blockchain->GetBlockHeight(request.GetBlockHash());
+            if (height < 0 || blockchain->GetChainHeight() - height >= HISTORICAL_BLOCK_DEPTH) {
+                std::cout << "[node] Ignoring getblocktxn for block " << blockHash.substr(0, 16)
+                          << "... that is unknown or too deep from "
+                          << peerState.peer->GetRemoteAddress() << std::endl;
+                return;
             }
+            block = blockchain->GetBlock(request.GetBlockHash());
         }
+
+        const auto& txs = block.GetTransactions();
+        std::vector<Transaction> reply;
+        reply.reserve(request.GetIndexes().size());
+        for (uint32_t index : request.GetIndexes()) {
+            if (index >= txs.size()) {
+                Misbehave(peerState, 100, "getblocktxn index " + std::to_string(index) +
+                                              " out of range for block " + blockHash);
+                return;
+            }
+            reply.push_back(txs[index]);
+        }
+
+        MessageBlockTxn blockTxn(request.GetBlockHash(), std::move(reply));
+        Send(peerState, Message(MAGIC_CUSTOM, CMD_BLOCKTXN, blockTxn.Serialize()));
+
+        std::cout << "[node] Sent " << blockTxn.GetTransactions().size() << " txs of block "
+                  << blockHash.substr(0, 16) << "... to " << peerState.peer->GetRemoteAddress()
+                  << std::endl;
     } catch (const std::exception& e) {
-        std::cerr << "[node] Failed to process block from " << peerState.peer->GetRemoteAddress()
+        std::cerr << "[node] Failed to handle getblocktxn from "
+                  << peerState.peer->GetRemoteAddress() << ": " << e.what() << std::endl;
+    }
+}
+
+void Node::HandleBlockTxn(PeerState& peerState, const std::vector<uint8_t>& payload) {
+    try {
+        MessageBlockTxn blockTxn = MessageBlockTxn::Deserialize(payload);
+        std::string blockHash = blockTxn.GetBlockHash().ToHex();
+
+        const auto& pending = peerState.partialBlock;
+        if (!pending || pending->GetHash() != blockTxn.GetBlockHash()) {
+            std::cout << "[node] Ignoring blocktxn for block " << blockHash.substr(0, 16)
+                      << "... we are not waiting on" << std::endl;
+            return;
+        }
+
+        PartialBlock partial = std::move(*peerState.partialBlock);
+        peerState.partialBlock.reset();
+
+        if (!partial.FillMissing(blockTxn.GetTransactions())) {
+            Misbehave(peerState, 20,
+                      "blocktxn with the wrong number of txs for block " + blockHash);
+            RequestBlock(peerState, partial.GetHash());
+            return;
+        }
+
+        std::cout << "[node] Rebuilt block " << blockHash.substr(0, 16) << "... with "
+                  << blockTxn.GetTransactions().size() << " fetched txs" << std::endl;
+        ProcessBlock(peerState, partial.ToBlock(), 0, true);
+    } catch (const std::exception& e) {
+        std::cerr << "[node] Failed to process blocktxn from " << peerState.peer->GetRemoteAddress()
                   << ": " << e.what() << std::endl;
     }
 }
 
+TrafficClass Node::ClassifyReceived(PeerState& peerState, const std::string& command) {
+    if (command == CMD_BLOCK &&
+        (peerState.blockRequested ||
+         requestTracker.HasBlocksInFlight(peerState.peer->GetRemoteAddress()))) {
+        return TrafficClass::Block;
+    }
+    if (command == CMD_BLOCKTXN && peerState.partialBlock) return TrafficClass::Block;
+    return TrafficClass::Other;
+}
+
 void Node::DispatchMessage(PeerState& peerState, const Message& msg) {
     std::string cmd = msg.GetCommandString();
 
@@ -859,6 +1439,12 @@ void Node::DispatchMessage(PeerState& peerState, const Message& msg) {
         HandleTx(peerState, msg.GetPayload());
     } else if (cmd == CMD_BLOCK) {
         HandleBlock(peerState, msg.GetPayload());
+    } else if (cmd == CMD_CMPCTBLOCK) {
+        HandleCompactBlock(peerState, msg.GetPayload());
+    } else if (cmd == CMD_GETBLOCKTXN) {
+        HandleGetBlockTxn(peerState, msg.GetPayload());
+    } else if (cmd == CMD_BLOCKTXN) {
+        HandleBlockTxn(peerState, msg.GetPayload());
     } else if (cmd == CMD_ADDR) {
         HandleAddr(peerState, msg.GetPayload());
     } else if (cmd == CMD_GETADDR) {
@@ -869,64 +1455,51 @@ void Node::DispatchMessage(PeerState& peerState, const Message& msg) {
     }
 }
 
-void Node::MonitorPeer(std::shared_ptr<PeerState> peerState) {
-    while (running && peerState->peer->IsConnected()) {
-        // wait before first ping
-        std::this_thread::sleep_for(std::chrono::seconds(PING_INTERVAL_SECS));
-
-        if (!running || !peerState->peer->IsConnected()) {
-            break;
-        }
-
-        // send ping with random nonce
-        auto [pingMsg, nonce] = CreatePingMessage();
-
-        try {
-            peerState->peer->SendMessage(pingMsg);
-        } catch (const std::exception& e) {
-            std::cerr << "[node] Failed to send ping to " << peerState->peer->GetRemoteAddress()
-                      << ": " << e.what() << std::endl;
-            DisconnectPeer(peerState->peer->GetRemoteAddress());
-            return;
-        }
-
-        std::cout << "[node] Sent ping to " << peerState->peer->GetRemoteAddress() << std::endl;
+void Node::SchedulePing(PeerState& peerState) {
+    peerState.pingTimer = timers.Schedule(std::chrono::seconds(PING_INTERVAL_SECS),
+                                          [this, weak = peerState.weak_from_this()] {
+                                              if (auto p = weak.lock()) PingPeer(*p);
+                                          });
+}
 
-        // wait for pong with timeout
-        {
-            std::unique_lock<std::mutex> lock(peerState->pongMutex);
-            peerState->pongReceived = false;
+void Node::PingPeer(PeerState& peerState) {
+    if (!running || !peerState.peer->IsConnected()) {
+        return;
+    }
 
-            bool received =
-                peerState->pongCV.wait_for(lock, std::chrono::seconds(PING_TIMEOUT_SECS),
-                                           [&peerState]() { return peerState->pongReceived; });
+    // send ping with random nonce, the deadline is armed first so the pong can't beat it
+    auto [pingMsg, nonce] = CreatePingMessage();
+    {
+        std::lock_guard<std::mutex> lock(peerState.pingMutex);
+        peerState.pingNonce = nonce;
+        peerState.pingPending = true;
+        peerState.pingTimer = timers.Schedule(std::chrono::seconds(PING_TIMEOUT_SECS),
+                                              [this, weak = peerState.weak_from_this()] {
+                                                  if (auto p = weak.lock()) CheckPong(*p);
+                                              });
+    }
 
-            if (!received) {
-                std::cerr << "[node] Peer " << peerState->peer->GetRemoteAddress()
-                          << " no pong reply for " << PING_TIMEOUT_SECS << "s -- disconnecting"
-                          << std::endl;
-                DisconnectPeer(peerState->peer->GetRemoteAddress());
-                return;
-            }
+    // a writer that can't get it out disconnects the peer
+    QueueSend(peerState, pingMsg);
 
-            // validate nonce matches
-            if (peerState->pongNonce != nonce) {
-                std::cerr << "[node] Nonce mismatch from " << peerState->peer->GetRemoteAddress()
-                          << ": expected " << nonce << ", got " << peerState->pongNonce
-                          << " -- disconnecting" << std::endl;
-                DisconnectPeer(peerState->peer->GetRemoteAddress());
-                return;
-            }
-        }
+    std::cout << "[node] Queued ping to " << peerState.peer->GetRemoteAddress() << std::endl;
+}
 
-        std::cout << "[node] Got pong from " << peerState->peer->GetRemoteAddress() << std::endl;
+void Node::CheckPong(PeerState& peerState) {
+    {
+        std::lock_guard<std::mutex> lock(peerState.pingMutex);
+        if (!peerState.pingPending) return;
     }
+
+    std::cerr << "[node] Peer " << peerState.peer->GetRemoteAddress() << " no pong reply for "
+              << PING_TIMEOUT_SECS << "s -- disconnecting" << std::endl;
+    DisconnectPeer(peerState.peer->GetRemoteAddress());
 }
 
 void Node::DisconnectPeer(const std::string& peerAddr) {
     std::cout << "[node] Disconnecting peer " << peerAddr << std::endl;
 
-    // we find the peer under lock, then disconnect and notify outside the lock
+    // we find the peer under lock, then disconnect outside the lock
     std::shared_ptr<PeerState> target;
     {
         std::lock_guard<std::mutex> lock(peersMutex);
@@ -940,11 +1513,6 @@ void Node::DisconnectPeer(const std::string& peerAddr) {
 
     if (target) {
         target->peer->Disconnect();
-        {
-            std::lock_guard<std::mutex> pongLock(target->pongMutex);
-            target->pongReceived = true;
-        }
-        target->pongCV.notify_one();
     }
 }
 
@@ -967,70 +1535,135 @@ void Node::Misbehave(PeerState& peerState, int32_t score, const std::string& rea
     }
 }
 
-void Node::CleanupDisconnectedPeers() {
-    // collect disconnected peers under lock, then join their threads outside the lock
-    std::vector<std::shared_ptr<PeerState>> toCleanup;
-
+void Node::ReleasePeer(const std::shared_ptr<PeerState>& peerState) {
     {
         std::lock_guard<std::mutex> lock(peersMutex);
-        auto it = peers.begin();
-        while (it != peers.end()) {
-            if (!(*it)->peer->IsConnected()) {
-                toCleanup.push_back(*it);
-                it = peers.erase(it);
-            } else {
-                ++it;
-            }
-        }
+        std::erase(peers, peerState);
     }
-
-    // join outside the lock
-    for (auto& peerState : toCleanup) {
-        if (peerState->readerThread.joinable()) {
-            peerState->readerThread.join();
-        }
-        if (peerState->monitorThread.joinable()) {
-            peerState->monitorThread.join();
-        }
+    {
+        std::lock_guard<std::mutex> lock(peerState->pingMutex);
+        timers.Cancel(peerState->pingTimer);
     }
 
-    if (!toCleanup.empty()) {
-        std::cout << "[node] Cleaned up " << toCleanup.size() << " disconnected peer(s)"
+    // nobody is left to send the parents of its orphans, and what we asked it for has to
+    // come from someone else
+    orphanPool.EraseForPeer(peerState->peer->GetRemoteAddress());
+    requestTracker.RemovePeer(peerState->peer->GetRemoteAddress());
+
+    if (running) {
+        std::cout << "[node] Cleaned up disconnected peer " << peerState->peer->GetRemoteAddress()
                   << std::endl;
     }
 }
 
-void Node::RunCleanupLoop(std::stop_token stoken) {
-    std::stop_callback wake(stoken, [this] { cleanupCV.notify_all(); });
-    while (!stoken.stop_requested()) {
-        {
-            std::unique_lock<std::mutex> lock(cleanupCVMtx);
-            cleanupCV.wait_for(lock, std::chrono::seconds(30),
-                               [&] { return stoken.stop_requested(); });
+void Node::LoadMempool() {
+    std::vector<Transaction> txs = Mempool::ReadFromFile();
+    if (txs.empty()) return;
+
+    if (!blockchain) {
+        std::cerr << "[mempool] No blockchain available, dropping " << txs.size()
+                  << " dumped transactions" << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(blockchainMutex);
+    UTXOSet utxoSet(blockchain.get());
+
+    // dumped transactions may spend each other, the same way mempool transactions do
+    std::unordered_map<Hash256, Transaction> dumped;
+    for (const auto& tx : txs) dumped.insert({tx.GetID(), tx});
+
+    // verifying scans the chain for every input, so spread it over the cores
+    // no block can be connected until we return, the chain and UTXO set hold still meanwhile
+    std::vector<std::optional<int64_t>> fees(txs.size());
+    auto verifyRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const Transaction& tx = txs[i];
+            if (tx.IsCoinbase()) continue;
+            try {
+                // drop transactions spending outputs that blocks mined since the dump spent
+                const auto& vins = tx.GetVin();
+                bool unspent = std::all_of(vins.begin(), vins.end(), [&](const auto& vin) {
+                    return dumped.count(vin.GetTxid()) > 0 || utxoSet.IsUnspent(vin.GetPrevOut());
+                });
+                if (unspent) fees[i] = blockchain->VerifyTransaction(&tx, dumped);
+            } catch (const std::exception&) {
+                // spends a transaction the chain doesn't know
+            }
         }
-        if (!stoken.stop_requested()) {
-            CleanupDisconnectedPeers();
+    };
+
+    size_t workers = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, txs.size());
+    size_t chunk = (txs.size() + workers - 1) / workers;
+    {
+        std::vector<std::jthread> threads;
+        for (size_t begin = chunk; begin < txs.size(); begin += chunk) {
+            threads.emplace_back(verifyRange, begin, std::min(begin + chunk, txs.size()));
         }
+        verifyRange(0, std::min(chunk, txs.size()));
+    }
+
+    // admit in file order, parents come first so a child only goes in after its parents did
+    // a dumped parent that was not re-admitted may have been mined since, then the output it
+    // spends has to be unspent on the chain instead
+    size_t loaded = 0;
+    std::unordered_set<Hash256> admitted;
+    for (size_t i = 0; i < txs.size(); i++) {
+        if (!fees[i]) continue;
+
+        const Transaction& tx = txs[i];
+        const auto& vins = tx.GetVin();
+        bool parentsAvailable = std::all_of(vins.begin(), vins.end(), [&](const auto& vin) {
+            if (dumped.count(vin.GetTxid()) == 0 || admitted.count(vin.GetTxid()) > 0) {
+                return true;
+            }
+            return utxoSet.IsUnspent(vin.GetPrevOut());
+        });
+        if (!parentsAvailable) continue;
+
+        if (mempool.AddTransaction(tx, *fees[i]) == MempoolAddResult::Added) {
+            admitted.insert(tx.GetID());
+            loaded++;
+        }
+    }
+
+    std::cout << "[mempool] Loaded " << loaded << " of " << txs.size()
+              << " dumped transactions" << std::endl;
+}
+
+void Node::Cleanup() {
+    mempool.Expire();
+
+    size_t expired = orphanPool.EraseExpired();
+    if (expired > 0) {
+        std::cout << "[node] Expired " << expired << " orphan transaction(s)" << std::endl;
     }
 }
 
 void Node::StartPeerLoop(std::shared_ptr<PeerState> peerState) {
-    // the thread that reads messages
-    peerState->readerThread = std::thread([this, peerState]() {
+    {
+        std::lock_guard<std::mutex> lock(peerThreadsMutex);
+        peerThreads++;
+    }
+
+    // the thread that reads messages, it cleans up after the peer itself, so nothing else ever
+    // waits on it
+    std::thread([this, peerState]() {
         try {
             while (running && peerState->peer->IsConnected()) {
                 Message msg = peerState->peer->ReceiveMessage();
 
-                // per-peer rate limiting
-                auto now = std::chrono::steady_clock::now();
-                if (now - peerState->msgWindowStart >= std::chrono::seconds(1)) {
-                    peerState->msgCount = 0;
-                    peerState->msgWindowStart = now;
-                }
-                if (++peerState->msgCount > MAX_PEER_MESSAGES_PER_SEC) {
-                    Misbehave(*peerState, BAN_SCORE_THRESHOLD, "rate limit exceeded");
-                    break;
-                }
+                // a peer over its budget, or sending while the node is over its own, is not
+                // read from until the budget recovers, which backs its traffic up in TCP
+                // blocks we asked for are charged but never held back
+                TrafficClass trafficClass = ClassifyReceived(*peerState, msg.GetCommandString());
+                peerState->traffic.ChargeDownload(msg.GetSerializedSize());
+                nodeTraffic.ChargeDownload(msg.GetSerializedSize());
+
+                WaitForBudget(*peerState, [&] {
+                    return std::max(peerState->traffic.DownloadDelay(trafficClass),
+                                    nodeTraffic.DownloadDelay(trafficClass));
+                });
 
                 DispatchMessage(*peerState, msg);
             }
@@ -1041,25 +1674,26 @@ void Node::StartPeerLoop(std::shared_ptr<PeerState> peerState) {
             }
         }
 
+        // the writer skips the peer from now on, whatever is still queued goes with it
         peerState->peer->Disconnect();
+        ReleasePeer(peerState);
 
-        // wake the monitor thread so it exits
-        {
-            std::lock_guard<std::mutex> lock(peerState->pongMutex);
-            peerState->pongReceived = true;
-        }
-        peerState->pongCV.notify_one();
-    });
+        // notified only once the thread is gone, so Stop can't return while it still runs
+        std::unique_lock<std::mutex> lock(peerThreadsMutex);
+        peerThreads--;
+        std::notify_all_at_thread_exit(peerThreadsCV, std::move(lock));
+    }).detach();
 
-    // the thread that monitors liveliness
-    peerState->monitorThread = std::thread([this, peerState]() { MonitorPeer(peerState); });
+    // liveliness is monitored by the timer wheel
+    std::lock_guard<std::mutex> lock(peerState->pingMutex);
+    SchedulePing(*peerState);
 }
 
 void Node::ConnectToSeed(const std::string& seedIP, uint16_t seedPort) {
     try {
         auto peer = ConnectToPeer(seedIP, seedPort);
 
-        auto peerState = std::make_shared<PeerState>(std::move(peer));
+        auto peerState = std::make_shared<PeerState>(std::move(peer), bandwidthLimits);
         peerState->isOutbound = true;
 
         // outbound connection
@@ -1089,12 +1723,9 @@ void Node::MineBlock(const std::string& address) {
         throw std::runtime_error("Currently syncing, cannot mine");
     }
 
-    // snapshot mempool sorted by descending fee rate
-    auto sortedTxs = mempool.GetTransactionsSortedByFeeRate();
-
     // build the transaction list and read the current tip
     std::vector<Transaction> txs;
-    std::vector<uint8_t> prevHash;
+    Hash256 prevHash;
     {
         std::lock_guard<std::mutex> lock(blockchainMutex);
         if (!blockchain) throw std::runtime_error("No blockchain available for mining");
@@ -1103,39 +1734,20 @@ void Node::MineBlock(const std::string& address) {
         int32_t nextHeight = blockchain->GetChainHeight() + 1;
         int64_t subsidy = Consensus::GetBlockSubsidy(nextHeight);
 
-        // estimate base block size using a placeholder coinbase
-        Transaction placeholderCoinbase = Transaction::NewCoinbaseTX(address, nextHeight);
-        // timestamp(8) + txcount(4) + prevHash(32) + hash(32) + nonce(4) +
-        // the size of the coinbase transaction (4 bytes)
-        uint32_t blockSize = 84 + 4 + static_cast<uint32_t>(placeholderCoinbase.Serialize().size());
-
-        // select valid mempool transactions by fee rate, and stop at the block size limit
-        int64_t totalFees = 0;
-        for (const auto& tx : sortedTxs) {
-            uint32_t txBytes = 4 + static_cast<uint32_t>(tx.Serialize().size());
-            if (blockSize + txBytes > Policy::MAX_BLOCK_SIZE) {
-                std::cout << "[miner] Block size limit reached, stopping tx selection" << std::endl;
-                break;
-            }
-            if (txs.size() + 1 >= Policy::MAX_BLOCK_TXS) {
-                std::cout << "[miner] Block tx count limit reached" << std::endl;
-                break;
-            }
-            if (auto fee = blockchain->VerifyTransaction(&tx)) {
-                txs.push_back(tx);
-                totalFees += *fee;
-                blockSize += txBytes;
-            } else {
-                std::cerr << "[miner] Dropping invalid tx "
-                          << ByteArrayToHexString(tx.GetID()).substr(0, 16) << "..." << std::endl;
-            }
-        }
+        // the mempool keeps the template current as transactions and blocks arrive, and every
+        // tx in it was verified on admission, so this is normally just a pointer copy
+        // it is read under the chain lock because connecting a block updates the mempool there
+        auto blockTemplate = mempool.GetBlockTemplate();
 
         // coinbase collects the halved subsidy plus all collected fees
-        txs.insert(txs.begin(), Transaction::NewCoinbaseTX(address, nextHeight, totalFees));
+        txs.reserve(blockTemplate->transactions.size() + 1);
+        txs.push_back(Transaction::NewCoinbaseTX(address, nextHeight, blockTemplate->totalFees));
+        txs.insert(txs.end(), blockTemplate->transactions.begin(),
+                   blockTemplate->transactions.end());
 
         std::cout << "[miner] height=" << nextHeight << " subsidy=" << subsidy
-                  << " fees=" << totalFees << " reward=" << (subsidy + totalFees) << std::endl;
+                  << " fees=" << blockTemplate->totalFees
+                  << " reward=" << (subsidy + blockTemplate->totalFees) << std::endl;
     }
 
     // we determine difficulty for the next block
@@ -1157,15 +1769,16 @@ void Node::MineBlock(const std::string& address) {
         if (!blockchain) throw std::runtime_error("Blockchain unavailable after mining");
 
         blockchain->AddBlock(minedBlock);
+        merkleCache.AddBlock(minedBlock);
 
         UTXOSet utxoSet(blockchain.get());
         utxoSet.Update(minedBlock);
 
-        mempool.RemoveBlockTransactions(minedBlock);
+        mempool.RemoveBlockTransactions(minedBlock, blockchain->GetChainHeight());
         blockchainHeight.store(blockchain->GetChainHeight());
     }
 
-    std::string hashStr = ByteArrayToHexString(minedBlock.GetHash());
+    std::string hashStr = minedBlock.GetHash().ToHex();
     std::cout << "[miner] Mined block " << hashStr.substr(0, 16)
               << "... (height=" << blockchainHeight << ")" << std::endl;
 
@@ -1177,21 +1790,34 @@ void Node::BroadcastBlock(const Block& block) {
     MessageInv invMsg({invVec});
     Message msg(MAGIC_CUSTOM, CMD_INV, invMsg.Serialize());
 
-    std::string hashStr = ByteArrayToHexString(block.GetHash());
+    // pushed without waiting for a getdata, the peer rebuilds it from its mempool
+    MessageCompactBlock compact(block);
+    Message compactMsg(MAGIC_CUSTOM, CMD_CMPCTBLOCK, compact.Serialize());
 
-    std::lock_guard<std::mutex> lock(peersMutex);
-    for (const auto& peerState : peers) {
+    std::string hashStr = block.GetHash().ToHex();
+
+    // the writers do the sending, a stalled peer holds up neither the others nor the peer list
+    std::vector<std::shared_ptr<PeerState>> peersSnapshot;
+    {
+        std::lock_guard<std::mutex> lock(peersMutex);
+        peersSnapshot = peers;
+    }
+
+    for (const auto& peerState : peersSnapshot) {
         if (!peerState->peer->IsConnected()) continue;
         if (!peerState->handshakeComplete) continue;
 
-        try {
-            peerState->peer->SendMessage(msg);
-            std::cout << "[miner] Announced block " << hashStr.substr(0, 16) << "... to "
-                      << peerState->peer->GetRemoteAddress() << std::endl;
-        } catch (const std::exception& e) {
-            std::cerr << "[miner] Failed to announce block to "
-                      << peerState->peer->GetRemoteAddress() << ": " << e.what() << std::endl;
+        {
+            std::lock_guard<std::mutex> invLock(peerState->invMutex);
+            if (peerState->knownInventory.Contains(invVec.hash)) continue;
+            peerState->knownInventory.Insert(invVec.hash);
         }
+
+        bool sendCompact = peerState->protocolVersion >= COMPACT_BLOCKS_VERSION;
+        QueueSend(*peerState, sendCompact ? compactMsg : msg);
+        std::cout << "[node] Queued block announcement " << hashStr.substr(0, 16) << "... to "
+                  << peerState->peer->GetRemoteAddress() << (sendCompact ? " (compact)" : "")
+                  << std::endl;
     }
 }
 
@@ -1233,20 +1859,50 @@ void Node::Start(const std::string& seedAddr, volatile sig_atomic_t* shutdownFla
     addrManager.LoadFromFile();
     banManager.LoadFromFile();
 
+    // transactions entering the mempool from here on wait from the current height
+    feeEstimator.LoadFromFile();
+    feeEstimator.SetBestHeight(blockchainHeight);
+
+    // before the miner starts, so its first template already has the reloaded transactions
+    LoadMempool();
+
     std::cout << "[node] Node started on " << ip << ":" << port << std::endl;
     std::cout << "[node] Blockchain height: " << blockchainHeight << std::endl;
 
     // start the JSON RPC server for query
     rpcServer.Start();
 
-    // start background cleanup of disconnected peers
-    cleanupThread = std::jthread([this](std::stop_token st) { RunCleanupLoop(st); });
+    // periodic jobs, all on the timer wheel's thread
+    timers.ScheduleEvery(std::chrono::milliseconds(INV_FLUSH_INTERVAL_MS), [this] { FlushInv(); });
+    timers.ScheduleEvery(std::chrono::seconds(CLEANUP_INTERVAL_SECS), [this] { Cleanup(); });
+    timers.ScheduleEvery(std::chrono::seconds(BAN_SWEEP_INTERVAL_SECS),
+                         [this] { banManager.SweepExpired(); });
+    timers.ScheduleEvery(std::chrono::seconds(MEMPOOL_DUMP_INTERVAL_SECS), [this] {
+        mempool.SaveToFile();
+        feeEstimator.SaveToFile();
+    });
+    timers.ScheduleEvery(std::chrono::seconds(ADDR_DUMP_INTERVAL_SECS), [this] {
+        addrManager.SaveToFile();
+        banManager.SaveToFile();
+    });
 
-    // start inv batching flush thread
-    invFlushThread = std::jthread([this](std::stop_token st) { RunInvFlushLoop(st); });
+    if (pipe(writerWake) < 0) {
+        throw std::runtime_error("Failed to create the writer wake pipe");
+    }
+    fcntl(writerWake[0], F_SETFL, O_NONBLOCK);
+    fcntl(writerWake[1], F_SETFL, O_NONBLOCK);
+    writerThread = std::jthread([this](std::stop_token st) { RunWriter(st); });
 
-    // start background outbound connection loop
+    std::cout << "[node] Outbound connection manager started (target=" << TARGET_OUTBOUND_PEERS
+              << ")" << std::endl;
     outboundThread = std::jthread([this](std::stop_token st) { RunOutboundLoop(st); });
+    timers.ScheduleEvery(std::chrono::seconds(OUTBOUND_INTERVAL_SECS), [this] {
+        {
+            std::lock_guard<std::mutex> lock(outboundMtx);
+            outboundDue = true;
+        }
+        outboundCV.notify_one();
+    });
 
     // start background miner if a reward address was configured
     if (!minerAddress.empty()) {
@@ -1301,7 +1957,7 @@ void Node::Start(const std::string& seedAddr, volatile sig_atomic_t* shutdownFla
                 }
             }
 
-            auto peerState = std::make_shared<PeerState>(std::move(peer));
+            auto peerState = std::make_shared<PeerState>(std::move(peer), bandwidthLimits);
 
             {
                 std::lock_guard<std::mutex> lock(peersMutex);
@@ -1324,46 +1980,38 @@ void Node::Stop() {
     server.Stop();
     rpcServer.Stop();
 
-    // persist address book and ban list before shutting down
+    // joins the timer thread, so no periodic dump races the saves below
+    timers.Stop();
+
+    // persist address book, ban list, mempool and fee statistics before shutting down
     addrManager.SaveToFile();
     banManager.SaveToFile();
+    mempool.SaveToFile();
+    feeEstimator.SaveToFile();
 
-    cleanupThread.request_stop();
     minerThread.request_stop();
     outboundThread.request_stop();
-    invFlushThread.request_stop();
-    invFlushCV.notify_all();
-    if (cleanupThread.joinable()) cleanupThread.join();
+    writerThread.request_stop();
+    WakeWriter();
     if (minerThread.joinable()) minerThread.join();
     if (outboundThread.joinable()) outboundThread.join();
-    if (invFlushThread.joinable()) invFlushThread.join();
+    if (writerThread.joinable()) writerThread.join();
+    for (int& fd : writerWake) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
 
-    // copy peers under lock, disconnect and wake all monitor threads
-    std::vector<std::shared_ptr<PeerState>> peersSnapshot;
+    // disconnect every peer, their reader threads then clean up and exit
     {
         std::lock_guard<std::mutex> lock(peersMutex);
-        peersSnapshot = peers;
-
-        for (auto& peerState : peersSnapshot) {
+        for (auto& peerState : peers) {
             peerState->peer->Disconnect();
-
-            // we wake the monitoring thread so it exits
-            {
-                std::lock_guard<std::mutex> pongLock(peerState->pongMutex);
-                peerState->pongReceived = true;
-            }
-            peerState->pongCV.notify_one();
         }
     }
 
-    // join all threads
-    for (auto& peerState : peersSnapshot) {
-        if (peerState->readerThread.joinable()) {
-            peerState->readerThread.join();
-        }
-        if (peerState->monitorThread.joinable()) {
-            peerState->monitorThread.join();
-        }
+    {
+        std::unique_lock<std::mutex> lock(peerThreadsMutex);
+        peerThreadsCV.wait(lock, [this] { return peerThreads == 0; });
     }
 
     {
@@ -1386,7 +2034,8 @@ void Node::HandleAddr(PeerState& peerState, const std::vector<uint8_t>& payload)
         }
 
         // add all received addresses to our address book
-        addrManager.AddMultiple(addrMsg.GetAddresses());
+        addrManager.AddMultiple(addrMsg.GetAddresses(),
+                                ExtractIP(peerState.peer->GetRemoteAddress()));
 
         // if the addr message contains only 1-2 addresses, then it's a new peer
         // so we relay it's infor to 2 others to help it get known
@@ -1420,7 +2069,8 @@ void Node::HandleGetAddr(PeerState& peerState) {
     Message msg(MAGIC_CUSTOM, CMD_ADDR, addrMsg.Serialize());
 
     try {
-        peerState.peer->SendMessage(msg);
+        WaitForUpload(peerState, TrafficClass::Other);
+        Send(peerState, msg);
         std::cout << "[node] Sent addr with " << addresses.size() << " address(es) to "
                   << peerState.peer->GetRemoteAddress() << std::endl;
     } catch (const std::exception& e) {
@@ -1441,6 +2091,11 @@ void Node::GossipAddr(const NetAddr& addr, const std::string& sourcePeerAddr) {
         if (!peerState->peer->IsConnected()) continue;
         if (!peerState->handshakeComplete) continue;
         if (peerState->peer->GetRemoteAddress() == sourcePeerAddr) continue;
+        // gossip is best effort, a peer without upload budget to spare doesn't get it
+        if (UploadDelay(*peerState, TrafficClass::Other) >
+            std::chrono::steady_clock::duration::zero()) {
+            continue;
+        }
         eligible.push_back(peerState);
     }
 
@@ -1454,7 +2109,7 @@ void Node::GossipAddr(const NetAddr& addr, const std::string& sourcePeerAddr) {
     size_t relayCount = std::min(static_cast<size_t>(2), eligible.size());
     for (size_t i = 0; i < relayCount; i++) {
         try {
-            eligible[i]->peer->SendMessage(msg);
+            Send(*eligible[i], msg);
         } catch (const std::exception& e) {
             std::cerr << "[node] Failed to gossip addr to " << eligible[i]->peer->GetRemoteAddress()
                       << ": " << e.what() << std::endl;
@@ -1463,86 +2118,76 @@ void Node::GossipAddr(const NetAddr& addr, const std::string& sourcePeerAddr) {
 }
 
 void Node::RunOutboundLoop(std::stop_token stoken) {
-    std::cout << "[node] Outbound connection manager started (target=" << TARGET_OUTBOUND_PEERS
-              << ")" << std::endl;
-
-    std::stop_callback wake(stoken, [this] { outboundCV.notify_all(); });
-
-    while (!stoken.stop_requested()) {
-        // wait before checking
+    while (true) {
         {
-            std::unique_lock<std::mutex> lock(outboundCVMtx);
-            outboundCV.wait_for(lock, std::chrono::seconds(OUTBOUND_INTERVAL_SECS),
-                                [&] { return stoken.stop_requested(); });
+            std::unique_lock<std::mutex> lock(outboundMtx);
+            if (!outboundCV.wait(lock, stoken, [this] { return outboundDue; })) break;
+            outboundDue = false;
         }
 
+        ConnectOutboundPeers(stoken);
+    }
+}
+
+void Node::ConnectOutboundPeers(std::stop_token stoken) {
+    size_t outbound = CountOutboundPeers();
+    if (outbound >= TARGET_OUTBOUND_PEERS) {
+        return;
+    }
+
+    size_t needed = TARGET_OUTBOUND_PEERS - outbound;
+    std::vector<std::string> connected = GetConnectedPeerAddrs();
+    std::vector<NetAddr> candidates = addrManager.GetRandomAddresses(needed, connected);
+
+    for (const auto& candidate : candidates) {
         if (stoken.stop_requested()) break;
 
-        size_t outbound = CountOutboundPeers();
-        if (outbound >= TARGET_OUTBOUND_PEERS) {
-            continue;
+        // check we haven't hit the global peer limit
+        {
+            std::lock_guard<std::mutex> lock(peersMutex);
+            if (peers.size() >= MAX_PEERS) break;
         }
 
-        size_t needed = TARGET_OUTBOUND_PEERS - outbound;
-        std::vector<std::string> connected = GetConnectedPeerAddrs();
-        std::vector<NetAddr> candidates = addrManager.GetRandomAddresses(needed, connected);
+        // extract IP and port from the NetAddr
+        std::string candidateIP =
+            std::to_string(candidate.ip[12]) + "." + std::to_string(candidate.ip[13]) + "." +
+            std::to_string(candidate.ip[14]) + "." + std::to_string(candidate.ip[15]);
+        uint16_t candidatePort = candidate.port;
 
-        if (candidates.empty()) {
-            continue;
-        }
+        // skip banned IPs
+        if (banManager.IsBanned(candidateIP)) continue;
+
+        std::cout << "[node] Attempting outbound connection to " << candidateIP << ":"
+                  << candidatePort << std::endl;
+
+        try {
+            auto peer = ConnectToPeer(candidateIP, candidatePort);
+            auto peerState = std::make_shared<PeerState>(std::move(peer), bandwidthLimits);
+            peerState->isOutbound = true;
 
-        for (const auto& candidate : candidates) {
-            if (stoken.stop_requested()) break;
+            SendVersion(*peerState);
 
-            // check we haven't hit the global peer limit
             {
                 std::lock_guard<std::mutex> lock(peersMutex);
-                if (peers.size() >= MAX_PEERS) break;
+                peers.push_back(peerState);
             }
 
-            // extract IP and port from the NetAddr
-            std::string candidateIP =
-                std::to_string(candidate.ip[12]) + "." + std::to_string(candidate.ip[13]) + "." +
-                std::to_string(candidate.ip[14]) + "." + std::to_string(candidate.ip[15]);
-            uint16_t candidatePort = candidate.port;
+            StartPeerLoop(peerState);
 
-            // skip banned IPs
-            if (banManager.IsBanned(candidateIP)) continue;
+            // mark this address as good, because it was recently seen
+            addrManager.MarkGood(candidateIP, candidatePort);
 
-            std::cout << "[node] Attempting outbound connection to " << candidateIP << ":"
+            std::cout << "[node] Outbound connection established to " << candidateIP << ":"
                       << candidatePort << std::endl;
 
-            try {
-                auto peer = ConnectToPeer(candidateIP, candidatePort);
-                auto peerState = std::make_shared<PeerState>(std::move(peer));
-                peerState->isOutbound = true;
-
-                SendVersion(*peerState);
-
-                {
-                    std::lock_guard<std::mutex> lock(peersMutex);
-                    peers.push_back(peerState);
-                }
-
-                StartPeerLoop(peerState);
-
-                // mark this address as good, because it was recently seen
-                addrManager.MarkGood(candidateIP, candidatePort);
-
-                std::cout << "[node] Outbound connection established to " << candidateIP << ":"
-                          << candidatePort << std::endl;
-
-            } catch (const std::exception& e) {
-                std::cerr << "[node] Failed outbound connection to " << candidateIP << ":"
-                          << candidatePort << ": " << e.what() << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "[node] Failed outbound connection to " << candidateIP << ":"
+                      << candidatePort << ": " << e.what() << std::endl;
 
-                // remove unreachable addresses from the book
-                addrManager.Remove(candidateIP, candidatePort);
-            }
+            // remove unreachable addresses from the book
+            addrManager.Remove(candidateIP, candidatePort);
         }
     }
-
-    std::cout << "[node] Outbound connection manager stopped" << std::endl;
 }
 
 size_t Node::CountOutboundPeers() {
@@ -0,0 +1,146 @@
+#include "orphanPool.h"
+
+#include <algorithm>
+#include <ctime>
+
+#include "config.h"
+#include "outPoint.h"
+
+void OrphanPool::EraseLocked(std::unordered_map<Hash256, OrphanEntry>::iterator it) {
+    const Hash256& txid = it->first;
+    const OrphanEntry& entry = it->second;
+
+    for (const auto& parent : entry.missingParents) {
+        auto parentIt = byMissingParent.find(parent);
+        if (parentIt == byMissingParent.end()) continue;
+        parentIt->second.erase(txid);
+        if (parentIt->second.empty()) byMissingParent.erase(parentIt);
+    }
+
+    byExpiry.erase({entry.expireTime, txid});
+
+    auto countIt = peerCounts.find(entry.fromPeer);
+    if (countIt != peerCounts.end() && --countIt->second == 0) peerCounts.erase(countIt);
+
+    orphans.erase(it);
+}
+
+bool OrphanPool::Add(const Transaction& tx, const std::string& fromPeer,
+                     const std::vector<Hash256>& missingParents) {
+    // a large orphan costs the memory of many small ones and may never be resolved
+    if (tx.SerializedSize() > Policy::MAX_ORPHAN_TX_SIZE) return false;
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    Hash256 txid = tx.GetID();
+    if (orphans.count(txid)) return false;
+
+    // one peer can't crowd the pool with orphans nobody else relays
+    auto countIt = peerCounts.find(fromPeer);
+    if (countIt != peerCounts.end() && countIt->second >= Policy::MAX_ORPHANS_PER_PEER) {
+        return false;
+    }
+
+    while (orphans.size() >= Policy::MAX_ORPHAN_TXS && !byExpiry.empty()) {
+        EraseLocked(orphans.find(byExpiry.begin()->second));
+    }
+
+    int64_t expireTime = static_cast<int64_t>(std::time(nullptr)) + Policy::ORPHAN_TX_EXPIRE_SECS;
+    orphans.emplace(txid, OrphanEntry{tx, fromPeer, expireTime, missingParents});
+    for (const auto& parent : missingParents) byMissingParent[parent].insert(txid);
+    byExpiry.insert({expireTime, txid});
+    peerCounts[fromPeer]++;
+
+    return true;
+}
+
+std::vector<OrphanEntry> OrphanPool::GetChildren(const std::vector<Hash256>& parents) const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::vector<OrphanEntry> children;
+    std::unordered_set<Hash256> seen;
+    for (const auto& parent : parents) {
+        auto parentIt = byMissingParent.find(parent);
+        if (parentIt == byMissingParent.end()) continue;
+
+        for (const auto& txid : parentIt->second) {
+            if (seen.insert(txid).second) children.push_back(orphans.at(txid));
+        }
+    }
+    return children;
+}
+
+void OrphanPool::Erase(const Hash256& txid) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = orphans.find(txid);
+    if (it != orphans.end()) EraseLocked(it);
+}
+
+size_t OrphanPool::EraseForBlock(const Block& block) {
+    std::unordered_set<Hash256> confirmed;
+    std::unordered_set<OutPoint> spent;
+    for (const auto& tx : block.GetTransactions()) {
+        confirmed.insert(tx.GetID());
+        if (tx.IsCoinbase()) continue;
+        for (const auto& vin : tx.GetVin()) spent.insert(vin.GetPrevOut());
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    size_t erased = 0;
+    for (auto it = orphans.begin(); it != orphans.end();) {
+        const auto& vins = it->second.tx.GetVin();
+        bool drop = confirmed.count(it->first) > 0 ||
+                    std::any_of(vins.begin(), vins.end(), [&](const auto& vin) {
+                        return spent.count(vin.GetPrevOut()) > 0;
+                    });
+
+        if (drop) {
+            EraseLocked(it++);
+            erased++;
+        } else {
+            ++it;
+        }
+    }
+    return erased;
+}
+
+size_t OrphanPool::EraseForPeer(const std::string& peerAddr) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (!peerCounts.count(peerAddr)) return 0;
+
+    size_t erased = 0;
+    for (auto it = orphans.begin(); it != orphans.end();) {
+        if (it->second.fromPeer == peerAddr) {
+            EraseLocked(it++);
+            erased++;
+        } else {
+            ++it;
+        }
+    }
+    return erased;
+}
+
+size_t OrphanPool::EraseExpired() {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+    size_t erased = 0;
+    while (!byExpiry.empty() && byExpiry.begin()->first <= now) {
+        EraseLocked(orphans.find(byExpiry.begin()->second));
+        erased++;
+    }
+    return erased;
+}
+
+bool OrphanPool::Contains(const Hash256& txid) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return orphans.count(txid) > 0;
+}
+
+size_t OrphanPool::Size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return orphans.size();
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "partialBlock.h"
+
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+// marks a short txid that can't tell its transaction apart
+static constexpr size_t AMBIGUOUS = std::numeric_limits<size_t>::max();
+
+PartialBlock::PartialBlock(MessageCompactBlock compact) : compact(std::move(compact)) {
+    slots.resize(this->compact.GetTransactionCount());
+    for (const auto& p : this->compact.GetPrefilled()) {
+        slots[p.index] = std::make_shared<const Transaction>(p.tx);
+        filledCount++;
+    }
+}
+
+size_t PartialBlock::FillFrom(const std::vector<std::shared_ptr<const Transaction>>& candidates) {
+    // short txid -> slot, the short txids go in order into the slots not prefilled
+    std::unordered_map<uint64_t, size_t> slotByShortID;
+    slotByShortID.reserve(compact.GetShortIDs().size());
+    size_t slot = 0;
+    for (uint64_t id : compact.GetShortIDs()) {
+        while (slots[slot]) slot++;
+        auto [it, inserted] = slotByShortID.try_emplace(id, slot);
+        if (!inserted) it->second = AMBIGUOUS;
+        slot++;
+    }
+
+    std::vector<std::shared_ptr<const Transaction>> found(slots.size());
+    for (const auto& tx : candidates) {
+        auto it = slotByShortID.find(compact.ShortID(tx->GetID()));
+        if (it == slotByShortID.end() || it->second == AMBIGUOUS) continue;
+        if (slots[it->second]) continue;
+
+        // a second match means two of ours collide, neither can be trusted
+        if (found[it->second]) {
+            found[it->second] = nullptr;
+            it->second = AMBIGUOUS;
+            continue;
+        }
+        found[it->second] = tx;
+    }
+
+    size_t filled = 0;
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (!found[i]) continue;
+        slots[i] = std::move(found[i]);
+        filled++;
+    }
+    filledCount += filled;
+    return filled;
+}
+
+std::vector<uint32_t> PartialBlock::GetMissing() const {
+    std::vector<uint32_t> missing;
+    missing.reserve(slots.size() - filledCount);
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (!slots[i]) missing.push_back(static_cast<uint32_t>(i));
+    }
+    return missing;
+}
+
+bool PartialBlock::FillMissing(const std::vector<Transaction>& txs) {
+    if (txs.size() != slots.size() - filledCount) return false;
+
+    auto next = txs.begin();
+    for (auto& slot : slots) {
+        if (slot) continue;
+        slot = std::make_shared<const Transaction>(*next++);
+    }
+    filledCount = slots.size();
+    return true;
+}
+
+Block PartialBlock::ToBlock() const {
+    if (!IsComplete()) throw std::runtime_error("Partial block is missing transactions");
+
+    std::vector<Transaction> txs;
+    txs.reserve(slots.size());
+    for (const auto& slot : slots) txs.push_back(*slot);
+
+    return Block(compact.GetTimestamp(), std::move(txs), compact.GetPreviousHash(),
+                 compact.GetHash(), compact.GetNonce(), compact.GetBits());
+}
\ No newline at end of file
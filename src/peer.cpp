@@ -9,9 +9,6 @@
 #include <stdexcept>
 #include <utility>
 
-// header size: 4 (magic) + 12 (command) + 4 (length) + 4 (checksum)
-static constexpr size_t MESSAGE_HEADER_SIZE = 24;
-
 // reject payloads larger than 32 MB
 static constexpr uint32_t MAX_PAYLOAD_SIZE = 32 * 1024 * 1024;
 
@@ -25,7 +22,12 @@ Peer::Peer(int sockfd, const std::string& remoteIP, uint16_t remotePort)
     }
 }
 
-Peer::~Peer() { Disconnect(); }
+Peer::~Peer() {
+    Disconnect();
+    if (sockfd >= 0) {
+        close(sockfd);
+    }
+}
 
 void Peer::SetRecvTimeout(int seconds) {
     timeval tv{};
@@ -54,7 +56,10 @@ Peer::Peer(Peer&& other) noexcept
     : sockfd(other.sockfd),
       remoteIP(std::move(other.remoteIP)),
       remotePort(other.remotePort),
-      connected(other.connected) {
+      connected(other.connected.load()),
+      pendingOutput(std::move(other.pendingOutput)),
+      pendingOffset(other.pendingOffset),
+      lastSendProgress(other.lastSendProgress) {
     other.sockfd = -1;
     other.connected = false;
 }
@@ -62,10 +67,16 @@ Peer::Peer(Peer&& other) noexcept
 Peer& Peer::operator=(Peer&& other) noexcept {
     if (this != &other) {
         Disconnect();
+        if (sockfd >= 0) {
+            close(sockfd);
+        }
         sockfd = other.sockfd;
         remoteIP = std::move(other.remoteIP);
         remotePort = other.remotePort;
-        connected = other.connected;
+        connected = other.connected.load();
+        pendingOutput = std::move(other.pendingOutput);
+        pendingOffset = other.pendingOffset;
+        lastSendProgress = other.lastSendProgress;
         other.sockfd = -1;
         other.connected = false;
     }
@@ -96,7 +107,7 @@ std::vector<uint8_t> Peer::ReadExact(size_t count) {
     return buffer;
 }
 
-void Peer::WriteAll(const std::vector<uint8_t>& data) {
+void Peer::WriteAll(std::span<const uint8_t> data) {
     size_t totalSent = 0;
 
     while (totalSent < data.size()) {
@@ -120,6 +131,18 @@ void Peer::SendMessage(const Message& msg) {
         throw std::runtime_error("Not connected to " + GetRemoteAddress());
     }
 
+    // the stream would interleave if what the writer only got partly out didn't go first
+    std::vector<uint8_t> pending;
+    size_t offset = 0;
+    {
+        std::lock_guard<std::mutex> pendingLock(pendingMtx);
+        pending.swap(pendingOutput);
+        std::swap(offset, pendingOffset);
+    }
+    if (offset < pending.size()) {
+        WriteAll(std::span<const uint8_t>(pending).subspan(offset));
+    }
+
     std::vector<uint8_t> serialized = msg.Serialize();
     WriteAll(serialized);
 
@@ -127,6 +150,57 @@ void Peer::SendMessage(const Message& msg) {
               << serialized.size() << " bytes)" << std::endl;
 }
 
+void Peer::QueueMessage(const Message& msg) {
+    std::lock_guard<std::mutex> lock(pendingMtx);
+
+    if (!connected) {
+        throw std::runtime_error("Not connected to " + GetRemoteAddress());
+    }
+
+    // the send timeout counts from when there is something to send
+    if (pendingOffset == pendingOutput.size()) {
+        pendingOutput.clear();
+        pendingOffset = 0;
+        lastSendProgress = std::chrono::steady_clock::now();
+    }
+
+    std::vector<uint8_t> serialized = msg.Serialize();
+    pendingOutput.insert(pendingOutput.end(), serialized.begin(), serialized.end());
+
+    std::cout << "[net] Sending " << msg.GetCommandString() << " to " << GetRemoteAddress()
+              << " (" << serialized.size() << " bytes)" << std::endl;
+}
+
+FlushResult Peer::FlushPending() {
+    std::unique_lock<std::mutex> sendLock(sendMtx, std::try_to_lock);
+    if (!sendLock.owns_lock()) return FlushResult::SenderBusy;
+    std::lock_guard<std::mutex> lock(pendingMtx);
+
+    while (pendingOffset < pendingOutput.size()) {
+        ssize_t n = send(sockfd, pendingOutput.data() + pendingOffset,
+                         pendingOutput.size() - pendingOffset, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (std::chrono::steady_clock::now() - lastSendProgress >
+                    std::chrono::seconds(PEER_SEND_TIMEOUT_SECS)) {
+                    connected = false;
+                    throw std::runtime_error("Send timeout to " + GetRemoteAddress());
+                }
+                return FlushResult::SocketFull;
+            }
+            connected = false;
+            throw std::runtime_error("Failed to send to " + GetRemoteAddress());
+        }
+        pendingOffset += static_cast<size_t>(n);
+        lastSendProgress = std::chrono::steady_clock::now();
+    }
+
+    pendingOutput.clear();
+    pendingOffset = 0;
+    return FlushResult::Flushed;
+}
+
 Message Peer::ReceiveMessage() {
     if (!connected) {
         throw std::runtime_error("Not connected to " + GetRemoteAddress());
@@ -144,22 +218,14 @@ Message Peer::ReceiveMessage() {
                                  " bytes) from " + GetRemoteAddress());
     }
 
-    // if there's a payload, read it and deserialize the full message
+    // if there's a payload, read it and move it into the message without re-copying the header
     if (payloadLength > 0) {
-        std::vector<uint8_t> payloadData = ReadExact(payloadLength);
+        headerOnly.AttachPayload(ReadExact(payloadLength));
 
-        // combine header and payload
-        std::vector<uint8_t> fullMessage;
-        fullMessage.reserve(MESSAGE_HEADER_SIZE + payloadLength);
-        fullMessage.insert(fullMessage.end(), headerData.begin(), headerData.end());
-        fullMessage.insert(fullMessage.end(), payloadData.begin(), payloadData.end());
+        std::cout << "[net] Received " << headerOnly.GetCommandString() << " from "
+                  << GetRemoteAddress() << std::endl;
 
-        Message msg = Message::Deserialize(fullMessage);
-
-        std::cout << "[net] Received " << msg.GetCommandString() << " from " << GetRemoteAddress()
-                  << std::endl;
-
-        return msg;
+        return headerOnly;
     }
 
     // verify checksum for empty payload messages
@@ -177,8 +243,7 @@ Message Peer::ReceiveMessage() {
 
 void Peer::Disconnect() {
     if (sockfd >= 0) {
-        close(sockfd);
-        sockfd = -1;
+        shutdown(sockfd, SHUT_RDWR);
     }
     connected = false;
 }
@@ -2,37 +2,47 @@
 
 #include <openssl/bn.h>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
 #include "block.h"
-#include "crypto.h"
 #include "serialization.h"
+#include "sha256.h"
 
-ProofOfWork::ProofOfWork(const Block* block) : block(block), target(BN_new(), BN_free) {
+// the target 1 << (256 - bits) as 32 big-endian bytes
+static std::array<uint8_t, HASH256_SIZE> TargetBytes(int32_t bits) {
+    BN_ptr target(BN_new(), BN_free);
     if (!target) {
         throw std::runtime_error("Failed to allocate BIGNUM for PoW target");
     }
     BN_one(target.get());
-    BN_lshift(target.get(), target.get(), 256 - block->GetBits());
+    BN_lshift(target.get(), target.get(), 256 - bits);
+
+    std::array<uint8_t, HASH256_SIZE> bytes;
+    if (BN_bn2binpad(target.get(), bytes.data(), static_cast<int>(bytes.size())) < 0) {
+        throw std::runtime_error("PoW target does not fit in 256 bits");
+    }
+    return bytes;
 }
 
-std::vector<uint8_t> ProofOfWork::PrepareData(int32_t nonce) const {
+static std::vector<uint8_t> HeaderData(const Hash256& previousHash, const Hash256& merkleRoot,
+                                       int64_t timestamp, int32_t bits, int32_t nonce) {
     std::vector<uint8_t> data;
 
     // previous block hash (32 bytes)
-    data.insert(data.end(), block->GetPreviousHash().begin(), block->GetPreviousHash().end());
+    data.insert(data.end(), previousHash.begin(), previousHash.end());
 
     // hash of all transactions (32 bytes)
-    std::vector<uint8_t> txHashBytes = block->HashTransactions();
-    data.insert(data.end(), txHashBytes.begin(), txHashBytes.end());
+    data.insert(data.end(), merkleRoot.begin(), merkleRoot.end());
 
     // timestamp (8 bytes)
-    std::vector<uint8_t> timestampBytes = IntToHexByteArray(block->GetTimestamp());
+    std::vector<uint8_t> timestampBytes = IntToHexByteArray(timestamp);
     data.insert(data.end(), timestampBytes.begin(), timestampBytes.end());
 
     // target bits (8 bytes)
-    std::vector<uint8_t> targetBitsBytes = IntToHexByteArray(block->GetBits());
+    std::vector<uint8_t> targetBitsBytes = IntToHexByteArray(bits);
     data.insert(data.end(), targetBitsBytes.begin(), targetBitsBytes.end());
 
     // nonce (8 bytes)
@@ -42,31 +52,67 @@ std::vector<uint8_t> ProofOfWork::PrepareData(int32_t nonce) const {
     return data;
 }
 
-std::pair<int32_t, std::vector<uint8_t>> ProofOfWork::Run() {
-    BN_ptr hashInt(BN_new(), BN_free);
-    if (!hashInt) {
-        throw std::runtime_error("Failed to allocate BIGNUM for PoW hash");
+ProofOfWork::ProofOfWork(const Block* block)
+    : block(block),
+      merkleRoot(block->HashTransactions()),
+      targetBytes(TargetBytes(block->GetBits())) {}
+
+// comparing big-endian digests bytewise is the same as comparing them as 256-bit integers
+bool ProofOfWork::MeetsTarget(const uint8_t* hash) const {
+    return std::memcmp(hash, targetBytes.data(), targetBytes.size()) < 0;
+}
+
+std::vector<uint8_t> ProofOfWork::PrepareData(int32_t nonce) const {
+    return HeaderData(block->GetPreviousHash(), merkleRoot, block->GetTimestamp(),
+                      block->GetBits(), nonce);
+}
+
+std::pair<int32_t, Hash256> ProofOfWork::Run() {
+    // candidates only differ in the trailing 8 byte nonce, so they are stamped from one header
+    std::vector<uint8_t> header = PrepareData(0);
+    size_t headerSize = header.size();
+    size_t nonceOffset = headerSize - 8;
+
+    std::vector<uint8_t> candidates(POW_BATCH_SIZE * headerSize);
+    for (int32_t i = 0; i < POW_BATCH_SIZE; i++) {
+        std::copy(header.begin(), header.end(), candidates.begin() + i * headerSize);
     }
+    std::vector<uint8_t> digests(POW_BATCH_SIZE * HASH256_SIZE);
 
-    std::vector<uint8_t> hash;
+    Hash256 hash;
     int32_t nonce = 0;
 
     std::cout << "Mining a new block: " << std::endl;
 
     while (nonce < maxNonce) {
-        std::vector<uint8_t> data = PrepareData(nonce);
+        int32_t batch = std::min(POW_BATCH_SIZE, maxNonce - nonce);
+
+        for (int32_t i = 0; i < batch; i++) {
+            int64_t candidateNonce = static_cast<int64_t>(nonce) + i;
+            uint8_t* nonceBytes = candidates.data() + i * headerSize + nonceOffset;
+            for (int b = 0; b < 8; b++) {
+                nonceBytes[7 - b] = static_cast<uint8_t>((candidateNonce >> (8 * b)) & 0xFF);
+            }
+        }
 
-        hash = SHA256Hash(data);
+        SHA256Batch(candidates.data(), headerSize, batch, digests.data());
 
-        std::cout << "\r" << ByteArrayToHexString(hash) << std::flush;
+        int32_t found = -1;
+        for (int32_t i = 0; i < batch; i++) {
+            if (MeetsTarget(digests.data() + i * HASH256_SIZE)) {
+                found = i;
+                break;
+            }
+        }
 
-        BN_bin2bn(hash.data(), hash.size(), hashInt.get());
+        // the first winning candidate, or the last one tried for the progress line
+        int32_t shown = found >= 0 ? found : batch - 1;
+        hash = Hash256::FromBytes(digests.data() + shown * HASH256_SIZE, HASH256_SIZE);
+        std::cout << "\r" << hash.ToHex() << std::flush;
 
-        if (BN_cmp(hashInt.get(), target.get()) == -1) {
-            break;
-        } else {
-            nonce++;
-        }
+        nonce += shown;
+        if (found >= 0) break;
+        nonce++;
     }
     std::cout << std::endl << std::endl;
 
@@ -74,14 +120,22 @@ std::pair<int32_t, std::vector<uint8_t>> ProofOfWork::Run() {
 }
 
 bool ProofOfWork::Validate() const {
-    BN_ptr hashInt(BN_new(), BN_free);
-    if (!hashInt) {
-        throw std::runtime_error("Failed to allocate BIGNUM for PoW validation");
-    }
-
     std::vector<uint8_t> data = PrepareData(block->GetNonce());
-    std::vector<uint8_t> hash = SHA256Hash(data);
 
-    BN_bin2bn(hash.data(), hash.size(), hashInt.get());
-    return BN_cmp(hashInt.get(), target.get()) == -1;
+    uint8_t hash[HASH256_SIZE];
+    SHA256Batch(data.data(), data.size(), 1, hash);
+    return MeetsTarget(hash);
+}
+
+bool ProofOfWork::ValidateHeader(const Hash256& previousHash, const Hash256& merkleRoot,
+                                 int64_t timestamp, int32_t bits, int32_t nonce,
+                                 const Hash256& hash) {
+    if (bits < Consensus::MIN_BITS || bits > Consensus::MAX_BITS) return false;
+
+    std::vector<uint8_t> data = HeaderData(previousHash, merkleRoot, timestamp, bits, nonce);
+    uint8_t digest[HASH256_SIZE];
+    SHA256Batch(data.data(), data.size(), 1, digest);
+    if (std::memcmp(digest, hash.bytes.data(), HASH256_SIZE) != 0) return false;
+
+    return std::memcmp(digest, TargetBytes(bits).data(), HASH256_SIZE) < 0;
 }
\ No newline at end of file
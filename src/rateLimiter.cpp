@@ -0,0 +1,85 @@
+#include "rateLimiter.h"
+
+#include <algorithm>
+
+#include "message.h"
+
+TrafficClass ClassifyCommand(const std::string& command) {
+    if (command == CMD_BLOCK || command == CMD_CMPCTBLOCK || command == CMD_BLOCKTXN) {
+        return TrafficClass::Block;
+    }
+    return TrafficClass::Other;
+}
+
+// for the token bucket
+TokenBucket::TokenBucket(double rate)
+    : rate(rate),
+      capacity(rate * RATE_LIMIT_BURST_SECS),
+      tokens(capacity),
+      lastRefill(Clock::now()) {}
+
+void TokenBucket::Refill(Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+    tokens = std::min(capacity, tokens + elapsed * rate);
+    lastRefill = now;
+}
+
+void TokenBucket::Consume(double amount) {
+    if (rate <= 0.0) return;
+    Refill(Clock::now());
+    tokens -= amount;
+}
+
+TokenBucket::Clock::duration TokenBucket::Delay() {
+    if (rate <= 0.0) return Clock::duration::zero();
+    Refill(Clock::now());
+    if (tokens >= 0.0) return Clock::duration::zero();
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(-tokens / rate));
+}
+
+// for the traffic limiter
+TrafficLimiter::TrafficLimiter(uint64_t uploadRate, uint64_t downloadRate,
+                               uint64_t historicalUploadRate, double messageRate)
+    : upload(static_cast<double>(uploadRate)),
+      download(static_cast<double>(downloadRate)),
+      historicalUpload(static_cast<double>(historicalUploadRate)),
+      messages(messageRate) {}
+
+void TrafficLimiter::ChargeUpload(size_t bytes, TrafficClass trafficClass) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto amount = static_cast<double>(bytes);
+    upload.Consume(amount);
+    if (trafficClass == TrafficClass::Historical) historicalUpload.Consume(amount);
+    totals.bytesSent += bytes;
+    totals.messagesSent++;
+}
+
+void TrafficLimiter::ChargeDownload(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mtx);
+    download.Consume(static_cast<double>(bytes));
+    messages.Consume(1.0);
+    totals.bytesReceived += bytes;
+    totals.messagesReceived++;
+}
+
+std::chrono::steady_clock::duration TrafficLimiter::UploadDelay(TrafficClass trafficClass) {
+    if (trafficClass == TrafficClass::Block) return std::chrono::steady_clock::duration::zero();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto delay = upload.Delay();
+    if (trafficClass == TrafficClass::Historical) delay = std::max(delay, historicalUpload.Delay());
+    return delay;
+}
+
+std::chrono::steady_clock::duration TrafficLimiter::DownloadDelay(TrafficClass trafficClass) {
+    if (trafficClass == TrafficClass::Block) return std::chrono::steady_clock::duration::zero();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    return std::max(download.Delay(), messages.Delay());
+}
+
+TrafficTotals TrafficLimiter::GetTotals() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return totals;
+}
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include "requestTracker.h"
+
+#include <algorithm>
+
+bool RequestTracker::HasSlot(const std::string& peer, InvType type) const {
+    auto it = load.find(peer);
+    if (it == load.end()) return true;
+    if (type == InvType::Block) return it->second.blocks < MAX_BLOCKS_IN_FLIGHT_PER_PEER;
+    return it->second.txs < MAX_TXS_IN_FLIGHT_PER_PEER;
+}
+
+void RequestTracker::Assign(Request& request, const std::string& peer, Clock::time_point now) {
+    waiting.erase({request.sequence, request.inv.hash});
+    std::erase(request.announcers, peer);
+
+    int timeoutSecs;
+    PeerLoad& peerLoad = load[peer];
+    if (request.inv.type == InvType::Block) {
+        peerLoad.blocks++;
+        timeoutSecs = BLOCK_REQUEST_TIMEOUT_SECS;
+    } else {
+        peerLoad.txs++;
+        timeoutSecs = TX_REQUEST_TIMEOUT_SECS;
+    }
+
+    request.inFlightPeer = peer;
+    request.deadline = now + std::chrono::seconds(timeoutSecs);
+    byDeadline.insert({request.deadline, request.inv.hash});
+}
+
+void RequestTracker::Unassign(std::unordered_map<Hash256, Request>::iterator it) {
+    Request& request = it->second;
+    byDeadline.erase({request.deadline, request.inv.hash});
+
+    auto loadIt = load.find(request.inFlightPeer);
+    if (loadIt != load.end()) {
+        size_t& count = request.inv.type == InvType::Block ? loadIt->second.blocks
+                                                           : loadIt->second.txs;
+        if (count > 0) count--;
+        if (loadIt->second.blocks == 0 && loadIt->second.txs == 0) load.erase(loadIt);
+    }
+    Release(request.inFlightPeer);
+    request.inFlightPeer.clear();
+
+    if (request.announcers.empty()) {
+        requests.erase(it);
+    } else {
+        waiting.insert({request.sequence, request.inv.hash});
+    }
+}
+
+void RequestTracker::Release(const std::string& peer) {
+    auto it = announced.find(peer);
+    if (it != announced.end() && --it->second == 0) announced.erase(it);
+}
+
+std::vector<InvVector> RequestTracker::Announce(const std::string& peer,
+                                                const std::vector<InvVector>& items) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Clock::time_point now = Clock::now();
+
+    std::vector<InvVector> toRequest;
+    size_t& peerAnnounced = announced[peer];
+    for (const auto& inv : items) {
+        if (peerAnnounced >= MAX_ANNOUNCEMENTS_PER_PEER) break;
+
+        auto [it, inserted] = requests.try_emplace(inv.hash);
+        Request& request = it->second;
+
+        if (inserted) {
+            request.inv = inv;
+            request.sequence = nextSequence++;
+            waiting.insert({request.sequence, inv.hash});
+        } else if (request.inFlightPeer == peer ||
+                   std::find(request.announcers.begin(), request.announcers.end(), peer) !=
+                       request.announcers.end()) {
+            continue;
+        }
+
+        if (request.inFlightPeer.empty() && HasSlot(peer, inv.type)) {
+            Assign(request, peer, now);
+            toRequest.push_back(request.inv);
+            peerAnnounced++;
+        } else if (request.announcers.size() < MAX_ANNOUNCERS_PER_ITEM) {
+            request.announcers.push_back(peer);
+            peerAnnounced++;
+        }
+    }
+    if (peerAnnounced == 0) announced.erase(peer);
+
+    return toRequest;
+}
+
+void RequestTracker::Received(const Hash256& hash) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = requests.find(hash);
+    if (it == requests.end()) return;
+
+    // nobody else needs to be asked for it
+    for (const auto& peer : it->second.announcers) Release(peer);
+    it->second.announcers.clear();
+    if (!it->second.inFlightPeer.empty()) {
+        Unassign(it);
+    } else {
+        waiting.erase({it->second.sequence, hash});
+        requests.erase(it);
+    }
+}
+
+RequestBatches RequestTracker::Dispatch() {
+    std::lock_guard<std::mutex> lock(mtx);
+    Clock::time_point now = Clock::now();
+
+    // the peer that let it time out is not asked again, Assign took it off the announcers
+    while (!byDeadline.empty() && byDeadline.begin()->first <= now) {
+        Unassign(requests.find(byDeadline.begin()->second));
+    }
+
+    RequestBatches batches;
+    for (auto wit = waiting.begin(); wit != waiting.end();) {
+        auto it = requests.find(wit->second);
+        Request& request = it->second;
+
+        // nobody left to ask
+        if (request.announcers.empty()) {
+            wit = waiting.erase(wit);
+            requests.erase(it);
+            continue;
+        }
+        ++wit;  // Assign erases the current position
+
+        for (const auto& peer : request.announcers) {
+            if (!HasSlot(peer, request.inv.type)) continue;
+            std::string chosen = peer;  // Assign erases it from the announcers
+            Assign(request, chosen, now);
+            batches[chosen].push_back(request.inv);
+            break;
+        }
+    }
+
+    return batches;
+}
+
+void RequestTracker::RemovePeer(const std::string& peer) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    for (auto it = requests.begin(); it != requests.end();) {
+        auto current = it++;
+        Request& request = current->second;
+        std::erase(request.announcers, peer);
+
+        if (request.inFlightPeer == peer) {
+            Unassign(current);
+        } else if (request.inFlightPeer.empty() && request.announcers.empty()) {
+            waiting.erase({request.sequence, request.inv.hash});
+            requests.erase(current);
+        }
+    }
+
+    load.erase(peer);
+    announced.erase(peer);
+}
+
+bool RequestTracker::HasBlocksInFlight(const std::string& peer) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = load.find(peer);
+    return it != load.end() && it->second.blocks > 0;
+}
+
+size_t RequestTracker::Size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return requests.size();
+}
\ No newline at end of file
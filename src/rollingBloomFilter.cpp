@@ -0,0 +1,92 @@
+#include "rollingBloomFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+// keys are uniformly random already, mixing with the tweak is only there against grinding
+static uint64_t Mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// index of the first word of the pair h maps to, spread over all words without a division
+static size_t WordPair(uint32_t h, size_t words) {
+    return static_cast<size_t>((static_cast<uint64_t>(h) * words) >> 32) & ~size_t{1};
+}
+
+RollingBloomFilter::RollingBloomFilter(uint32_t maxElements, double fpRate) {
+    // the optimal number of hash functions for the rate, with the filter sized for three
+    // generations since that is how many can be live at once
+    double logFpRate = std::log(fpRate);
+    hashFuncs = static_cast<uint32_t>(
+        std::clamp(std::lround(logFpRate / std::log(0.5)), 1L, 50L));
+    entriesPerGeneration = (maxElements + 1) / 2;
+    uint32_t maxLive = entriesPerGeneration * 3;
+    auto filterBits = static_cast<uint64_t>(std::ceil(
+        -1.0 * hashFuncs * maxLive / std::log(1.0 - std::exp(logFpRate / hashFuncs))));
+
+    data.resize(((filterBits + 63) / 64) * 2);
+
+    std::random_device rd;
+    tweak = (static_cast<uint64_t>(rd()) << 32) | rd();
+
+    Reset();
+}
+
+uint32_t RollingBloomFilter::Hash(uint32_t n, const Hash256& key) const {
+    uint64_t word;
+    std::memcpy(&word, key.bytes.data() + 8 * (n % 4), sizeof(word));
+    return static_cast<uint32_t>(Mix64(word ^ (tweak + n * 0x9e3779b97f4a7c15ULL)));
+}
+
+void RollingBloomFilter::Insert(const Hash256& key) {
+    if (entriesThisGeneration == entriesPerGeneration) {
+        entriesThisGeneration = 0;
+        generation = generation == 3 ? 1 : generation + 1;
+
+        // clear every position still tagged with the generation we are about to reuse
+        uint64_t mask1 = 0 - static_cast<uint64_t>(generation & 1);
+        uint64_t mask2 = 0 - static_cast<uint64_t>(generation >> 1);
+        for (size_t p = 0; p < data.size(); p += 2) {
+            uint64_t keep = (data[p] ^ mask1) | (data[p + 1] ^ mask2);
+            data[p] &= keep;
+            data[p + 1] &= keep;
+        }
+    }
+    entriesThisGeneration++;
+
+    for (uint32_t n = 0; n < hashFuncs; n++) {
+        uint32_t h = Hash(n, key);
+        int bit = h & 0x3f;
+        size_t pos = WordPair(h, data.size());
+
+        data[pos] &= ~(uint64_t{1} << bit);
+        data[pos] |= static_cast<uint64_t>(generation & 1) << bit;
+        data[pos + 1] &= ~(uint64_t{1} << bit);
+        data[pos + 1] |= static_cast<uint64_t>(generation >> 1) << bit;
+    }
+}
+
+bool RollingBloomFilter::Contains(const Hash256& key) const {
+    for (uint32_t n = 0; n < hashFuncs; n++) {
+        uint32_t h = Hash(n, key);
+        int bit = h & 0x3f;
+        size_t pos = WordPair(h, data.size());
+
+        // set by any generation still live
+        if (!(((data[pos] | data[pos + 1]) >> bit) & 1)) return false;
+    }
+    return true;
+}
+
+void RollingBloomFilter::Reset() {
+    entriesThisGeneration = 0;
+    generation = 1;
+    std::fill(data.begin(), data.end(), 0);
+}
\ No newline at end of file
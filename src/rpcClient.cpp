@@ -1,7 +1,10 @@
 #include <cstdint>
 #include <iostream>
 #include <nlohmann/json.hpp>
+#include <sstream>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "merkleProof.h"
 #include "rpcServer.h"
@@ -17,6 +20,7 @@ void printUsage() {
               << ")\n";
     std::cout << "\nMethods (no flags):\n";
     std::cout << "  getmempool      list unconfirmed transactions\n";
+    std::cout << "  getmempoolinfo  mempool size, minimum fee rate and admission counters\n";
     std::cout << "  getblockcount   current chain height\n";
     std::cout << "  getsyncing      sync status\n";
     std::cout << "\nMethods with flags:\n";
@@ -31,6 +35,12 @@ void printUsage() {
     std::cout << "  verifytx -txid TXID\n";
     std::cout << "          fetch a Merkle proof from the node and verify it locally\n";
     std::cout << "          (SPV: no blockchain access required for the verification step)\n";
+    std::cout << "  getmerkleproofs -txids TXID[,TXID...]\n";
+    std::cout << "          fetch one compact multiproof per block covering all the TXIDs\n";
+    std::cout << "  verifytxs -txids TXID[,TXID...]\n";
+    std::cout << "          fetch multiproofs from the node and verify every TXID locally\n";
+    std::cout << "  estimatefee [-blocks N]\n";
+    std::cout << "          fee rate (raffys per byte) that confirms within N blocks (default 6)\n";
     std::cout << "  getpeerinfo\n";
     std::cout << "          get information about the connected peers and address book status\n";
     std::cout << "\nExamples:\n";
@@ -118,6 +128,20 @@ int main(int argc, char* argv[]) {
             std::cerr << "Error: mine requires -address\n";
             return 1;
         }
+    } else if (method == "estimatefee") {
+        for (int i = methodIdx + 1; i < argc; i += 2) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: flag " << argv[i] << " requires a value\n";
+                return 1;
+            }
+            std::string flag = argv[i];
+            if (flag == "-blocks") {
+                params["blocks"] = std::stoi(argv[i + 1]);
+            } else {
+                std::cerr << "Error: unknown flag '" << flag << "' for estimatefee\n";
+                return 1;
+            }
+        }
     } else if (method == "getmerkleproof" || method == "verifytx") {
         for (int i = methodIdx + 1; i < argc; i += 2) {
             if (i + 1 >= argc) {
@@ -136,20 +160,86 @@ int main(int argc, char* argv[]) {
             std::cerr << "Error: " << method << " requires -txid\n";
             return 1;
         }
+    } else if (method == "getmerkleproofs" || method == "verifytxs") {
+        for (int i = methodIdx + 1; i < argc; i += 2) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: flag " << argv[i] << " requires a value\n";
+                return 1;
+            }
+            std::string flag = argv[i];
+            if (flag == "-txids") {
+                // comma separated list
+                json txids = json::array();
+                std::stringstream list(argv[i + 1]);
+                std::string txid;
+                while (std::getline(list, txid, ',')) {
+                    if (!txid.empty()) txids.push_back(txid);
+                }
+                params["txids"] = txids;
+            } else {
+                std::cerr << "Error: unknown flag '" << flag << "'\n";
+                return 1;
+            }
+        }
+        if (!params.contains("txids") || params["txids"].empty()) {
+            std::cerr << "Error: " << method << " requires -txids\n";
+            return 1;
+        }
     }
 
     try {
+        if (method == "verifytxs") {
+            // fetch one multiproof per block, then verify them all locally
+            json result = RPCCall(rpcPort, "getmerkleproofs", params);
+
+            std::unordered_set<Hash256> proven;
+            size_t hashCount = 0;
+            for (const auto& proofJson : result["proofs"]) {
+                MerkleMultiProof proof;
+                proof.txCount = proofJson["txCount"].get<uint32_t>();
+                proof.merkleRoot = Hash256::FromHex(proofJson["merkleRoot"].get<std::string>());
+                proof.flags = HexStringToByteArray(proofJson["flags"].get<std::string>());
+                for (const auto& hash : proofJson["hashes"]) {
+                    proof.hashes.push_back(Hash256::FromHex(hash.get<std::string>()));
+                }
+                hashCount += proof.hashes.size();
+
+                std::vector<MerkleMultiProofMatch> matches;
+                if (!VerifyMerkleMultiProof(proof, &matches)) {
+                    std::cerr << "Proof INVALID for block "
+                              << proofJson["blockHash"].get<std::string>() << "\n";
+                    return 1;
+                }
+                for (const auto& match : matches) proven.insert(match.txHash);
+            }
+
+            // the node must have proven exactly what was asked for
+            for (const auto& txid : params["txids"]) {
+                std::string txidStr = txid.get<std::string>();
+                if (!proven.count(Hash256::FromHex(txidStr))) {
+                    std::cerr << "Proof INVALID for txid " << txidStr << "\n";
+                    return 1;
+                }
+            }
+
+            std::cout << "Proofs valid\n";
+            std::cout << "  transactions: " << proven.size() << "\n";
+            std::cout << "  blocks:       " << result["proofs"].size() << "\n";
+            std::cout << "  hashes:       " << hashCount << "\n";
+            return 0;
+        }
+
         if (method == "verifytx") {
             // fetch the proof from the node, then verify it locally
             json proofJson = RPCCall(rpcPort, "getmerkleproof", params);
 
             // reconstruct the MerkleProof from the JSON response
             MerkleProof proof;
-            proof.txHash = HexStringToByteArray(proofJson["txHash"].get<std::string>());
-            proof.merkleRoot = HexStringToByteArray(proofJson["merkleRoot"].get<std::string>());
+            proof.txHash = Hash256::FromHex(proofJson["txHash"].get<std::string>());
+            proof.merkleRoot = Hash256::FromHex(proofJson["merkleRoot"].get<std::string>());
             for (const auto& step : proofJson["path"]) {
                 MerkleProofStep s;
-                s.hash = HexStringToByteArray(step["hash"].get<std::string>());
+                s.hash = Hash256::FromHex(step["hash"].get<std::string>());
                 s.isLeft = step["isLeft"].get<bool>();
                 proof.path.push_back(s);
             }
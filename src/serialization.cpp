@@ -1,30 +1,164 @@
 #include "serialization.h"
 
 #include <algorithm>
-#include <cstdlib>
-#include <iomanip>
+#include <array>
 #include <sstream>
 #include <stdexcept>
+#include <string_view>
 
-std::string ByteArrayToHexString(const std::vector<uint8_t>& bytes) {
-    std::ostringstream ss;
-    for (uint8_t b : bytes) {
-        ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(b);
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HEX_HAVE_SSSE3 1
+#else
+#define HEX_HAVE_SSSE3 0
+#endif
+
+static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+// maps an ascii character to its nibble value, or -1 if it is not a hex digit
+static constexpr std::array<int8_t, 256> HEX_VALUES = [] {
+    std::array<int8_t, 256> table{};
+    table.fill(-1);
+    for (int i = 0; i < 10; i++) table['0' + i] = static_cast<int8_t>(i);
+    for (int i = 0; i < 6; i++) {
+        table['a' + i] = static_cast<int8_t>(10 + i);
+        table['A' + i] = static_cast<int8_t>(10 + i);
+    }
+    return table;
+}();
+
+static void HexEncodeScalar(const uint8_t* data, size_t len, char* out) {
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = HEX_DIGITS[data[i] >> 4];
+        out[2 * i + 1] = HEX_DIGITS[data[i] & 0x0F];
     }
-    return ss.str();
+}
+
+static bool HexDecodeScalar(const char* hex, size_t len, uint8_t* out) {
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        int8_t hi = HEX_VALUES[static_cast<uint8_t>(hex[i])];
+        int8_t lo = HEX_VALUES[static_cast<uint8_t>(hex[i + 1])];
+        if ((hi | lo) < 0) return false;
+        out[i / 2] = static_cast<uint8_t>((hi << 4) | lo);
+    }
+    return true;
+}
+
+#if HEX_HAVE_SSSE3
+// 16 bytes -> 32 characters per iteration, pshufb does the nibble to digit lookup
+__attribute__((target("ssse3"))) static void HexEncodeSSSE3(const uint8_t* data, size_t len,
+                                                             char* out) {
+    const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(HEX_DIGITS));
+    const __m128i lowMask = _mm_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), lowMask);
+        __m128i lo = _mm_and_si128(in, lowMask);
+
+        __m128i hiChars = _mm_shuffle_epi8(digits, hi);
+        __m128i loChars = _mm_shuffle_epi8(digits, lo);
+
+        // interleave so each byte becomes its high digit followed by its low digit
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i),
+                         _mm_unpacklo_epi8(hiChars, loChars));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i + 16),
+                         _mm_unpackhi_epi8(hiChars, loChars));
+    }
+
+    HexEncodeScalar(data + i, len - i, out + 2 * i);
+}
+
+// 16 characters -> 8 bytes per iteration, any non hex character fails the whole decode
+__attribute__((target("ssse3"))) static bool HexDecodeSSSE3(const char* hex, size_t len,
+                                                             uint8_t* out) {
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i five = _mm_set1_epi8(5);
+    const __m128i ten = _mm_set1_epi8(10);
+    const __m128i lowerCase = _mm_set1_epi8(0x20);
+    // pmaddubsw weights: high digit * 16 + low digit
+    const __m128i weights = _mm_set1_epi16(0x0110);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + i));
+
+        // unsigned range checks via min: x <= n  <=>  min(x, n) == x
+        __m128i digit = _mm_sub_epi8(in, _mm_set1_epi8('0'));
+        __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, nine), digit);
+
+        __m128i letter = _mm_sub_epi8(_mm_or_si128(in, lowerCase), _mm_set1_epi8('a'));
+        __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, five), letter);
+
+        if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xFFFF) return false;
+
+        __m128i values = _mm_or_si128(_mm_and_si128(isDigit, digit),
+                                      _mm_and_si128(isLetter, _mm_add_epi8(letter, ten)));
+
+        __m128i pairs = _mm_maddubs_epi16(values, weights);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i / 2),
+                         _mm_packus_epi16(pairs, _mm_setzero_si128()));
+    }
+
+    return HexDecodeScalar(hex + i, len - i, out + i / 2);
+}
+
+static bool CpuHasSSSE3() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+#endif
+
+using HexEncodeFn = void (*)(const uint8_t*, size_t, char*);
+using HexDecodeFn = bool (*)(const char*, size_t, uint8_t*);
+
+// the kernel is picked once on first use, based on what the cpu supports
+void HexEncode(const uint8_t* data, size_t len, char* out) {
+#if HEX_HAVE_SSSE3
+    static const HexEncodeFn impl = CpuHasSSSE3() ? HexEncodeSSSE3 : HexEncodeScalar;
+#else
+    static const HexEncodeFn impl = HexEncodeScalar;
+#endif
+    impl(data, len, out);
+}
+
+bool HexDecode(const char* hex, size_t len, uint8_t* out) {
+    if (len % 2 != 0) return false;
+
+#if HEX_HAVE_SSSE3
+    static const HexDecodeFn impl = CpuHasSSSE3() ? HexDecodeSSSE3 : HexDecodeScalar;
+#else
+    static const HexDecodeFn impl = HexDecodeScalar;
+#endif
+    return impl(hex, len, out);
+}
+
+std::string ByteArrayToHexString(const std::vector<uint8_t>& bytes) {
+    return ByteArrayToHexString(bytes.data(), bytes.size());
+}
+
+std::string ByteArrayToHexString(const uint8_t* data, size_t len) {
+    std::string hex(len * 2, '\0');
+    HexEncode(data, len, hex.data());
+    return hex;
 }
 
 std::vector<uint8_t> HexStringToByteArray(const std::string& hex) {
-    std::string padded = hex;
-    if (padded.size() % 2 != 0) {
-        padded.insert(padded.begin(), '0');
+    // odd length input is treated as having a leading zero
+    std::string_view digits = hex;
+    std::vector<uint8_t> bytes((digits.size() + 1) / 2);
+    uint8_t* out = bytes.data();
+
+    if (digits.size() % 2 != 0) {
+        int8_t lo = HEX_VALUES[static_cast<uint8_t>(digits[0])];
+        if (lo < 0) throw std::invalid_argument("Invalid hex string: non-hex character");
+        *out++ = static_cast<uint8_t>(lo);
+        digits.remove_prefix(1);
     }
 
-    std::vector<uint8_t> bytes;
-    bytes.reserve(padded.size() / 2);
-    for (size_t i = 0; i < padded.size(); i += 2) {
-        bytes.push_back(
-            static_cast<uint8_t>(std::strtol(padded.substr(i, 2).c_str(), nullptr, 16)));
+    if (!HexDecode(digits.data(), digits.size(), out)) {
+        throw std::invalid_argument("Invalid hex string: non-hex character");
     }
     return bytes;
 }
@@ -0,0 +1,334 @@
+#include "sha256.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_HAVE_X86 1
+#else
+#define SHA256_HAVE_X86 0
+#endif
+
+static constexpr uint32_t INITIAL_STATE[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                              0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+static constexpr uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static uint32_t ReadBE32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static void WriteBE32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+static uint32_t Rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+// a message of len bytes is its full 64 byte blocks plus one or two padded tail blocks
+static size_t TailBlocks(size_t len) { return (len % 64) + 9 <= 64 ? 1 : 2; }
+
+// copies the partial last block of a message into tail and appends the padding and bit length
+static void BuildTail(const uint8_t* msg, size_t len, uint8_t* tail) {
+    size_t rem = len % 64;
+    size_t tailLen = 64 * TailBlocks(len);
+
+    if (rem > 0) std::memcpy(tail, msg + len - rem, rem);
+    tail[rem] = 0x80;
+    std::memset(tail + rem + 1, 0, tailLen - rem - 1);
+
+    uint64_t bits = static_cast<uint64_t>(len) * 8;
+    WriteBE32(tail + tailLen - 8, static_cast<uint32_t>(bits >> 32));
+    WriteBE32(tail + tailLen - 4, static_cast<uint32_t>(bits));
+}
+
+// one-way kernels compress blocks consecutive 64 byte blocks into a single state
+using TransformFn = void (*)(uint32_t* state, const uint8_t* data, size_t blocks);
+
+static void TransformScalar(uint32_t* state, const uint8_t* data, size_t blocks) {
+    for (; blocks > 0; blocks--, data += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) w[i] = ReadBE32(data + 4 * i);
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) +
+                          K[i] + w[i];
+            uint32_t t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+static void HashOne(TransformFn transform, const uint8_t* msg, size_t len, uint8_t* out) {
+    uint32_t state[8];
+    std::copy(INITIAL_STATE, INITIAL_STATE + 8, state);
+
+    transform(state, msg, len / 64);
+
+    uint8_t tail[128];
+    BuildTail(msg, len, tail);
+    transform(state, tail, TailBlocks(len));
+
+    for (int i = 0; i < 8; i++) WriteBE32(out + 4 * i, state[i]);
+}
+
+static void BatchOneWay(TransformFn transform, const uint8_t* in, size_t len, size_t count,
+                        uint8_t* out) {
+    for (size_t i = 0; i < count; i++) {
+        HashOne(transform, in + i * len, len, out + i * 32);
+    }
+}
+
+static void BatchScalar(const uint8_t* in, size_t len, size_t count, uint8_t* out) {
+    BatchOneWay(TransformScalar, in, len, count, out);
+}
+
+#if SHA256_HAVE_X86
+// the SHA-NI instructions keep the state as ABEF/CDGH register pairs
+__attribute__((target("sha,sse4.1"))) static void TransformSHANI(uint32_t* state,
+                                                                 const uint8_t* data,
+                                                                 size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp =
+        _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+    __m128i state1 =
+        _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; blocks > 0; blocks--, data += 64) {
+        __m128i abefSave = state0;
+        __m128i cdghSave = state1;
+
+        // msg[r % 4] holds schedule words 4r .. 4r+3 for the current group of four rounds
+        __m128i msg[4];
+        for (int i = 0; i < 4; i++) {
+            msg[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), byteSwap);
+        }
+
+        for (int r = 0; r < 16; r++) {
+            if (r >= 4) {
+                __m128i w = _mm_sha256msg1_epu32(msg[r & 3], msg[(r + 1) & 3]);
+                w = _mm_add_epi32(w, _mm_alignr_epi8(msg[(r + 3) & 3], msg[(r + 2) & 3], 4));
+                msg[r & 3] = _mm_sha256msg2_epu32(w, msg[(r + 3) & 3]);
+            }
+
+            __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(K + 4 * r));
+            __m128i wk = _mm_add_epi32(msg[r & 3], k);
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+static void BatchSHANI(const uint8_t* in, size_t len, size_t count, uint8_t* out) {
+    BatchOneWay(TransformSHANI, in, len, count, out);
+}
+
+// eight independent messages, one per 32-bit lane
+__attribute__((target("avx2"))) static __m256i Rotr8(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// compresses one block per lane, states holds 8 words per lane back to back
+__attribute__((target("avx2"))) static void Transform8AVX2(uint32_t* states,
+                                                           const uint8_t* const* blocks) {
+    __m256i w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = _mm256_setr_epi32(
+            static_cast<int>(ReadBE32(blocks[0] + 4 * i)),
+            static_cast<int>(ReadBE32(blocks[1] + 4 * i)),
+            static_cast<int>(ReadBE32(blocks[2] + 4 * i)),
+            static_cast<int>(ReadBE32(blocks[3] + 4 * i)),
+            static_cast<int>(ReadBE32(blocks[4] + 4 * i)),
+            static_cast<int>(ReadBE32(blocks[5] + 4 * i)),
+            static_cast<int>(ReadBE32(blocks[6] + 4 * i)),
+            static_cast<int>(ReadBE32(blocks[7] + 4 * i)));
+    }
+    for (int i = 16; i < 64; i++) {
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(Rotr8(w[i - 15], 7), Rotr8(w[i - 15], 18)),
+                                      _mm256_srli_epi32(w[i - 15], 3));
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(Rotr8(w[i - 2], 17), Rotr8(w[i - 2], 19)),
+                                      _mm256_srli_epi32(w[i - 2], 10));
+        w[i] = _mm256_add_epi32(_mm256_add_epi32(w[i - 16], s0), _mm256_add_epi32(w[i - 7], s1));
+    }
+
+    // gather word j of every lane into one vector
+    __m256i initial[8];
+    for (int j = 0; j < 8; j++) {
+        initial[j] = _mm256_setr_epi32(
+            static_cast<int>(states[j]), static_cast<int>(states[8 + j]),
+            static_cast<int>(states[16 + j]), static_cast<int>(states[24 + j]),
+            static_cast<int>(states[32 + j]), static_cast<int>(states[40 + j]),
+            static_cast<int>(states[48 + j]), static_cast<int>(states[56 + j]));
+    }
+
+    __m256i a = initial[0], b = initial[1], c = initial[2], d = initial[3];
+    __m256i e = initial[4], f = initial[5], g = initial[6], h = initial[7];
+
+    for (int i = 0; i < 64; i++) {
+        __m256i bigSigma1 =
+            _mm256_xor_si256(_mm256_xor_si256(Rotr8(e, 6), Rotr8(e, 11)), Rotr8(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(
+            _mm256_add_epi32(_mm256_add_epi32(h, bigSigma1), _mm256_add_epi32(ch, w[i])),
+            _mm256_set1_epi32(static_cast<int>(K[i])));
+        __m256i bigSigma0 =
+            _mm256_xor_si256(_mm256_xor_si256(Rotr8(a, 2), Rotr8(a, 13)), Rotr8(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b),
+                                      _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i t2 = _mm256_add_epi32(bigSigma0, maj);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    __m256i result[8] = {a, b, c, d, e, f, g, h};
+    for (int j = 0; j < 8; j++) {
+        alignas(32) uint32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes),
+                           _mm256_add_epi32(result[j], initial[j]));
+        for (int lane = 0; lane < 8; lane++) states[lane * 8 + j] = lanes[lane];
+    }
+}
+
+static void BatchAVX2(const uint8_t* in, size_t len, size_t count, uint8_t* out) {
+    size_t fullBlocks = len / 64;
+    size_t totalBlocks = fullBlocks + TailBlocks(len);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint32_t states[64];
+        uint8_t tails[8][128];
+        for (int lane = 0; lane < 8; lane++) {
+            std::copy(INITIAL_STATE, INITIAL_STATE + 8, states + lane * 8);
+            BuildTail(in + (i + lane) * len, len, tails[lane]);
+        }
+
+        const uint8_t* blocks[8];
+        for (size_t blk = 0; blk < totalBlocks; blk++) {
+            for (int lane = 0; lane < 8; lane++) {
+                blocks[lane] = blk < fullBlocks ? in + (i + lane) * len + blk * 64
+                                                : tails[lane] + (blk - fullBlocks) * 64;
+            }
+            Transform8AVX2(states, blocks);
+        }
+
+        for (int lane = 0; lane < 8; lane++) {
+            for (int j = 0; j < 8; j++) {
+                WriteBE32(out + (i + lane) * 32 + 4 * j, states[lane * 8 + j]);
+            }
+        }
+    }
+
+    // fewer than eight messages left, not worth a vector pass
+    BatchOneWay(TransformScalar, in + i * len, len, count - i, out + i * 32);
+}
+
+static bool CpuHasSHANI() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    __builtin_cpu_init();
+    return (ebx & (1u << 29)) != 0 && __builtin_cpu_supports("sse4.1");
+}
+
+static bool CpuHasAVX2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+using BatchFn = void (*)(const uint8_t*, size_t, size_t, uint8_t*);
+
+struct BatchKernel {
+        const char* name;
+        BatchFn fn;
+};
+
+// SHA-NI beats the 8-way AVX2 path per message, so it wins when both are present
+static const BatchKernel& SelectKernel() {
+#if SHA256_HAVE_X86
+    static const BatchKernel kernel = CpuHasSHANI()  ? BatchKernel{"shani", BatchSHANI}
+                                      : CpuHasAVX2() ? BatchKernel{"avx2", BatchAVX2}
+                                                     : BatchKernel{"generic", BatchScalar};
+#else
+    static const BatchKernel kernel = {"generic", BatchScalar};
+#endif
+    return kernel;
+}
+
+void SHA256Batch(const uint8_t* in, size_t len, size_t count, uint8_t* out) {
+    if (count == 0) return;
+    SelectKernel().fn(in, len, count, out);
+}
+
+const char* SHA256BatchKernel() { return SelectKernel().name; }
+
+bool SHA256BatchWithKernel(const char* kernel, const uint8_t* in, size_t len, size_t count,
+                           uint8_t* out) {
+    BatchFn fn = nullptr;
+    if (std::strcmp(kernel, "generic") == 0) fn = BatchScalar;
+#if SHA256_HAVE_X86
+    if (std::strcmp(kernel, "shani") == 0 && CpuHasSHANI()) fn = BatchSHANI;
+    if (std::strcmp(kernel, "avx2") == 0 && CpuHasAVX2()) fn = BatchAVX2;
+#endif
+    if (!fn) return false;
+
+    if (count > 0) fn(in, len, count, out);
+    return true;
+}
\ No newline at end of file
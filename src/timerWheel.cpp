@@ -0,0 +1,170 @@
+#include "timerWheel.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+static constexpr std::chrono::milliseconds TICK(TIMER_WHEEL_TICK_MS);
+
+TimerWheel::TimerWheel() : start(Clock::now()) {
+    thread = std::thread([this] { Run(); });
+}
+
+TimerWheel::~TimerWheel() { Stop(); }
+
+uint64_t TimerWheel::TickAt(Clock::time_point when) const {
+    if (when <= start) return 0;
+    return static_cast<uint64_t>((when - start + TICK - Clock::duration(1)) / TICK);
+}
+
+uint64_t TimerWheel::DueTick(Clock::time_point when) const {
+    if (when <= start) return 0;
+    return static_cast<uint64_t>((when - start) / TICK);
+}
+
+void TimerWheel::Insert(TimerId id, uint64_t deadlineTick) {
+    deadlineTick = std::max(deadlineTick, currentTick);
+    uint64_t delta = deadlineTick - currentTick;
+
+    for (size_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t shift = TIMER_WHEEL_SLOT_BITS * level;
+        uint64_t span = uint64_t{1} << (shift + TIMER_WHEEL_SLOT_BITS);
+        if (delta < span) {
+            slots[level][(deadlineTick >> shift) & SLOT_MASK].push_back(id);
+            return;
+        }
+    }
+
+    // beyond the last level, it waits in the furthest slot and is refiled from there
+    uint64_t shift = TIMER_WHEEL_SLOT_BITS * (TIMER_WHEEL_LEVELS - 1);
+    uint64_t furthest = currentTick + (uint64_t{1} << (shift + TIMER_WHEEL_SLOT_BITS)) - 1;
+    slots[TIMER_WHEEL_LEVELS - 1][(furthest >> shift) & SLOT_MASK].push_back(id);
+}
+
+void TimerWheel::Cascade(size_t level) {
+    uint64_t shift = TIMER_WHEEL_SLOT_BITS * level;
+    std::vector<TimerId> ids = std::move(slots[level][(currentTick >> shift) & SLOT_MASK]);
+    slots[level][(currentTick >> shift) & SLOT_MASK].clear();
+
+    for (TimerId id : ids) {
+        auto it = timers.find(id);
+        if (it != timers.end()) Insert(id, it->second.deadlineTick);
+    }
+}
+
+uint64_t TimerWheel::TicksToNextSlot() const {
+    for (uint64_t i = 0; i < SLOTS; i++) {
+        uint64_t tick = currentTick + i;
+        if (i > 0 && (tick & SLOT_MASK) == 0) return i;
+        if (!slots[0][tick & SLOT_MASK].empty()) return i;
+    }
+    return SLOTS;
+}
+
+void TimerWheel::Run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopping) {
+        if (timers.empty()) {
+            cv.wait(lock, [this] { return stopping || !timers.empty(); });
+            continue;
+        }
+
+        if (currentTick > DueTick(Clock::now())) {
+            auto wake = start + TICK * static_cast<int64_t>(currentTick + TicksToNextSlot());
+            cv.wait_until(lock, wake);
+            continue;
+        }
+
+        // the levels above refile the timers of the block of ticks starting here
+        for (size_t level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            uint64_t lowerMask = (uint64_t{1} << (TIMER_WHEEL_SLOT_BITS * level)) - 1;
+            if ((currentTick & lowerMask) == 0) Cascade(level);
+        }
+
+        std::vector<TimerId> due = std::move(slots[0][currentTick & SLOT_MASK]);
+        slots[0][currentTick & SLOT_MASK].clear();
+        currentTick++;
+
+        for (TimerId id : due) {
+            auto it = timers.find(id);
+            if (it == timers.end()) continue;
+
+            std::function<void()> callback = std::move(it->second.callback);
+            Clock::duration interval = it->second.interval;
+            if (interval == Clock::duration::zero()) timers.erase(it);
+
+            lock.unlock();
+            try {
+                callback();
+            } catch (const std::exception& e) {
+                std::cerr << "[timer] Timer callback failed: " << e.what() << std::endl;
+            }
+            lock.lock();
+
+            if (interval == Clock::duration::zero()) continue;
+
+            // cancelled while it ran
+            it = timers.find(id);
+            if (it == timers.end()) continue;
+
+            it->second.callback = std::move(callback);
+            it->second.deadlineTick = TickAt(Clock::now() + interval);
+            Insert(id, it->second.deadlineTick);
+        }
+    }
+}
+
+TimerId TimerWheel::Add(Clock::duration delay, Clock::duration interval,
+                       std::function<void()> callback) {
+    TimerId id;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        id = nextId++;
+        if (stopping) return id;
+
+        auto now = Clock::now();
+        // nothing is pending, so there is nothing to fire on the way to the present
+        if (timers.empty()) currentTick = std::max(currentTick, DueTick(now));
+
+        uint64_t deadlineTick = TickAt(now + delay);
+        timers.emplace(id, Timer{deadlineTick, interval, std::move(callback)});
+        Insert(id, deadlineTick);
+    }
+    cv.notify_one();
+    return id;
+}
+
+TimerId TimerWheel::Schedule(Clock::duration delay, std::function<void()> callback) {
+    return Add(delay, Clock::duration::zero(), std::move(callback));
+}
+
+TimerId TimerWheel::ScheduleEvery(Clock::duration interval, std::function<void()> callback) {
+    // a zero interval would mark it one shot
+    interval = std::max(interval, Clock::duration(TICK));
+    return Add(interval, interval, std::move(callback));
+}
+
+void TimerWheel::Cancel(TimerId id) {
+    // its id stays in a slot until that slot comes up and finds nothing
+    std::lock_guard<std::mutex> lock(mtx);
+    timers.erase(id);
+}
+
+size_t TimerWheel::Size() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return timers.size();
+}
+
+void TimerWheel::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+        timers.clear();
+    }
+    cv.notify_one();
+
+    // a callback stopping the wheel cannot join its own thread
+    if (thread.joinable() && thread.get_id() != std::this_thread::get_id()) {
+        thread.join();
+    }
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <openssl/evp.h>
 #include <openssl/params.h>
 
+#include <algorithm>
 #include <memory>
 #include <random>
 #include <stdexcept>
@@ -19,17 +20,27 @@ using EVP_MD_CTX_ptr = std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>;
 using EVP_PKEY_ptr = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>;
 using EVP_PKEY_CTX_ptr = std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)>;
 
-Transaction::Transaction(const std::vector<uint8_t>& id, const std::vector<TransactionInput>& vin,
+Transaction::Transaction(const Hash256& id, const std::vector<TransactionInput>& vin,
                          const std::vector<TransactionOutput>& vout)
     : id(id), vin(vin), vout(vout) {}
 
 bool Transaction::IsCoinbase() const {
-    return vin.size() == 1 && vin[0].GetTxid().empty() && vin[0].GetVout() == -1;
+    return vin.size() == 1 && vin[0].GetTxid().IsNull() && vin[0].GetVout() == -1;
 }
 
-std::vector<uint8_t> Transaction::Hash() const { return SHA256Hash(Serialize()); }
+Hash256 Transaction::Hash() const {
+    if (wire) return id;
+    return SHA256Digest(Serialize());
+}
+
+void Transaction::UpdateCache() {
+    wire.reset();
+    auto bytes = std::make_shared<const std::vector<uint8_t>>(Serialize());
+    id = SHA256Digest(*bytes);
+    wire = std::move(bytes);
+}
 
-void Transaction::Sign(EVP_PKEY* privKey, const std::map<std::string, Transaction>& prevTXs) {
+void Transaction::Sign(EVP_PKEY* privKey, const std::unordered_map<Hash256, Transaction>& prevTXs) {
     if (IsCoinbase()) {
         return;
     }
@@ -38,10 +49,13 @@ void Transaction::Sign(EVP_PKEY* privKey, const std::map<std::string, Transactio
         throw std::runtime_error("Cannot sign transaction: private key is null");
     }
 
+    // signatures change the wire bytes, the caller refreshes the id afterwards
+    wire.reset();
+
     // Verify all previous transactions exist
     for (const auto& vin : vin) {
-        std::string txID = ByteArrayToHexString(vin.GetTxid());
-        if (prevTXs.find(txID) == prevTXs.end() || prevTXs.at(txID).GetID().empty()) {
+        auto it = prevTXs.find(vin.GetTxid());
+        if (it == prevTXs.end() || it->second.GetID().IsNull()) {
             throw std::runtime_error("Previous transaction is not correct");
         }
     }
@@ -50,8 +64,7 @@ void Transaction::Sign(EVP_PKEY* privKey, const std::map<std::string, Transactio
 
     // signing each input
     for (size_t inID = 0; inID < txCopy.vin.size(); inID++) {
-        std::string txID = ByteArrayToHexString(txCopy.vin[inID].GetTxid());
-        const Transaction& prevTx = prevTXs.at(txID);
+        const Transaction& prevTx = prevTXs.at(txCopy.vin[inID].GetTxid());
 
         txCopy.vin[inID].signature = {};
 
@@ -95,15 +108,15 @@ void Transaction::Sign(EVP_PKEY* privKey, const std::map<std::string, Transactio
     }
 }
 
-bool Transaction::Verify(const std::map<std::string, Transaction>& prevTXs) const {
+bool Transaction::Verify(const std::unordered_map<Hash256, Transaction>& prevTXs) const {
     if (IsCoinbase()) {
         return true;
     }
 
     // verify all previous transactions exist
     for (const auto& vin : vin) {
-        std::string txID = ByteArrayToHexString(vin.GetTxid());
-        if (prevTXs.find(txID) == prevTXs.end() || prevTXs.at(txID).GetID().empty()) {
+        auto it = prevTXs.find(vin.GetTxid());
+        if (it == prevTXs.end() || it->second.GetID().IsNull()) {
             throw std::runtime_error("Previous transaction is not correct");
         }
     }
@@ -112,8 +125,7 @@ bool Transaction::Verify(const std::map<std::string, Transaction>& prevTXs) cons
 
     // verify each tx
     for (size_t inID = 0; inID < vin.size(); inID++) {
-        std::string txID = ByteArrayToHexString(txCopy.vin[inID].GetTxid());
-        const Transaction& prevTx = prevTXs.at(txID);
+        const Transaction& prevTx = prevTXs.at(txCopy.vin[inID].GetTxid());
 
         txCopy.vin[inID].signature = {};
 
@@ -195,12 +207,12 @@ Transaction Transaction::TrimmedCopy() const {
     return Transaction(id, inputs, outputs);
 }
 
-int64_t Transaction::CalculateFee(const std::map<std::string, Transaction>& prevTXs) const {
+int64_t Transaction::CalculateFee(const std::unordered_map<Hash256, Transaction>& prevTXs) const {
     if (IsCoinbase()) return 0;
 
     int64_t inputSum = 0;
     for (const auto& input : vin) {
-        const auto& prevTx = prevTXs.at(ByteArrayToHexString(input.GetTxid()));
+        const auto& prevTx = prevTXs.at(input.GetTxid());
         int voutIdx = input.GetVout();
         if (voutIdx < 0 || voutIdx >= static_cast<int>(prevTx.GetVout().size())) {
             throw std::runtime_error("CalculateFee: input references invalid output index " +
@@ -240,7 +252,7 @@ Transaction Transaction::NewCoinbaseTX(const std::string& to, int32_t height, in
     TransactionOutput txout = NewTXOutput(Consensus::GetBlockSubsidy(height) + fees, to);
 
     Transaction tx({}, {txin}, {txout});
-    tx.id = tx.Hash();
+    tx.UpdateCache();
 
     return tx;
 }
@@ -270,10 +282,8 @@ Transaction Transaction::NewUTXOTransaction(Wallet* wallet, Blockchain* bc, cons
 
     // build a list of inputs
     for (const auto& [txid, outs] : validOutputs) {
-        std::vector<uint8_t> txID = HexStringToByteArray(txid);
-
         for (int out : outs) {
-            TransactionInput input(txID, out, {}, wallet->GetPublicKey());
+            TransactionInput input(txid, out, {}, wallet->GetPublicKey());
             inputs.push_back(input);
         }
     }
@@ -285,76 +295,88 @@ Transaction Transaction::NewUTXOTransaction(Wallet* wallet, Blockchain* bc, cons
     }
 
     Transaction tx({}, inputs, outputs);
-    tx.id = tx.Hash();
+    tx.UpdateCache();
     bc->SignTransaction(&tx, wallet);
-    tx.id = tx.Hash();
+    tx.UpdateCache();
 
     return tx;
 }
 
-std::vector<uint8_t> Transaction::Serialize() const {
-    std::vector<uint8_t> result;
+size_t Transaction::SerializedSize() const {
+    if (wire) return wire->size();
+
+    size_t size = 4 + 4;
+    for (const auto& input : vin) size += input.SerializedSize();
+    for (const auto& output : vout) size += output.SerializedSize();
+    return size;
+}
+
+void Transaction::Serialize(ByteWriter& writer) const {
+    if (wire) {
+        writer.WriteBytes(*wire);
+        return;
+    }
 
     // number of inputs (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(vin.size()));
+    writer.WriteUint32(static_cast<uint32_t>(vin.size()));
 
-    // each input
+    // each input (variable bytes)
     for (const auto& input : vin) {
-        std::vector<uint8_t> inputSerialized = input.Serialize();
-
-        // inputs (variable bytes)
-        result.insert(result.end(), inputSerialized.begin(), inputSerialized.end());
+        input.Serialize(writer);
     }
 
     // number of outputs (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(vout.size()));
+    writer.WriteUint32(static_cast<uint32_t>(vout.size()));
 
-    // each output
+    // each output (variable bytes)
     for (const auto& output : vout) {
-        std::vector<uint8_t> outputSerialized = output.Serialize();
-
-        // output (variable bytes)
-        result.insert(result.end(), outputSerialized.begin(), outputSerialized.end());
+        output.Serialize(writer);
     }
+}
 
-    return result;
+std::vector<uint8_t> Transaction::Serialize() const {
+    if (wire) return *wire;
+
+    ByteWriter writer(SerializedSize());
+    Serialize(writer);
+    return writer.Release();
 }
 
-Transaction Transaction::Deserialize(const std::vector<uint8_t>& data) {
+Transaction Transaction::Deserialize(ByteReader& reader) {
     Transaction tx;
-    size_t offset = 0;
-
-    if (data.size() < 8) {
-        throw std::runtime_error("Transaction data too small to deserialize");
-    }
+    size_t start = reader.Position();
 
     // number of inputs (4 bytes)
-    uint32_t vinSize = ReadUint32(data, offset);
-    offset += 4;
+    uint32_t vinSize = reader.ReadUint32();
 
-    // each input
+    // each input (variable bytes), every input takes at least 16 bytes
+    tx.vin.reserve(std::min<size_t>(vinSize, reader.Remaining() / 16));
     for (uint32_t i = 0; i < vinSize; i++) {
-        auto [input, bytesRead] = TransactionInput::Deserialize(data, offset);
-
-        // input (variable bytes)
-        tx.vin.push_back(input);
-        offset += bytesRead;
+        tx.vin.push_back(TransactionInput::Deserialize(reader));
     }
 
     // number of outputs (4 bytes)
-    uint32_t voutSize = ReadUint32(data, offset);
-    offset += 4;
+    uint32_t voutSize = reader.ReadUint32();
 
-    // each output
+    // each output (variable bytes), every output takes at least 12 bytes
+    tx.vout.reserve(std::min<size_t>(voutSize, reader.Remaining() / 12));
     for (uint32_t i = 0; i < voutSize; i++) {
-        auto [output, bytesRead] = TransactionOutput::Deserialize(data, offset);
-
-        // output (variable bytes)
-        tx.vout.push_back(output);
-        offset += bytesRead;
+        tx.vout.push_back(TransactionOutput::Deserialize(reader));
     }
 
-    tx.id = tx.Hash();
+    // keep the bytes we parsed so the id and later relays need no re-serialization
+    std::span<const uint8_t> bytes = reader.ConsumedSince(start);
+    tx.wire = std::make_shared<const std::vector<uint8_t>>(bytes.begin(), bytes.end());
+    tx.id = SHA256Digest(bytes);
 
     return tx;
+}
+
+Transaction Transaction::Deserialize(std::span<const uint8_t> data) {
+    if (data.size() < 8) {
+        throw std::runtime_error("Transaction data too small to deserialize");
+    }
+
+    ByteReader reader(data);
+    return Deserialize(reader);
 }
\ No newline at end of file
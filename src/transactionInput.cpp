@@ -2,10 +2,9 @@
 
 #include <stdexcept>
 
-#include "serialization.h"
 #include "wallet.h"
 
-TransactionInput::TransactionInput(const std::vector<uint8_t>& txid, int vout,
+TransactionInput::TransactionInput(const Hash256& txid, int vout,
                                    const std::vector<uint8_t>& signature,
                                    const std::vector<uint8_t>& pubKey)
     : txid(txid), vout(vout), signature(signature), pubKey(pubKey) {}
@@ -15,76 +14,71 @@ bool TransactionInput::UsesKey(const std::vector<uint8_t>& pubKeyHash) const {
     return lockingHash == pubKeyHash;
 }
 
-std::vector<uint8_t> TransactionInput::Serialize() const {
-    std::vector<uint8_t> result;
+size_t TransactionInput::SerializedSize() const {
+    return 4 + (txid.IsNull() ? 0 : HASH256_SIZE) + 4 + 4 + signature.size() + 4 + pubKey.size();
+}
 
-    // txid size (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(txid.size()));
+void TransactionInput::Serialize(ByteWriter& writer) const {
+    // txid size (4 bytes), the coinbase input has no txid so it is written as size 0
+    if (txid.IsNull()) {
+        writer.WriteUint32(0);
+    } else {
+        writer.WriteUint32(static_cast<uint32_t>(txid.size()));
 
-    // txid
-    result.insert(result.end(), txid.begin(), txid.end());
+        // txid (32 bytes)
+        writer.WriteHash256(txid);
+    }
 
     // vout (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(vout));
+    writer.WriteUint32(static_cast<uint32_t>(vout));
 
     // signature size (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(signature.size()));
+    writer.WriteUint32(static_cast<uint32_t>(signature.size()));
 
     // signature (variable bytes)
-    result.insert(result.end(), signature.begin(), signature.end());
+    writer.WriteBytes(signature);
 
     // pubKey size (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(pubKey.size()));
+    writer.WriteUint32(static_cast<uint32_t>(pubKey.size()));
 
     // pubKey (variable bytes)
-    result.insert(result.end(), pubKey.begin(), pubKey.end());
-
-    return result;
+    writer.WriteBytes(pubKey);
 }
 
-std::pair<TransactionInput, size_t> TransactionInput::Deserialize(const std::vector<uint8_t>& data,
-                                                                  size_t offset) {
+TransactionInput TransactionInput::Deserialize(ByteReader& reader) {
     TransactionInput input;
-    size_t startOffset = offset;
 
     // txid size (4 bytes)
-    uint32_t txidSize = ReadUint32(data, offset);
-    offset += 4;
+    uint32_t txidSize = reader.ReadUint32();
 
-    // txid
-    if (offset + txidSize > data.size()) {
-        throw std::runtime_error("TransactionInput data truncated at txid");
+    // txid (0 or 32 bytes)
+    if (txidSize != 0 && txidSize != HASH256_SIZE) {
+        throw std::runtime_error("TransactionInput has invalid txid size " +
+                                 std::to_string(txidSize));
+    }
+    if (txidSize == HASH256_SIZE) {
+        input.txid = reader.ReadHash256();
+
+        // a null txid must be encoded as size 0, otherwise the txid would not round trip
+        if (input.txid.IsNull()) {
+            throw std::runtime_error("TransactionInput has non-canonical null txid");
+        }
     }
-    input.txid = std::vector<uint8_t>(data.begin() + offset, data.begin() + offset + txidSize);
-    offset += txidSize;
 
     // vout (4 bytes)
-    input.vout = static_cast<int>(ReadUint32(data, offset));
-    offset += 4;
+    input.vout = static_cast<int>(reader.ReadUint32());
 
     // signature size (4 bytes)
-    uint32_t signatureSize = ReadUint32(data, offset);
-    offset += 4;
+    uint32_t signatureSize = reader.ReadUint32();
 
     // signature (variable bytes)
-    if (offset + signatureSize > data.size()) {
-        throw std::runtime_error("TransactionInput data truncated at signature");
-    }
-    input.signature =
-        std::vector<uint8_t>(data.begin() + offset, data.begin() + offset + signatureSize);
-    offset += signatureSize;
+    input.signature = reader.ReadByteVector(signatureSize);
 
     // pubKey size (4 bytes)
-    uint32_t pubKeySize = ReadUint32(data, offset);
-    offset += 4;
+    uint32_t pubKeySize = reader.ReadUint32();
 
     // pubKey (variable bytes)
-    if (offset + pubKeySize > data.size()) {
-        throw std::runtime_error("TransactionInput data truncated at pubKey");
-    }
-    input.pubKey = std::vector<uint8_t>(data.begin() + offset, data.begin() + offset + pubKeySize);
-    offset += pubKeySize;
+    input.pubKey = reader.ReadByteVector(pubKeySize);
 
-    size_t bytesRead = offset - startOffset;
-    return {input, bytesRead};
+    return input;
 }
\ No newline at end of file
@@ -24,48 +24,34 @@ bool TransactionOutput::IsLockedWithKey(const std::vector<uint8_t>& pubKeyHash)
     return this->pubKeyHash == pubKeyHash;
 }
 
-std::vector<uint8_t> TransactionOutput::Serialize() const {
-    std::vector<uint8_t> result;
-
+void TransactionOutput::Serialize(ByteWriter& writer) const {
     // value (8 bytes)
-    WriteUint64(result, static_cast<uint64_t>(value));
+    writer.WriteUint64(static_cast<uint64_t>(value));
 
     // pubKeyHash size (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(pubKeyHash.size()));
+    writer.WriteUint32(static_cast<uint32_t>(pubKeyHash.size()));
 
     // pubKeyHash (variable bytes)
-    result.insert(result.end(), pubKeyHash.begin(), pubKeyHash.end());
-
-    return result;
+    writer.WriteBytes(pubKeyHash);
 }
 
-std::pair<TransactionOutput, size_t> TransactionOutput::Deserialize(
-    const std::vector<uint8_t>& data, size_t offset) {
+TransactionOutput TransactionOutput::Deserialize(ByteReader& reader) {
     TransactionOutput output;
-    size_t startOffset = offset;
 
     // value (8 bytes)
-    output.value = static_cast<int64_t>(ReadUint64(data, offset));
+    output.value = static_cast<int64_t>(reader.ReadUint64());
     if (output.value < 0) {
         throw std::runtime_error("Deserialized transaction output has negative value: " +
                                  std::to_string(output.value));
     }
-    offset += 8;
 
     // pubKeyHash size (4 bytes)
-    uint32_t pubKeyHashSize = ReadUint32(data, offset);
-    offset += 4;
+    uint32_t pubKeyHashSize = reader.ReadUint32();
 
     // pubKeyHash (variable bytes)
-    if (offset + pubKeyHashSize > data.size()) {
-        throw std::runtime_error("TransactionOutput data truncated at pubKeyHash");
-    }
-    output.pubKeyHash =
-        std::vector<uint8_t>(data.begin() + offset, data.begin() + offset + pubKeyHashSize);
-    offset += pubKeyHashSize;
+    output.pubKeyHash = reader.ReadByteVector(pubKeyHashSize);
 
-    size_t bytesRead = offset - startOffset;
-    return {output, bytesRead};
+    return output;
 }
 
 // factory function to create a new transaction output
@@ -76,62 +62,58 @@ TransactionOutput NewTXOutput(int64_t value, const std::string& address) {
 }
 
 std::vector<uint8_t> TXOutputs::Serialize() const {
-    std::vector<uint8_t> result;
+    size_t size = 1 + 4 + 4;
+    for (const auto& [_, output] : outputs) {
+        size += 4 + output.SerializedSize();
+    }
+
+    ByteWriter writer(size);
 
     // coinbase flag (1 byte)
-    result.push_back(isCoinbase ? 0x01 : 0x00);
+    writer.WriteUint8(isCoinbase ? 0x01 : 0x00);
 
     // block height this transaction was confirmed at (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(blockHeight));
+    writer.WriteUint32(static_cast<uint32_t>(blockHeight));
 
     // number of outputs (4 bytes)
-    WriteUint32(result, static_cast<uint32_t>(outputs.size()));
+    writer.WriteUint32(static_cast<uint32_t>(outputs.size()));
 
     // each (original index, output) pair
     for (const auto& [origIdx, output] : outputs) {
         // original output index (4 bytes)
-        WriteUint32(result, static_cast<uint32_t>(origIdx));
+        writer.WriteUint32(static_cast<uint32_t>(origIdx));
 
-        std::vector<uint8_t> outputSerialized = output.Serialize();
-        result.insert(result.end(), outputSerialized.begin(), outputSerialized.end());
+        output.Serialize(writer);
     }
 
-    return result;
+    return writer.Release();
 }
 
-TXOutputs TXOutputs::Deserialize(const std::vector<uint8_t>& data) {
+TXOutputs TXOutputs::Deserialize(std::span<const uint8_t> data) {
     TXOutputs txOutputs;
-    size_t offset = 0;
 
     // isCoinbase(1) + blockHeight(4) + outputCount(4) = 9
     if (data.size() < 9) {
         throw std::runtime_error("TXOutputs data too small to deserialize");
     }
 
+    ByteReader reader(data);
+
     // coinbase flag (1 byte)
-    txOutputs.isCoinbase = (data[offset] == 0x01);
-    offset += 1;
+    txOutputs.isCoinbase = (reader.ReadUint8() == 0x01);
 
     // block height (4 bytes)
-    txOutputs.blockHeight = static_cast<int32_t>(ReadUint32(data, offset));
-    offset += 4;
+    txOutputs.blockHeight = static_cast<int32_t>(reader.ReadUint32());
 
     // number of outputs (4 bytes)
-    uint32_t outputCount = ReadUint32(data, offset);
-    offset += 4;
+    uint32_t outputCount = reader.ReadUint32();
 
     // each (original index, output) pair
     for (uint32_t i = 0; i < outputCount; i++) {
         // original output index (4 bytes)
-        if (offset + 4 > data.size()) {
-            throw std::runtime_error("TXOutputs data truncated at output index");
-        }
-        int origIdx = static_cast<int>(ReadUint32(data, offset));
-        offset += 4;
-
-        auto [output, bytesRead] = TransactionOutput::Deserialize(data, offset);
-        txOutputs.outputs[origIdx] = output;
-        offset += bytesRead;
+        int origIdx = static_cast<int>(reader.ReadUint32());
+
+        txOutputs.outputs[origIdx] = TransactionOutput::Deserialize(reader);
     }
 
     return txOutputs;
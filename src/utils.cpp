@@ -3,3 +3,11 @@
 leveldb::Slice ByteArrayToSlice(const std::vector<uint8_t>& bytes) {
     return leveldb::Slice(reinterpret_cast<const char*>(bytes.data()), bytes.size());
 }
+
+leveldb::Slice ByteArrayToSlice(const Hash256& hash) {
+    return leveldb::Slice(reinterpret_cast<const char*>(hash.data()), hash.size());
+}
+
+std::span<const uint8_t> SliceToBytes(const leveldb::Slice& slice) {
+    return {reinterpret_cast<const uint8_t*>(slice.data()), slice.size()};
+}
\ No newline at end of file
@@ -32,9 +32,9 @@ UTXOSet::UTXOSet(Blockchain* bc) : blockchain(bc) {
     db.reset(rawDb);
 }
 
-std::pair<int64_t, std::map<std::string, std::vector<int>>> UTXOSet::FindSpendableOutputs(
+std::pair<int64_t, std::map<Hash256, std::vector<int>>> UTXOSet::FindSpendableOutputs(
     const std::vector<uint8_t>& pubKeyHash, int64_t amount) const {
-    std::map<std::string, std::vector<int>> unspentOutputs;
+    std::map<Hash256, std::vector<int>> unspentOutputs;
     int64_t accumulated = 0;
     bool found = false;
 
@@ -43,13 +43,12 @@ std::pair<int64_t, std::map<std::string, std::vector<int>>> UTXOSet::FindSpendab
     std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
 
     for (it->SeekToFirst(); it->Valid() && !found; it->Next()) {
-        std::string key = it->key().ToString();
-        std::string value = it->value().ToString();
+        leveldb::Slice key = it->key();
 
-        std::string txID = ByteArrayToHexString(std::vector<uint8_t>(key.begin(), key.end()));
+        Hash256 txID =
+            Hash256::FromBytes(reinterpret_cast<const uint8_t*>(key.data()), key.size());
 
-        std::vector<uint8_t> valueBytes(value.begin(), value.end());
-        TXOutputs outs = TXOutputs::Deserialize(valueBytes);
+        TXOutputs outs = TXOutputs::Deserialize(SliceToBytes(it->value()));
 
         // can't spend unless coinbase is mature
         if (outs.isCoinbase) {
@@ -87,11 +86,7 @@ std::vector<TransactionOutput> UTXOSet::FindUTXO(const std::vector<uint8_t>& pub
     std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
 
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string key = it->key().ToString();
-        std::string value = it->value().ToString();
-
-        std::vector<uint8_t> valueBytes(value.begin(), value.end());
-        TXOutputs outs = TXOutputs::Deserialize(valueBytes);
+        TXOutputs outs = TXOutputs::Deserialize(SliceToBytes(it->value()));
 
         // skip immature coinbase outputs
         if (outs.isCoinbase) {
@@ -131,6 +126,17 @@ int UTXOSet::CountTransactions() const {
     return counter;
 }
 
+bool UTXOSet::IsUnspent(const OutPoint& outpoint) const {
+    std::string valueStr;
+    leveldb::Status status =
+        db->Get(leveldb::ReadOptions(), ByteArrayToSlice(outpoint.txid), &valueStr);
+    if (status.IsNotFound()) return false;
+    if (!status.ok()) throw std::runtime_error("Error reading UTXO: " + status.ToString());
+
+    TXOutputs outs = TXOutputs::Deserialize(StringAsBytes(valueStr));
+    return outs.outputs.count(outpoint.vout) > 0;
+}
+
 void UTXOSet::Reindex() {
     // wipe the entire UTXO database
     std::vector<std::string> keysToDelete;
@@ -155,16 +161,15 @@ void UTXOSet::Reindex() {
     }
 
     // build new UTXO set from the blockchain
-    std::map<std::string, TXOutputs> UTXO = blockchain->FindUTXO();
+    std::map<Hash256, TXOutputs> UTXO = blockchain->FindUTXO();
 
     // write the new UTXO set, where the keys are raw txid bytes
     leveldb::WriteBatch newBatch;
 
     for (const auto& [txID, outs] : UTXO) {
-        std::vector<uint8_t> key = HexStringToByteArray(txID);
         std::vector<uint8_t> value = outs.Serialize();
 
-        newBatch.Put(ByteArrayToSlice(key), ByteArrayToSlice(value));
+        newBatch.Put(ByteArrayToSlice(txID), ByteArrayToSlice(value));
     }
 
     status = db->Write(leveldb::WriteOptions(), &newBatch);
@@ -182,15 +187,14 @@ void UTXOSet::Update(const Block& block) {
     for (const Transaction& tx : block.GetTransactions()) {
         if (!tx.IsCoinbase()) {
             for (const TransactionInput& vin : tx.GetVin()) {
-                std::vector<uint8_t> txid = vin.GetTxid();
+                const Hash256& txid = vin.GetTxid();
                 std::string valueStr;
 
                 leveldb::Status status =
                     db->Get(leveldb::ReadOptions(), ByteArrayToSlice(txid), &valueStr);
 
                 if (status.ok()) {
-                    std::vector<uint8_t> valueBytes(valueStr.begin(), valueStr.end());
-                    TXOutputs outs = TXOutputs::Deserialize(valueBytes);
+                    TXOutputs outs = TXOutputs::Deserialize(StringAsBytes(valueStr));
 
                     // erase the spent output by its original index
                     outs.outputs.erase(vin.GetVout());
@@ -219,7 +223,7 @@ void UTXOSet::Update(const Block& block) {
             newOutputs.outputs[static_cast<int>(i)] = vout[i];
         }
 
-        std::vector<uint8_t> txHash = tx.GetID();
+        const Hash256& txHash = tx.GetID();
         std::vector<uint8_t> serialized = newOutputs.Serialize();
         batch.Put(ByteArrayToSlice(txHash), ByteArrayToSlice(serialized));
     }
@@ -6,6 +6,7 @@
 #include <openssl/param_build.h>
 #include <openssl/params.h>
 
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 
@@ -88,7 +89,8 @@ std::vector<uint8_t> Wallet::GetAddress() const {
 }
 
 std::vector<uint8_t> Wallet::HashPubKey(const std::vector<uint8_t>& pubKey) {
-    return RIPEMD160Hash(SHA256Hash(pubKey));
+    Hash160 pubKeyHash = RIPEMD160Digest(SHA256Digest(pubKey).bytes);
+    return {pubKeyHash.begin(), pubKeyHash.end()};
 }
 
 // verify the creation of address using the checksum
@@ -106,26 +108,19 @@ bool Wallet::ValidateAddress(const std::string& address) {
         return false;
     }
 
-    // using actual address
-    std::vector<uint8_t> actualChecksum(decoded.end() - ADDRESS_CHECKSUM_LEN, decoded.end());
-    uint8_t version = decoded[0];
-    std::vector<uint8_t> pubKeyHash(decoded.begin() + 1, decoded.end() - ADDRESS_CHECKSUM_LEN);
-
-    // rebuilding address to checksum
-    std::vector<uint8_t> versionedPayload;
-    versionedPayload.push_back(version);
-    versionedPayload.insert(versionedPayload.end(), pubKeyHash.begin(), pubKeyHash.end());
-
+    // the checksum covers the version byte and pubKeyHash, which is everything before it
+    std::span<const uint8_t> versionedPayload(decoded.data(),
+                                              decoded.size() - ADDRESS_CHECKSUM_LEN);
     std::vector<uint8_t> targetChecksum = Checksum(versionedPayload);
 
-    return actualChecksum == targetChecksum;
+    return std::equal(targetChecksum.begin(), targetChecksum.end(),
+                      decoded.end() - ADDRESS_CHECKSUM_LEN);
 }
 
 // Calculates the checksum of an address
-std::vector<uint8_t> Wallet::Checksum(const std::vector<uint8_t>& payload) {
-    std::vector<uint8_t> firstHash = SHA256Hash(payload);
-    std::vector<uint8_t> secondHash = SHA256Hash(firstHash);
-    return std::vector<uint8_t>(secondHash.begin(), secondHash.begin() + ADDRESS_CHECKSUM_LEN);
+std::vector<uint8_t> Wallet::Checksum(std::span<const uint8_t> payload) {
+    Hash256 hash = SHA256DoubleDigest(payload);
+    return std::vector<uint8_t>(hash.begin(), hash.begin() + ADDRESS_CHECKSUM_LEN);
 }
 
 Wallet::Wallet(const std::vector<uint8_t>& privKeyBytes, const std::vector<uint8_t>& pubKeyBytes)
@@ -195,6 +190,7 @@ std::vector<uint8_t> Wallet::GetPrivateKeyBytes() const {
     return privKey;
 }
 
-void Wallet::SignTransaction(Transaction* tx, const std::map<std::string, Transaction>& prevTXs) {
+void Wallet::SignTransaction(Transaction* tx,
+                             const std::unordered_map<Hash256, Transaction>& prevTXs) {
     tx->Sign(privateKey.get(), prevTXs);
 }
\ No newline at end of file
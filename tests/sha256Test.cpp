@@ -0,0 +1,70 @@
+// checks every SHA256Batch kernel this cpu can run against OpenSSL
+// build from the repo root:
+//   g++ -std=c++20 -O2 -I include tests/sha256Test.cpp src/sha256.cpp -lcrypto
+
+#include <openssl/evp.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "sha256.h"
+
+// 64 byte merkle node pairs and 80 byte block headers, plus lengths around the padding edges
+static constexpr size_t MESSAGE_LENGTHS[] = {0, 1, 55, 56, 63, 64, 65, 80, 119, 120, 128, 200};
+
+// odd sizes and sizes just around the 8-way AVX2 groups, so the scalar remainder is covered
+static constexpr size_t BATCH_SIZES[] = {1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 33, 65};
+
+static const char* const KERNELS[] = {"shani", "avx2", "generic"};
+
+// returns the number of messages whose digest differs from OpenSSL
+static size_t CheckKernel(const char* kernel, std::mt19937& rng) {
+    size_t failures = 0;
+
+    for (size_t len : MESSAGE_LENGTHS) {
+        for (size_t count : BATCH_SIZES) {
+            std::vector<uint8_t> in(len * count);
+            for (uint8_t& byte : in) byte = static_cast<uint8_t>(rng());
+
+            std::vector<uint8_t> out(32 * count);
+            SHA256BatchWithKernel(kernel, in.data(), len, count, out.data());
+
+            for (size_t i = 0; i < count; i++) {
+                uint8_t expected[32];
+                EVP_Digest(in.data() + i * len, len, expected, nullptr, EVP_sha256(), nullptr);
+                if (std::memcmp(out.data() + 32 * i, expected, 32) != 0) {
+                    std::cout << "[sha256] " << kernel << " mismatch: len=" << len
+                              << " count=" << count << " index=" << i << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+
+    return failures;
+}
+
+int main() {
+    std::mt19937 rng(12345);
+    size_t failures = 0;
+
+    for (const char* kernel : KERNELS) {
+        uint8_t probe[32];
+        if (!SHA256BatchWithKernel(kernel, nullptr, 0, 0, probe)) {
+            std::cout << "[sha256] " << kernel << " skipped, not supported on this cpu"
+                      << std::endl;
+            continue;
+        }
+
+        size_t kernelFailures = CheckKernel(kernel, rng);
+        std::cout << "[sha256] " << kernel << (kernelFailures == 0 ? " ok" : " FAILED")
+                  << std::endl;
+        failures += kernelFailures;
+    }
+
+    std::cout << "[sha256] dispatching to " << SHA256BatchKernel() << std::endl;
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file